@@ -5,114 +5,1414 @@
  * \author  elijw
  * \license MIT
  *
- * \brief   simple hashmap using separate chaining with std::list.
+ * \brief   simple hashmap using separate chaining with cache-line chunks.
  *
  * \note    hi rival
  * \todo    error handling (optional at the moment)
  */
 
 #pragma once
+#include "EHashBatch.h"
+#include "EHashHugePages.h"
+#include "EHashPool.h"
 #include <vector>
-#include <list>
+#include <span>
+#include <atomic>
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <concepts>
+#include <cstring>
 #include <functional>
+#include <map>
+#include <new>
+#include <random>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace ehash
+{
+/*!
+ * \brief   what a hit in find() does to its chain, see EHash::setReorder().
+ */
+enum class Reorder
+{
+    None,        //!< chains stay in insertion order
+    MoveToFront, //!< the hit moves to the head, the pairs before it back
+    Transpose    //!< the hit swaps places with the pair before it
+};
+
+/*!
+ * \brief   Stability policy: every value in a pool block of its own. a
+ *          pointer from find() stays valid until its key is removed.
+ */
+struct Stable
+{
+};
+
+/*!
+ * \brief   Stability policy: values inline in the chains (large ones still
+ *          out of line, see storeOutOfLine). a pointer from find() is valid
+ *          until the next insert of a new key or remove.
+ */
+struct Flat
+{
+};
+
+/*!
+ * \brief   V* that checks, on every dereference, that its map has not
+ *          moved values since the pointer was handed out.
+ *
+ * \note    what find() of a Flat map returns in builds without NDEBUG.
+ *          converts to V* implicitly, so code written for V* compiles
+ *          unchanged.
+ */
+template<typename V> class CheckedPtr
+{
+    V* p = nullptr;
+    const uint64_t* live = nullptr; //!< the map's generation
+    uint64_t seen = 0;              //!< its value when p was handed out
+
+  public:
+    CheckedPtr() = default;
+    CheckedPtr(V* p, const uint64_t* live) : p(p), live(live), seen(*live) {}
+
+    operator V*() const { return p; }
+
+    V& operator*() const
+    {
+        assert(valid() && "EHash<K, V, Flat> pointer used after a write");
+        return *p;
+    }
+
+    V* operator->() const
+    {
+        assert(valid() && "EHash<K, V, Flat> pointer used after a write");
+        return p;
+    }
+
+    /*!
+     * \brief   false once the map inserted or removed a key since.
+     */
+    bool valid() const { return !p || *live == seen; }
+};
+} // namespace ehash
 
 /*!
  * \brief   hashmap implementation.
  *
  * \tparam  K key type.
  * \tparam  V value type.
+ * \tparam  Stability ehash::Stable (the default) or ehash::Flat.
+ *
+ * \note    uses std::hash internally (ehash::hash_key for fixed-width keys)
+ *          mixed with a per-map random seed; separate chaining with
+ *          cache-line sized chunks.
  *
- * \note    uses std::hash internally; separate chaining with std::list.
+ *          keys that pile into one bucket cannot make lookups O(n): a chain
+ *          longer than TreeChunks chunks either gets the map a new seed and
+ *          a rehash (keys that merely share a bucket, at most once per
+ *          table size) or becomes a std::map ordered by key (keys whose
+ *          whole hashes collide, or a second degenerate chain), so the
+ *          worst case is O(log n). keys without operator< only reseed.
+ *
+ *          chains are reference counted and copied on write, so snapshot()
+ *          and copies share them until one side modifies a bucket. a map
+ *          has a single writer thread; snapshots may be read and dropped
+ *          on any thread while it writes.
+ *
+ *          Stable keeps every value in a pool block of its own, so a
+ *          pointer from find() survives rehashes and other removes until
+ *          its key is removed (or a snapshot or copy shares its bucket and
+ *          the next write copies the chain). Flat keeps small values in the
+ *          chain, which is faster, and its pointers are valid only until
+ *          the next insert of a new key or remove; without NDEBUG, find()
+ *          then returns an ehash::CheckedPtr that asserts on stale use.
  */
-template<typename K, typename V> class EHash
+template<typename K, typename V, typename Stability = ehash::Stable>
+class EHash
 {
+    static_assert(std::is_same_v<Stability, ehash::Stable> ||
+                      std::is_same_v<Stability, ehash::Flat>,
+                  "Stability is ehash::Stable or ehash::Flat");
+
+    //! out-of-line values live in pool blocks, the pair holds a handle
+    static constexpr bool OutOfLine =
+        std::is_same_v<Stability, ehash::Stable> || ehash::storeOutOfLine<V>;
+    using Stored = std::conditional_t<OutOfLine, ehash::PooledValue<V>, V>;
+
+#if defined(NDEBUG)
+    static constexpr bool Checked = false;
+#else
+    static constexpr bool Checked = std::is_same_v<Stability, ehash::Flat>;
+#endif
+
+  public:
+    //! what find() returns
+    using Pointer = std::conditional_t<Checked, ehash::CheckedPtr<V>, V*>;
+
+  private:
+
     /*!
      * \brief   internal key-value pair.
      */
     struct Pair
     {
-        K key;   //!< the key
-        V value; //!< associated value
+        K key;        //!< the key
+        Stored value; //!< associated value, or its handle
+    };
+
+    static V& valueOf(Stored& s)
+    {
+        if constexpr (OutOfLine)
+        {
+            return s.get();
+        }
+        else
+        {
+            return s;
+        }
+    }
+
+    /*!
+     * \brief   pairs per chunk: as many as fit one cache line next to the
+     *          header (next, refs, count, one tag per pair), else two lines.
+     */
+    static constexpr size_t slotsIn(size_t bytes)
+    {
+        for (size_t n = 8; n > 0; --n)
+        {
+            size_t header = (13 + n + alignof(Pair) - 1) / alignof(Pair) *
+                            alignof(Pair);
+            if (header + n * sizeof(Pair) <= bytes) return n;
+        }
+        return 1;
+    }
+
+    static constexpr size_t Slots = slotsIn(64) > 1 || sizeof(Pair) > 112
+                                        ? slotsIn(64)
+                                        : slotsIn(128);
+
+    /*!
+     * \brief   piece of a bucket's chain: up to Slots pairs on one line.
+     *
+     * \note    every chunk of a chain is full except the last one. tags
+     *          hold the top byte of each pair's hash, so a walk compares
+     *          keys only on a tag match. refs is used in the first chunk,
+     *          which stands for the whole chain.
+     */
+    struct alignas(64) Chunk
+    {
+        Chunk* next = nullptr;         //!< rest of the chain
+        std::atomic<uint32_t> refs{1}; //!< maps and snapshots holding it
+        uint8_t count = 0;             //!< pairs in use
+        uint8_t tags[Slots];           //!< top hash byte of each pair
+        alignas(Pair) unsigned char storage[Slots * sizeof(Pair)];
+
+        Pair* pairs()
+        {
+            return std::launder(reinterpret_cast<Pair*>(storage));
+        }
+    };
+
+    static_assert(alignof(Pair) <= 64, "over-aligned keys or values");
+
+    //! bucket of a degenerate chain, ordered by key
+    using Tree = std::map<K, Stored>;
+
+    //! keys a Tree can hold; others only get reseeding
+    static constexpr bool Treeable = requires(const K& a, const K& b) {
+        { a < b } -> std::convertible_to<bool>;
+    };
+
+    static constexpr uint8_t TreeMark = 0xff; //!< Chunk::count of a tree
+    static constexpr size_t TreeChunks = 8;   //!< longest chain before one
+
+    static_assert(Slots < TreeMark && sizeof(Chunk::storage) >= sizeof(Tree*));
+
+    /*!
+     * \brief   flooding counters.
+     */
+    struct Stats
+    {
+        size_t treeified = 0; //!< chains turned into trees
+        size_t reseeds = 0;   //!< seeds replaced on a degenerate chain
     };
 
-    std::vector<std::list<Pair>> buckets; //!< array of buckets
-    size_t numElements = 0;               //!< number of elements
-    float maxLoad = 0.75f;                //!< load factor threshold
+    //! bucket words, see chainAt(); 2 MiB pages once that large
+    using Buckets = std::vector<uintptr_t, ehash::HugePageAllocator<uintptr_t>>;
+
+    //! bucket heads of a snapshot
+    using Chains = std::vector<Chunk*, ehash::HugePageAllocator<Chunk*>>;
+
+    static constexpr unsigned EpochShift = 48; //!< above user addresses
+    static constexpr uintptr_t AddressMask = (uintptr_t(1) << EpochShift) - 1;
+
+    Buckets buckets;             //!< array of buckets (0 = empty)
+    uint16_t epoch = 0;          //!< bumped by clear()
+    size_t numElements = 0;      //!< number of elements
+    float maxLoad = 0.75f;       //!< load factor threshold
+    uint64_t generation = 0;     //!< bumped when Flat pointers go stale
+    uint64_t hashSeed = 0;       //!< mixed into every hash
+    ehash::Reorder order = ehash::Reorder::None; //!< see setReorder()
+    bool reseeded = false;       //!< seed replaced at this table size
+    Stats counters;              //!< see stats()
+
+    static constexpr size_t BatchBlock = 64; //!< keys hashed per batch step
+    static constexpr size_t PruneAhead = 16; //!< see pruneRange()
+
+    static uint8_t tagOf(uint64_t hash) { return uint8_t(hash >> 56); }
+
+    /*!
+     * \brief   chain of bucket idx; null when empty or stale.
+     *
+     * \note    a bucket word is the head pointer with the epoch it was
+     *          written in above the address bits. clear() bumps the epoch,
+     *          so every older word reads as empty without being touched;
+     *          its chain is released when the bucket is next written, on
+     *          a rehash, or when the epoch wraps.
+     */
+    Chunk* chainAt(size_t idx) const
+    {
+        uintptr_t w = buckets[idx];
+        if ((w >> EpochShift) != epoch) return nullptr;
+        return reinterpret_cast<Chunk*>(w & AddressMask);
+    }
+
+    static Chunk* untag(uintptr_t w)
+    {
+        return reinterpret_cast<Chunk*>(w & AddressMask);
+    }
+
+    void setChain(size_t idx, Chunk* c)
+    {
+        uintptr_t address = reinterpret_cast<uintptr_t>(c);
+        assert(address >> EpochShift == 0 && "chunk above 2^48");
+        buckets[idx] = c ? address | uintptr_t(epoch) << EpochShift : 0;
+    }
+
+    void invalidate()
+    {
+        if constexpr (Checked) generation++;
+    }
+
+    static Chunk* newChunk()
+    {
+        return new (ehash::NodePool::allocate(sizeof(Chunk))) Chunk;
+    }
+
+    /*!
+     * \brief   a tree bucket is a lone chunk, marked by its count, whose
+     *          storage holds the Tree pointer.
+     */
+    static bool isTree(const Chunk* c) { return c->count == TreeMark; }
+
+    static Tree* treeOf(const Chunk* c)
+    {
+        Tree* t;
+        std::memcpy(&t, c->storage, sizeof t);
+        return t;
+    }
+
+    static Chunk* newTree(Tree* t)
+    {
+        Chunk* c = newChunk();
+        c->count = TreeMark;
+        std::memcpy(c->storage, &t, sizeof t);
+        return c;
+    }
+
+    static void freeChunk(Chunk* c)
+    {
+        if (isTree(c))
+        {
+            delete treeOf(c);
+        }
+        else
+        {
+            Pair* p = c->pairs();
+            for (size_t i = 0; i < c->count; ++i) p[i].~Pair();
+        }
+        c->~Chunk();
+        ehash::NodePool::deallocate(c, sizeof(Chunk));
+    }
+
+    static void share(Chunk* c)
+    {
+        if (c) c->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void release(Chunk* c)
+    {
+        if (!c || c->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+        while (c)
+        {
+            Chunk* next = c->next;
+            freeChunk(c);
+            c = next;
+        }
+    }
+
+    static bool shared(const Chunk* c)
+    {
+        // acquire: a snapshot dropped on another thread is done reading
+        return c->refs.load(std::memory_order_acquire) != 1;
+    }
 
     /*!
-     * \brief   compute hash index for a key.
+     * \brief   chain of bucket idx, private to this map (copied if shared).
      */
-    size_t hashKey(const K& key) const
+    Chunk& own(size_t idx)
     {
-        return std::hash<K>{}(key) % buckets.size();
+        Chunk* c = chainAt(idx);
+        if (!c)
+        {
+            release(untag(buckets[idx])); // what an old epoch left
+            c = newChunk();
+        }
+        else if (shared(c))
+        {
+            invalidate();
+            c = unshare(c);
+        }
+        setChain(idx, c);
+        return *c;
     }
 
     /*!
-     * \brief   double bucket size and rehash all elements.
+     * \brief   a private copy of the shared chain c, which is released.
      */
-    void rehash()
+    static Chunk* unshare(Chunk* c)
     {
-        std::vector<std::list<Pair>> old = buckets;
-        buckets.clear();
-        buckets.resize(old.size() * 2);
+        Chunk* copy = nullptr;
+        Chunk** tail = &copy;
+        for (Chunk* from = c; from; from = from->next)
+        {
+            if (isTree(from))
+            {
+                *tail = newTree(new Tree(*treeOf(from)));
+                break;
+            }
+            Chunk* to = *tail = newChunk();
+            for (size_t i = 0; i < from->count; ++i)
+            {
+                new (to->pairs() + i) Pair(from->pairs()[i]);
+            }
+            to->count = from->count;
+            std::memcpy(to->tags, from->tags, from->count);
+            tail = &to->next;
+        }
+        release(c);
+        return copy;
+    }
 
-        for (auto& bucket : old)
+    /*!
+     * \brief   remove the pairs of bucket idx that pred picks, in one walk
+     *          of the chain; returns how many went.
+     *
+     * \note    pred sees every pair before anything is written, so a chain
+     *          shared with a snapshot is copied only if it loses a pair.
+     *          the kept pairs slide down over the holes in order and the
+     *          chunks left empty at the end go back to the pool. touches
+     *          bucket idx alone, and leaves invalidate() to the caller.
+     */
+    template<typename F>
+    size_t prune(size_t idx, F& pred, std::vector<uint8_t>& doomed)
+    {
+        Chunk* head = chainAt(idx);
+        if (!head) return 0;
+
+        doomed.clear();
+        size_t n = 0;
+        auto decide = [&](const K& key, const V& value) {
+            bool d = pred(key, value);
+            doomed.push_back(d);
+            n += d;
+        };
+        walk(head, decide);
+        if (!n) return 0;
+
+        if (shared(head))
         {
-            for (auto& pair : bucket)
+            head = unshare(head);
+            setChain(idx, head);
+        }
+        size_t k = 0;
+        if (isTree(head))
+        {
+            if constexpr (Treeable)
             {
-                insert(pair.key, pair.value);
+                Tree* t = treeOf(head);
+                for (auto it = t->begin(); it != t->end();)
+                {
+                    it = doomed[k++] ? t->erase(it) : std::next(it);
+                }
+                if (t->empty())
+                {
+                    freeChunk(head);
+                    setChain(idx, nullptr);
+                }
             }
+            return n;
         }
+
+        // every slot before the read position is either kept in place or
+        // already destroyed, so the write position only ever fills holes
+        Chunk** link = &head;
+        size_t at = 0;
+        for (Chunk* c = head; c; c = c->next)
+        {
+            for (size_t i = 0; i < c->count; ++i)
+            {
+                Pair& pair = c->pairs()[i];
+                if (doomed[k++])
+                {
+                    pair.~Pair();
+                    continue;
+                }
+                Chunk* to = *link;
+                if (to != c || at != i)
+                {
+                    new (to->pairs() + at) Pair(std::move(pair));
+                    to->tags[at] = c->tags[i];
+                    pair.~Pair();
+                }
+                if (++at == Slots)
+                {
+                    link = &to->next;
+                    at = 0;
+                }
+            }
+        }
+
+        // all pairs past the write position are destroyed: cut the chain
+        Chunk* rest = *link;
+        if (rest && at)
+        {
+            rest->count = uint8_t(at);
+            link = &rest->next;
+            rest = *link;
+        }
+        *link = nullptr;
+        while (rest)
+        {
+            Chunk* next = rest->next;
+            rest->count = 0;
+            freeChunk(rest);
+            rest = next;
+        }
+        setChain(idx, head);
+        return n;
     }
 
-  public:
-    explicit EHash(size_t size = 8) : buckets(size) {}
+    /*!
+     * \brief   prune() buckets [begin, end); returns how many pairs went.
+     *
+     * \note    prefetches the chain head PruneAhead buckets on and, once
+     *          that has arrived halfway there, the out-of-line values it
+     *          points to, so pred does not wait on either.
+     */
+    template<typename F> size_t pruneRange(size_t begin, size_t end, F& pred)
+    {
+        std::vector<uint8_t> doomed;
+        size_t n = 0;
+        for (size_t i = begin; i < end; ++i)
+        {
+            if (i + PruneAhead < end)
+            {
+                if (Chunk* c = chainAt(i + PruneAhead)) __builtin_prefetch(c);
+            }
+            if constexpr (OutOfLine)
+            {
+                Chunk* c = i + PruneAhead / 2 < end
+                               ? chainAt(i + PruneAhead / 2)
+                               : nullptr;
+                for (size_t j = 0; c && !isTree(c) && j < c->count; ++j)
+                {
+                    __builtin_prefetch(&valueOf(c->pairs()[j].value));
+                }
+            }
+            n += prune(i, pred, doomed);
+        }
+        return n;
+    }
 
-    void insert(const K& key, const V& value)
+    /*!
+     * \brief   after erase_if(): halve the table while it would stay under
+     *          the load factor.
+     */
+    void shrinkToFit()
+    {
+        size_t want = std::max<size_t>(size_t(numElements / maxLoad) + 1, 8);
+        if (want <= buckets.size() / 2) rehash(want);
+    }
+
+    /*!
+     * \brief   pairs of c whose tag matches, one bit per slot.
+     */
+    static uint32_t match(const Chunk* c, uint8_t tag)
+    {
+        uint32_t m = 0;
+        for (size_t i = 0; i < c->count; ++i)
+        {
+            m |= uint32_t(c->tags[i] == tag) << i;
+        }
+        return m;
+    }
+
+    /*!
+     * \brief   chunk and slot of key in the chain c, or {nullptr, 0}.
+     */
+    static std::pair<Chunk*, size_t> locate(Chunk* c, const K& key,
+                                            uint8_t tag)
+    {
+        for (; c; c = c->next)
+        {
+            for (uint32_t m = match(c, tag); m; m &= m - 1)
+            {
+                size_t i = size_t(std::countr_zero(m));
+                if (c->pairs()[i].key == key) return {c, i};
+            }
+        }
+        return {nullptr, 0};
+    }
+
+    /*!
+     * \brief   value of key in the bucket c (a chain or a tree), or null.
+     */
+    static Stored* search(Chunk* c, const K& key, uint8_t tag)
+    {
+        if (c && isTree(c))
+        {
+            if constexpr (Treeable)
+            {
+                auto it = treeOf(c)->find(key);
+                if (it != treeOf(c)->end()) return &it->second;
+            }
+            return nullptr;
+        }
+        auto [at, i] = locate(c, key, tag);
+        return at ? &at->pairs()[i].value : nullptr;
+    }
+
+    template<typename F> static void walk(Chunk* c, F& fn)
+    {
+        if (c && isTree(c))
+        {
+            for (auto& [key, value] : *treeOf(c)) fn(key, valueOf(value));
+            return;
+        }
+        for (; c; c = c->next)
+        {
+            Pair* p = c->pairs();
+            for (size_t i = 0; i < c->count; ++i)
+            {
+                fn(p[i].key, valueOf(p[i].value));
+            }
+        }
+    }
+
+    /*!
+     * \brief   add a pair to the end of an unshared chain.
+     *
+     * \return  length of the chain in chunks.
+     */
+    template<typename P>
+    static size_t append(Chunk*& head, P&& pair, uint8_t tag)
+    {
+        size_t length = 1;
+        Chunk** link = &head;
+        while (*link && (*link)->count == Slots)
+        {
+            link = &(*link)->next;
+            length++;
+        }
+        if (!*link) *link = newChunk();
+
+        Chunk* c = *link;
+        new (c->pairs() + c->count) Pair(std::forward<P>(pair));
+        c->tags[c->count++] = tag;
+        return length;
+    }
+
+    /*!
+     * \brief   add a pair to an unshared tree bucket.
+     */
+    template<typename P> static void plant(Chunk* c, P&& pair)
+    {
+        if constexpr (Treeable)
+        {
+            treeOf(c)->emplace(std::forward<P>(pair).key,
+                               std::forward<P>(pair).value);
+        }
+    }
+
+    /*!
+     * \brief   turn the unshared chain head into a tree bucket.
+     */
+    void treeify(Chunk*& head)
+    {
+        if constexpr (Treeable)
+        {
+            Tree* t = new Tree;
+            for (Chunk* c = head; c; c = c->next)
+            {
+                for (size_t i = 0; i < c->count; ++i)
+                {
+                    Pair& p = c->pairs()[i];
+                    t->emplace(std::move(p.key), std::move(p.value));
+                }
+            }
+            release(head);
+            head = newTree(t);
+            counters.treeified++;
+        }
+    }
+
+    /*!
+     * \brief   all pairs of the chain c have the same full hash.
+     */
+    bool oneHash(Chunk* c) const
+    {
+        uint64_t first = hashOf(c->pairs()[0].key);
+        for (; c; c = c->next)
+        {
+            for (size_t i = 0; i < c->count; ++i)
+            {
+                if (hashOf(c->pairs()[i].key) != first) return false;
+            }
+        }
+        return true;
+    }
+
+    /*!
+     * \brief   chain idx grew past TreeChunks chunks.
+     *
+     * \note    keys that only share a bucket mean an unlucky seed, or one
+     *          that leaked: a new seed and a rehash spread them, once per
+     *          table size so the cost stays amortized O(1). keys whose full
+     *          hashes collide would collide under every seed; their chain
+     *          becomes a tree, as does any chain after the reseed.
+     */
+    void degenerate(size_t idx)
+    {
+        Chunk* head = chainAt(idx);
+        if (!reseeded && !oneHash(head))
+        {
+            hashSeed = ehash::random_seed();
+            rehash(buckets.size());
+            reseeded = true;
+            counters.reseeds++;
+            return;
+        }
+        treeify(head);
+        setChain(idx, head);
+    }
+
+    /*!
+     * \brief   full hash of a key under seed.
+     *
+     * \note    fixed-width keys go through the same mixer as hash_batch(),
+     *          so single and batched operations agree on bucket placement.
+     *          other keys have their std::hash mixed with the seed, which
+     *          spreads keys that only collide modulo the bucket count.
+     */
+    static uint64_t hashWith(const K& key, uint64_t seed)
+    {
+        if constexpr (ehash::BatchHashable<K>)
+        {
+            return ehash::hash_key(key, seed);
+        }
+        else
+        {
+            return ehash::mix64(std::hash<K>{}(key) ^ seed);
+        }
+    }
+
+    uint64_t hashOf(const K& key) const { return hashWith(key, hashSeed); }
+
+    /*!
+     * \brief   hash a block of keys, vectorized when the key type allows.
+     */
+    void hashBlock(std::span<const K> keys, uint64_t* out) const
+    {
+        if constexpr (ehash::BatchHashable<K>)
+        {
+            ehash::hash_batch(keys, std::span<uint64_t>(out, keys.size()),
+                              hashSeed);
+        }
+        else
+        {
+            for (size_t i = 0; i < keys.size(); ++i) out[i] = hashOf(keys[i]);
+        }
+    }
+
+    /*!
+     * \brief   move the pair holding hit forward in the unshared chain
+     *          head, as order says.
+     *
+     * \return  where the value is now.
+     */
+    Stored* promote(Chunk* head, Stored* hit)
+    {
+        if (isTree(head) || &head->pairs()[0].value == hit) return hit;
+        invalidate();
+
+        Chunk* before = head; // chunk and slot of the previous pair
+        size_t prev = 0;
+        for (Chunk* c = head; c; c = c->next)
+        {
+            for (size_t i = 0; i < c->count; ++i)
+            {
+                if (&c->pairs()[i].value != hit)
+                {
+                    before = c;
+                    prev = i;
+                    continue;
+                }
+                if (order == ehash::Reorder::Transpose)
+                {
+                    std::swap(before->pairs()[prev], c->pairs()[i]);
+                    std::swap(before->tags[prev], c->tags[i]);
+                    return &before->pairs()[prev].value;
+                }
+
+                // carry the hit to the head, each pair one slot back
+                Pair carry = std::move(c->pairs()[i]);
+                uint8_t carryTag = c->tags[i];
+                for (Chunk* d = head;; d = d->next)
+                {
+                    for (size_t j = 0; j < d->count; ++j)
+                    {
+                        if (d == c && j == i)
+                        {
+                            d->pairs()[j] = std::move(carry);
+                            d->tags[j] = carryTag;
+                            return &head->pairs()[0].value;
+                        }
+                        std::swap(carry, d->pairs()[j]);
+                        std::swap(carryTag, d->tags[j]);
+                    }
+                }
+            }
+        }
+        return hit;
+    }
+
+    V* findHashed(const K& key, uint64_t hash, bool reorder = false)
+    {
+        size_t idx = hash % buckets.size();
+        uint8_t tag = tagOf(hash);
+        Chunk* head = chainAt(idx);
+        Stored* p = search(head, key, tag);
+        if (!p) return nullptr;
+
+        // the caller may write through the pointer: hand out our own copy
+        if (shared(head)) p = search(head = &own(idx), key, tag);
+        if (reorder && order != ehash::Reorder::None) p = promote(head, p);
+        return &valueOf(*p);
+    }
+
+    void insertHashed(const K& key, const V& value, uint64_t hash)
     {
         if ((float)numElements / buckets.size() > maxLoad)
         {
-            rehash();
+            rehash(buckets.size() * 2);
+        }
+
+        size_t idx = hash % buckets.size();
+        uint8_t tag = tagOf(hash);
+        Chunk* head = chainAt(idx);
+        if (Stored* p = search(head, key, tag))
+        {
+            if (shared(head)) p = search(&own(idx), key, tag);
+            *p = value;
+            return;
+        }
+
+        numElements++;
+        invalidate();
+        head = &own(idx);
+        if (isTree(head))
+        {
+            plant(head, Pair{key, Stored(value)});
+        }
+        else if (append(head, Pair{key, Stored(value)}, tag) > TreeChunks)
+        {
+            degenerate(idx);
+        }
+    }
+
+    /*!
+     * \brief   add a pair to the new table during a rehash.
+     */
+    template<typename P> void rehome(P&& pair)
+    {
+        uint64_t hash = hashOf(pair.key);
+        size_t idx = hash % buckets.size();
+        Chunk* to = chainAt(idx);
+        if (to && isTree(to))
+        {
+            plant(to, std::forward<P>(pair));
+            return;
+        }
+        if (append(to, std::forward<P>(pair), tagOf(hash)) > TreeChunks)
+        {
+            treeify(to);
+        }
+        setChain(idx, to);
+    }
+
+    /*!
+     * \brief   resize to newSize buckets and rehash all elements.
+     *
+     * \note    pairs of unshared chains are moved, not copied. every key
+     *          is hashed again, so this also applies a new seed; trees are
+     *          taken apart and only rebuilt where a chain is still too long.
+     */
+    void rehash(size_t newSize)
+    {
+        invalidate();
+        reseeded = false;
+        Buckets old = std::move(buckets);
+        buckets.assign(newSize, 0);
+
+        for (uintptr_t w : old)
+        {
+            Chunk* head = (w >> EpochShift) == epoch ? untag(w) : nullptr;
+            if (!head)
+            {
+                release(untag(w));
+                continue;
+            }
+            bool move = !shared(head);
+            if (isTree(head))
+            {
+                for (auto& [key, value] : *treeOf(head))
+                {
+                    if (move) rehome(Pair{key, std::move(value)});
+                    else rehome(Pair{key, value});
+                }
+            }
+            for (Chunk* c = head; c && !isTree(c); c = c->next)
+            {
+                for (size_t i = 0; i < c->count; ++i)
+                {
+                    Pair& pair = c->pairs()[i];
+                    if (move) rehome(std::move(pair));
+                    else rehome(pair);
+                }
+            }
+            release(head);
         }
+    }
+
+  public:
+    /*!
+     * \brief   immutable point-in-time view of a map, see snapshot().
+     *
+     * \note    holds references to the map's chains; the map copies a chain
+     *          before it first writes to it, and whatever only the snapshot
+     *          still uses is freed when the snapshot goes away.
+     */
+    class Snapshot
+    {
+        friend class EHash;
 
-        size_t idx = hashKey(key);
-        for (auto& pair : buckets[idx])
+        Chains chains;
+        size_t numElements = 0;
+        uint64_t seed = 0; //!< the map's seed when taken
+
+        explicit Snapshot(const EHash& map)
+            : chains(map.buckets.size()), numElements(map.numElements),
+              seed(map.hashSeed)
         {
-            if (pair.key == key)
+            for (size_t i = 0; i < chains.size(); ++i)
             {
-                pair.value = value;
+                share(chains[i] = map.chainAt(i));
+            }
+        }
+
+      public:
+        Snapshot() = default;
+        ~Snapshot()
+        {
+            for (Chunk* c : chains) release(c);
+        }
+
+        Snapshot(Snapshot&& o) noexcept
+            : chains(std::move(o.chains)), numElements(o.numElements),
+              seed(o.seed)
+        {
+            o.chains.clear();
+        }
+
+        Snapshot& operator=(Snapshot&& o) noexcept
+        {
+            std::swap(chains, o.chains);
+            std::swap(numElements, o.numElements);
+            std::swap(seed, o.seed);
+            return *this;
+        }
+
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+
+        const V* find(const K& key) const
+        {
+            if (chains.empty()) return nullptr;
+            uint64_t hash = hashWith(key, seed);
+            Stored* p = search(chains[hash % chains.size()], key, tagOf(hash));
+            return p ? &valueOf(*p) : nullptr;
+        }
+
+        /*!
+         * \brief   call fn(key, value) for every element of the view.
+         */
+        template<typename F> void forEach(F&& fn) const
+        {
+            for (Chunk* head : chains) walk(head, fn);
+        }
+
+        size_t size() const { return numElements; }
+    };
+
+    /*!
+     * \brief   a find() cut at its memory accesses, for interleaving many
+     *          lookups (see EHashCoro.h).
+     *
+     * \note    address() is what the next step() reads: prefetch it, work
+     *          on other lookups meanwhile, then step(). value() is the
+     *          result once done(), a plain pointer as find_batch() gives.
+     *          never reorders; the map must not be written while a probe
+     *          is under way.
+     */
+    class Probe
+    {
+        EHash* map;
+        const K* key;
+        uint64_t hash;
+        Chunk* chunk = nullptr; //!< read by the next step; null: the bucket
+        bool head = true;       //!< chunk is the first of its chain
+        bool finished = false;
+        V* found = nullptr;
+
+      public:
+        Probe(EHash& map, const K& key)
+            : map(&map), key(&key), hash(map.hashOf(key))
+        {
+        }
+
+        const void* address() const
+        {
+            if (chunk) return chunk;
+            return &map->buckets[hash % map->buckets.size()];
+        }
+
+        void step()
+        {
+            size_t idx = hash % map->buckets.size();
+            if (!chunk)
+            {
+                chunk = map->chainAt(idx);
+                finished = !chunk;
                 return;
             }
+            if (head && (chunk != map->chainAt(idx) || isTree(chunk) ||
+                         shared(chunk)))
+            {
+                // the slow paths: a tree, a chain to copy first, or one
+                // another probe copied since the bucket was read
+                found = map->findHashed(*key, hash);
+                finished = true;
+                return;
+            }
+
+            head = false;
+            for (uint32_t m = match(chunk, tagOf(hash)); m; m &= m - 1)
+            {
+                Pair& p = chunk->pairs()[std::countr_zero(m)];
+                if (p.key == *key)
+                {
+                    found = &valueOf(p.value);
+                    finished = true;
+                    return;
+                }
+            }
+            chunk = chunk->next;
+            finished = !chunk;
         }
 
-        buckets[idx].push_front({key, value});
-        numElements++;
+        bool done() const { return finished; }
+
+        V* value() const { return found; }
+    };
+
+    explicit EHash(size_t size = 8) : EHash(size, ehash::random_seed()) {}
+
+    /*!
+     * \brief   map with a fixed hash seed, for a reproducible layout.
+     */
+    EHash(size_t size, uint64_t seed)
+        : buckets(std::max<size_t>(size, 1)), hashSeed(seed)
+    {
     }
 
-    V* find(const K& key)
+    ~EHash()
     {
-        size_t idx = hashKey(key);
-        for (auto& pair : buckets[idx])
+        for (uintptr_t w : buckets) release(untag(w));
+    }
+
+    /*!
+     * \brief   copy in O(buckets): chains are shared until written.
+     */
+    EHash(const EHash& o)
+        : buckets(o.buckets), epoch(o.epoch), numElements(o.numElements),
+          maxLoad(o.maxLoad), hashSeed(o.hashSeed), order(o.order),
+          reseeded(o.reseeded)
+    {
+        for (uintptr_t w : buckets) share(untag(w));
+    }
+
+    EHash(EHash&& o) noexcept
+        : buckets(std::move(o.buckets)), epoch(o.epoch),
+          numElements(o.numElements),
+          maxLoad(o.maxLoad), hashSeed(o.hashSeed), order(o.order),
+          reseeded(o.reseeded), counters(o.counters)
+    {
+        o.buckets.assign(1, 0);
+        o.numElements = 0;
+    }
+
+    EHash& operator=(EHash o) noexcept
+    {
+        invalidate();
+        std::swap(buckets, o.buckets);
+        std::swap(epoch, o.epoch);
+        std::swap(numElements, o.numElements);
+        std::swap(maxLoad, o.maxLoad);
+        std::swap(hashSeed, o.hashSeed);
+        std::swap(order, o.order);
+        std::swap(reseeded, o.reseeded);
+        std::swap(counters, o.counters);
+        return *this;
+    }
+
+    void insert(const K& key, const V& value)
+    {
+        insertHashed(key, value, hashOf(key));
+    }
+
+    Pointer find(const K& key)
+    {
+        V* p = findHashed(key, hashOf(key), true);
+        if constexpr (Checked)
+        {
+            return Pointer(p, &generation);
+        }
+        else
         {
-            if (pair.key == key) return &pair.value;
+            return p;
         }
-        return nullptr;
+    }
+
+    /*!
+     * \brief   look up many keys at once.
+     *
+     * \param   keys keys to look up
+     * \param   out  out[i] receives find(keys[i]) as a plain pointer; at
+     *               least keys.size() long
+     *
+     * \note    hashes a block of keys in one go and prefetches every bucket
+     *          of the block, then every chain, before walking the chains.
+     *          never reorders chains, so all of out stays valid.
+     */
+    void find_batch(std::span<const K> keys, std::span<V*> out)
+    {
+        uint64_t hashes[BatchBlock];
+        for (size_t base = 0; base < keys.size(); base += BatchBlock)
+        {
+            size_t n = std::min(BatchBlock, keys.size() - base);
+            hashBlock(keys.subspan(base, n), hashes);
+
+            for (size_t i = 0; i < n; ++i)
+            {
+                __builtin_prefetch(&buckets[hashes[i] % buckets.size()]);
+            }
+            for (size_t i = 0; i < n; ++i)
+            {
+                Chunk* c = chainAt(hashes[i] % buckets.size());
+                if (c) __builtin_prefetch(c); // the first chunk is one line
+            }
+            for (size_t i = 0; i < n; ++i)
+            {
+                out[base + i] = findHashed(keys[base + i], hashes[i]);
+            }
+        }
+    }
+
+    /*!
+     * \brief   insert many key-value pairs at once (bulk build).
+     *
+     * \param   keys   keys to insert
+     * \param   values values[i] is stored under keys[i]
+     */
+    void insert_batch(std::span<const K> keys, std::span<const V> values)
+    {
+        uint64_t hashes[BatchBlock];
+        for (size_t base = 0; base < keys.size(); base += BatchBlock)
+        {
+            size_t n = std::min(BatchBlock, keys.size() - base);
+            hashBlock(keys.subspan(base, n), hashes);
+
+            // a reseed part way through the block stales the rest
+            uint64_t seed = hashSeed;
+            for (size_t i = 0; i < n; ++i)
+            {
+                const K& key = keys[base + i];
+                insertHashed(key, values[base + i],
+                             hashSeed == seed ? hashes[i] : hashOf(key));
+            }
+        }
+    }
+
+    /*!
+     * \brief   consistent read-only view of the map as it is now.
+     *
+     * \note    O(buckets) reference bumps, no element copies. readers
+     *          never block the writer: a bucket the writer changes later is
+     *          copied once, on its first write, while the view lives.
+     */
+    Snapshot snapshot() const
+    {
+        return Snapshot(*this);
+    }
+
+    /*!
+     * \brief   call fn(key, value) for every element, in bucket order.
+     */
+    template<typename F> void forEach(F&& fn) const
+    {
+        for (size_t i = 0; i < buckets.size(); ++i) walk(chainAt(i), fn);
+    }
+
+    /*!
+     * \brief   remove every element for which pred(key, value) is true;
+     *          returns how many were removed.
+     *
+     * \note    one walk over the table: each chain is compacted in place
+     *          and its freed chunks and values go back to the NodePool,
+     *          with no rehash or lookup per key. shrink then rehashes into
+     *          the smallest table that keeps the load factor, when that
+     *          halves it at least. pred must not touch the map.
+     */
+    template<typename F> size_t erase_if(F&& pred, bool shrink = false)
+    {
+        size_t n = pruneRange(0, buckets.size(), pred);
+        numElements -= n;
+        if (n) invalidate();
+        if (shrink) shrinkToFit();
+        return n;
+    }
+
+    /*!
+     * \brief   erase_if() on threads threads (0: one per core), each
+     *          taking a contiguous range of buckets.
+     *
+     * \note    pred is called concurrently and must be safe for that. the
+     *          caller still is the map's only writer: nothing else may use
+     *          the map until this returns. worth it on large tables only,
+     *          as every call starts its threads anew.
+     */
+    template<typename F>
+    size_t erase_if_parallel(F&& pred, unsigned threads = 0,
+                             bool shrink = false)
+    {
+        if (threads == 0) threads = std::thread::hardware_concurrency();
+        size_t parts = std::clamp<size_t>(threads, 1, buckets.size());
+        std::vector<size_t> removed(parts);
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < parts; ++t)
+        {
+            workers.emplace_back([&, t] {
+                removed[t] = pruneRange(buckets.size() * t / parts,
+                                        buckets.size() * (t + 1) / parts,
+                                        pred);
+            });
+        }
+        for (auto& w : workers) w.join();
+
+        size_t n = 0;
+        for (size_t r : removed) n += r;
+        numElements -= n;
+        if (n) invalidate();
+        if (shrink) shrinkToFit();
+        return n;
+    }
+
+    /*!
+     * \brief   number of stored elements.
+     */
+    size_t size() const { return numElements; }
+
+    /*!
+     * \brief   number of buckets in the table.
+     */
+    size_t bucket_count() const { return buckets.size(); }
+
+    /*!
+     * \brief   the seed mixed into every hash; changes on a reseed.
+     */
+    uint64_t seed() const { return hashSeed; }
+
+    /*!
+     * \brief   how often chains degenerated, see degenerate().
+     */
+    const Stats& stats() const { return counters; }
+
+    /*!
+     * \brief   reorder a chain on every find() hit, so the hot keys of a
+     *          skewed workload end up at the head of their chains. off by
+     *          default.
+     *
+     * \note    a hit then writes to its chain. in a Flat map it moves
+     *          values, so find() invalidates earlier pointers as an insert
+     *          does. find_batch() and snapshots never reorder.
+     */
+    void setReorder(ehash::Reorder r) { order = r; }
+
+    /*!
+     * \brief   load factor past which the table doubles: higher takes less
+     *          memory and makes chains longer.
+     */
+    void setMaxLoad(float load) { maxLoad = load; }
+
+    /*!
+     * \brief   pairs a lookup of key walks, the hit included; 0 if absent.
+     *
+     * \note    a diagnostic for chain order. a tree bucket counts as 1.
+     */
+    size_t depth(const K& key) const
+    {
+        uint64_t hash = hashOf(key);
+        Chunk* c = chainAt(hash % buckets.size());
+        if (!c || isTree(c)) return search(c, key, tagOf(hash)) ? 1 : 0;
+
+        size_t walked = 0;
+        for (; c; c = c->next)
+        {
+            for (size_t i = 0; i < c->count; ++i)
+            {
+                walked++;
+                if (c->pairs()[i].key == key) return walked;
+            }
+        }
+        return 0;
+    }
+
+    /*!
+     * \brief   grow the table so n elements fit without a rehash.
+     */
+    void reserve(size_t n)
+    {
+        size_t want = static_cast<size_t>(n / maxLoad) + 1;
+        if (want > buckets.size()) rehash(want);
+    }
+
+    /*!
+     * \brief   remove every element in O(1), keeping the table.
+     *
+     * \note    bumps the epoch, so every bucket reads as empty; the old
+     *          chains are released as their buckets are written again, so
+     *          a scratch map refilled each round reuses its table with no
+     *          sweep. chains nobody writes again stay allocated until
+     *          reset(), a rehash or destruction; once every 65536 clears
+     *          the epoch wraps and the table is swept. snapshots and
+     *          copies keep what they saw.
+     *
+     *          a write to a stale bucket reads its old chain to free it.
+     *          for a table far larger than the cache those reads miss one
+     *          at a time, and reset(), whose sweep overlaps them, makes
+     *          the next fill cheaper overall.
+     */
+    void clear()
+    {
+        numElements = 0;
+        invalidate();
+        if (++epoch != 0) return;
+
+        for (uintptr_t& w : buckets)
+        {
+            release(untag(w));
+            w = 0;
+        }
+    }
+
+    /*!
+     * \brief   remove every element and free its chunks now.
+     *
+     * \note    O(buckets). chunks go back to the NodePool for the next
+     *          fill to reuse. keepCapacity keeps the table size; otherwise
+     *          it shrinks to the default.
+     */
+    void reset(bool keepCapacity = true)
+    {
+        for (uintptr_t& w : buckets)
+        {
+            release(untag(w));
+            w = 0;
+        }
+        if (!keepCapacity) Buckets(8, 0).swap(buckets);
+        numElements = 0;
+        reseeded = false;
+        invalidate();
     }
 
     bool remove(const K& key)
     {
-        size_t idx = hashKey(key);
-        auto& bucket = buckets[idx];
-        for (auto it = bucket.begin(); it != bucket.end(); ++it)
+        uint64_t hash = hashOf(key);
+        size_t idx = hash % buckets.size();
+        uint8_t tag = tagOf(hash);
+        if (!search(chainAt(idx), key, tag)) return false;
+
+        Chunk* head = &own(idx);
+        if (isTree(head))
         {
-            if (it->key == key)
+            if constexpr (Treeable) treeOf(head)->erase(key);
+            if (treeOf(head)->empty())
             {
-                bucket.erase(it);
-                numElements--;
-                return true;
+                freeChunk(head);
+                setChain(idx, nullptr);
             }
+            numElements--;
+            invalidate();
+            return true;
+        }
+
+        // the chain's last pair fills the hole, so only the last chunk is
+        // ever partly empty
+        auto [at, i] = locate(head, key, tag);
+        Chunk** link = &head;
+        while ((*link)->next) link = &(*link)->next;
+        Chunk* last = *link;
+
+        size_t end = last->count - 1;
+        if (at != last || i != end)
+        {
+            at->pairs()[i] = std::move(last->pairs()[end]);
+            at->tags[i] = last->tags[end];
+        }
+        last->pairs()[end].~Pair();
+        if (--last->count == 0)
+        {
+            *link = nullptr;
+            freeChunk(last);
+            setChain(idx, head);
         }
-        return false;
+        numElements--;
+        invalidate();
+        return true;
     }
 };
 
@@ -0,0 +1,253 @@
+
+/*!
+ * \file    lib/EHashBatch.h
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   batch hashing kernels for integer and fixed-width keys.
+ *
+ * \note    multiply-xorshift (murmur3 fmix64) over 64-bit lanes. the
+ *          AVX-512 kernel hashes 8 keys per instruction, the AVX2 kernel 4;
+ *          both are picked at runtime, the scalar loop is the fallback and
+ *          the reference every kernel must agree with.
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <random>
+#include <span>
+#include <type_traits>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define EHASH_X86_KERNELS 1
+#endif
+
+namespace ehash
+{
+/*!
+ * \brief   keys that hash_batch() can hash: 1..8 bytes without padding.
+ *
+ * \note    the key bytes are zero-extended to 64 bits before mixing, so a
+ *          key hashes the same no matter which kernel sees it. unique
+ *          object representations rule out floats (-0.0 == 0.0) and padded
+ *          structs, where equal keys could differ bytewise.
+ */
+template<typename K>
+concept BatchHashable = std::is_trivially_copyable_v<K> && sizeof(K) <= 8 &&
+                        std::has_unique_object_representations_v<K>;
+
+/*!
+ * \brief   murmur3 64-bit finalizer.
+ */
+inline uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+/*!
+ * \brief   hash a single fixed-width key (reference for the kernels).
+ *
+ * \param   seed xored into the key before mixing; a map with a secret seed
+ *               spreads keys in a way an outsider cannot predict.
+ */
+template<BatchHashable K>
+inline uint64_t hash_key(const K& key, uint64_t seed = 0)
+{
+    uint64_t x = 0;
+    std::memcpy(&x, &key, sizeof(K));
+    return mix64(x ^ seed);
+}
+
+/*!
+ * \brief   a fresh hash seed for a map.
+ *
+ * \note    a per-process secret from std::random_device stepped by a
+ *          counter and mixed, so no two maps share a seed and none can be
+ *          guessed from outside the process. not a cryptographic PRF: it
+ *          keeps clients from aiming keys at one bucket, nothing more.
+ */
+inline uint64_t random_seed()
+{
+    static const uint64_t secret =
+        uint64_t(std::random_device{}()) << 32 ^ std::random_device{}();
+    static std::atomic<uint64_t> counter{0};
+    return mix64(secret + counter.fetch_add(0x9e3779b97f4a7c15ULL,
+                                            std::memory_order_relaxed));
+}
+
+namespace detail
+{
+template<typename K>
+void hash_batch_scalar(const K* keys, uint64_t* out, size_t n, uint64_t seed)
+{
+    for (size_t i = 0; i < n; ++i) out[i] = hash_key(keys[i], seed);
+}
+
+#ifdef EHASH_X86_KERNELS
+/*!
+ * \brief   load 8 keys of 4 or 8 bytes as zero-extended 64-bit lanes.
+ */
+template<typename K>
+__attribute__((target("avx512f,avx512dq"))) inline __m512i
+load8(const K* keys)
+{
+    if constexpr (sizeof(K) == 8)
+    {
+        return _mm512_loadu_si512(keys);
+    }
+    else
+    {
+        return _mm512_cvtepu32_epi64(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys)));
+    }
+}
+
+template<typename K>
+__attribute__((target("avx512f,avx512dq"))) void
+hash_batch_avx512(const K* keys, uint64_t* out, size_t n, uint64_t seed)
+{
+    const __m512i c1 = _mm512_set1_epi64(0xff51afd7ed558ccdULL);
+    const __m512i c2 = _mm512_set1_epi64(0xc4ceb9fe1a85ec53ULL);
+    const __m512i s = _mm512_set1_epi64(int64_t(seed));
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m512i x = _mm512_xor_si512(load8(keys + i), s);
+        x = _mm512_xor_si512(x, _mm512_srli_epi64(x, 33));
+        x = _mm512_mullo_epi64(x, c1);
+        x = _mm512_xor_si512(x, _mm512_srli_epi64(x, 33));
+        x = _mm512_mullo_epi64(x, c2);
+        x = _mm512_xor_si512(x, _mm512_srli_epi64(x, 33));
+        _mm512_storeu_si512(out + i, x);
+    }
+    hash_batch_scalar(keys + i, out + i, n - i, seed);
+}
+
+/*!
+ * \brief   64x64 -> low 64 multiply; AVX2 only has 32x32 -> 64.
+ */
+__attribute__((target("avx2"))) inline __m256i mullo64(__m256i a, __m256i b)
+{
+    __m256i lo = _mm256_mul_epu32(a, b);
+    __m256i ahi_b = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), b);
+    __m256i a_bhi = _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32));
+    __m256i hi = _mm256_slli_epi64(_mm256_add_epi64(ahi_b, a_bhi), 32);
+    return _mm256_add_epi64(lo, hi);
+}
+
+template<typename K>
+__attribute__((target("avx2"))) inline __m256i load4(const K* keys)
+{
+    if constexpr (sizeof(K) == 8)
+    {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys));
+    }
+    else
+    {
+        return _mm256_cvtepu32_epi64(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys)));
+    }
+}
+
+template<typename K>
+__attribute__((target("avx2"))) void
+hash_batch_avx2(const K* keys, uint64_t* out, size_t n, uint64_t seed)
+{
+    const __m256i c1 = _mm256_set1_epi64x(0xff51afd7ed558ccdLL);
+    const __m256i c2 = _mm256_set1_epi64x(0xc4ceb9fe1a85ec53LL);
+    const __m256i s = _mm256_set1_epi64x(int64_t(seed));
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256i x = _mm256_xor_si256(load4(keys + i), s);
+        x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 33));
+        x = mullo64(x, c1);
+        x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 33));
+        x = mullo64(x, c2);
+        x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 33));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), x);
+    }
+    hash_batch_scalar(keys + i, out + i, n - i, seed);
+}
+#endif
+
+/*!
+ * \brief   instruction set picked for hash_batch().
+ */
+enum class Isa
+{
+    Scalar,
+    Avx2,
+    Avx512
+};
+
+inline Isa detect_isa()
+{
+#ifdef EHASH_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") &&
+        __builtin_cpu_supports("avx512dq"))
+    {
+        return Isa::Avx512;
+    }
+    if (__builtin_cpu_supports("avx2")) return Isa::Avx2;
+#endif
+    return Isa::Scalar;
+}
+
+/*!
+ * \brief   isa used by hash_batch(); overridable for tests and benchmarks.
+ */
+inline Isa& active_isa()
+{
+    static Isa isa = detect_isa();
+    return isa;
+}
+} // namespace detail
+
+/*!
+ * \brief   hash keys.size() keys into out[0..keys.size()).
+ *
+ * \param   keys input keys
+ * \param   out  output hashes, at least keys.size() long
+ * \param   seed as for hash_key()
+ *
+ * \note    produces exactly hash_key(keys[i], seed) for every i.
+ */
+template<BatchHashable K>
+void hash_batch(std::span<const K> keys, std::span<uint64_t> out,
+                uint64_t seed = 0)
+{
+    const size_t n = keys.size() < out.size() ? keys.size() : out.size();
+
+#ifdef EHASH_X86_KERNELS
+    if constexpr (sizeof(K) == 4 || sizeof(K) == 8)
+    {
+        switch (detail::active_isa())
+        {
+        case detail::Isa::Avx512:
+            detail::hash_batch_avx512(keys.data(), out.data(), n, seed);
+            return;
+        case detail::Isa::Avx2:
+            detail::hash_batch_avx2(keys.data(), out.data(), n, seed);
+            return;
+        case detail::Isa::Scalar:
+            break;
+        }
+    }
+#endif
+    detail::hash_batch_scalar(keys.data(), out.data(), n, seed);
+}
+} // namespace ehash
@@ -0,0 +1,240 @@
+
+/*!
+ * \file    lib/EHashCoro.h
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   EHash lookups as C++20 coroutines, interleaved to overlap cache
+ *          misses.
+ *
+ * \note    a find() on a table far larger than the cache waits on memory
+ *          for the bucket, then for each chunk, and the core idles
+ *          meanwhile. here a lookup prefetches each line it is about to
+ *          read and suspends; a Scheduler resumes dozens of lookups round
+ *          robin, so by the time one runs again its line has arrived and
+ *          the misses of all of them overlap.
+ *
+ *          application code stays per key:
+ *
+ *              ehash::Task add(Map& m, uint64_t k, uint64_t& sum)
+ *              {
+ *                  if (uint64_t* v = co_await ehash::lookup(m, k)) sum += *v;
+ *              }
+ *
+ *              ehash::Scheduler s(32);
+ *              s.run(keys.size(), [&](size_t i) {
+ *                  return add(m, keys[i], sum);
+ *              });
+ *
+ *          a Task may await any number of lookups, one after the other.
+ *          only tasks are coroutines, with frames from the NodePool; a
+ *          lookup is an awaitable the scheduler steps through its task.
+ */
+
+#pragma once
+#include "EHash.h"
+#include "EHashPool.h"
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ehash
+{
+/*!
+ * \brief   coroutine frames from the NodePool.
+ */
+struct PooledFrame
+{
+    static void* operator new(size_t bytes)
+    {
+        return NodePool::allocate(bytes);
+    }
+
+    static void operator delete(void* p, size_t bytes)
+    {
+        NodePool::deallocate(p, bytes);
+    }
+};
+
+/*!
+ * \brief   an application coroutine run by a Scheduler.
+ *
+ * \note    starts suspended. while it awaits a lookup, resume() advances
+ *          the lookup one memory access instead of running the body. an
+ *          exception escaping the body is rethrown by the resume() that
+ *          finishes it.
+ */
+class Task
+{
+  public:
+    struct promise_type : PooledFrame
+    {
+        bool (*advance)(void*) = nullptr; //!< step of the awaited lookup
+        void* awaited = nullptr;          //!< the lookup
+        std::exception_ptr error;         //!< what the body threw
+
+        Task get_return_object()
+        {
+            return Task(
+                std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    Task() = default;
+    Task(Task&& o) noexcept : h(std::exchange(o.h, nullptr)) {}
+
+    Task& operator=(Task&& o) noexcept
+    {
+        std::swap(h, o.h);
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task()
+    {
+        if (h) h.destroy();
+    }
+
+    /*!
+     * \brief   finished, or never started.
+     */
+    bool done() const { return !h || h.done(); }
+
+    /*!
+     * \brief   take the awaited lookup one memory access further, or run
+     *          the body to its next suspension once the lookup has its
+     *          result.
+     */
+    void resume()
+    {
+        promise_type& p = h.promise();
+        if (p.advance)
+        {
+            if (!p.advance(p.awaited)) return;
+            p.advance = nullptr;
+        }
+        h.resume();
+        if (h.done() && p.error) std::rethrow_exception(p.error);
+    }
+
+  private:
+    explicit Task(std::coroutine_handle<promise_type> h) : h(h) {}
+
+    std::coroutine_handle<promise_type> h;
+};
+
+/*!
+ * \brief   map.find(key) as an awaitable; see lookup().
+ *
+ * \note    suspends its task before every memory access, with a prefetch
+ *          of the line in flight. it is stepped by the scheduler through
+ *          the task, so a lookup costs no coroutine frame of its own.
+ */
+template<typename K, typename V, typename S> class Lookup
+{
+    using Map = EHash<K, V, S>;
+    typename Map::Probe probe;
+
+    static bool advance(void* self)
+    {
+        typename Map::Probe& p = static_cast<Lookup*>(self)->probe;
+        p.step();
+        if (p.done()) return true;
+        __builtin_prefetch(p.address());
+        return false;
+    }
+
+  public:
+    Lookup(Map& map, const K& key) : probe(map, key) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<Task::promise_type> task) noexcept
+    {
+        __builtin_prefetch(probe.address());
+        task.promise().advance = &advance;
+        task.promise().awaited = this;
+    }
+
+    V* await_resume() const noexcept { return probe.value(); }
+};
+
+/*!
+ * \brief   map.find(key) that suspends before every memory access; await
+ *          it from a Task.
+ *
+ * \note    yields a plain V*, as find_batch() does. key must outlive the
+ *          lookup, which a key in the awaiting expression does.
+ */
+template<typename K, typename V, typename S>
+Lookup<K, V, S> lookup(EHash<K, V, S>& map, const std::type_identity_t<K>& key)
+{
+    return Lookup<K, V, S>(map, key);
+}
+
+/*!
+ * \brief   runs Tasks round robin, width of them in flight at once.
+ *
+ * \note    width should cover the memory latency: about as many lookups as
+ *          the core can have misses outstanding, 16 to 64 on current
+ *          hardware. a wider window only adds frames to cycle through.
+ */
+class Scheduler
+{
+    std::vector<Task> slots;
+
+  public:
+    explicit Scheduler(size_t width = 32) : slots(width ? width : 1) {}
+
+    /*!
+     * \brief   run make(0) .. make(n - 1) to completion.
+     *
+     * \note    tasks are made as slots free up, so n may be far larger
+     *          than the window. an exception from a task ends the run; the
+     *          tasks still in flight are dropped.
+     */
+    template<typename F> void run(size_t n, F&& make)
+    {
+        size_t next = 0, live = 0;
+        for (Task& t : slots)
+        {
+            t = Task();
+            if (next < n)
+            {
+                t = make(next++);
+                live++;
+            }
+        }
+
+        while (live)
+        {
+            for (Task& t : slots)
+            {
+                if (t.done()) continue;
+                t.resume();
+                if (!t.done()) continue;
+                if (next < n)
+                {
+                    t = make(next++);
+                }
+                else
+                {
+                    t = Task();
+                    live--;
+                }
+            }
+        }
+    }
+};
+} // namespace ehash
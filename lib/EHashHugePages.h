@@ -0,0 +1,152 @@
+
+/*!
+ * \file    lib/EHashHugePages.h
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   2 MiB page backing for large arrays and pool slabs.
+ *
+ * \note    a random lookup in a multi-gigabyte table misses the dTLB almost
+ *          every time: 4 KiB pages give the TLB a reach of a few MiB. the
+ *          regions handed out here are mapped 2 MiB aligned and either
+ *          advised for transparent huge pages (MADV_HUGEPAGE, works when
+ *          the system setting is "madvise" or "always") or taken from the
+ *          hugetlbfs pool (MAP_HUGETLB, needs pages reserved in
+ *          /proc/sys/vm/nr_hugepages; falls back to advice without them).
+ *
+ *          the mode is process wide and read when a region is mapped, so
+ *          it only affects what is allocated after setMode().
+ */
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <sys/mman.h>
+
+namespace ehash
+{
+class HugePages
+{
+  public:
+    static constexpr size_t PageBytes = 2 << 20; //!< huge page size
+
+    enum class Mode
+    {
+        Off,         //!< 4 KiB pages (MADV_NOHUGEPAGE)
+        Transparent, //!< MADV_HUGEPAGE on aligned regions
+        Explicit     //!< MAP_HUGETLB, else Transparent
+    };
+
+    static void setMode(Mode m) { current().store(m, std::memory_order_relaxed); }
+    static Mode mode() { return current().load(std::memory_order_relaxed); }
+
+    /*!
+     * \brief   zeroed region of bytes rounded up to PageBytes, aligned to
+     *          PageBytes unless the mode is Off.
+     *
+     * \return  nullptr if the system is out of memory.
+     */
+    static void* map(size_t bytes)
+    {
+        size_t len = roundUp(bytes);
+        Mode m = mode();
+
+#if defined(MAP_HUGETLB)
+        if (m == Mode::Explicit)
+        {
+            void* p = ::mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (p != MAP_FAILED) return p;
+        }
+#endif
+        if (m == Mode::Off)
+        {
+            void* p = ::mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED) return nullptr;
+#if defined(MADV_NOHUGEPAGE)
+            ::madvise(p, len, MADV_NOHUGEPAGE);
+#endif
+            return p;
+        }
+
+        // over-map by one page and trim both ends to the alignment
+        void* raw = ::mmap(nullptr, len + PageBytes, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) return nullptr;
+        char* base = static_cast<char*>(raw);
+        size_t head = -reinterpret_cast<uintptr_t>(base) & (PageBytes - 1);
+        if (head) ::munmap(base, head);
+        ::munmap(base + head + len, PageBytes - head);
+#if defined(MADV_HUGEPAGE)
+        ::madvise(base + head, len, MADV_HUGEPAGE);
+#endif
+        return base + head;
+    }
+
+    /*!
+     * \brief   give back a region; bytes must match the map() call.
+     */
+    static void unmap(void* p, size_t bytes)
+    {
+        if (p) ::munmap(p, roundUp(bytes));
+    }
+
+  private:
+    static size_t roundUp(size_t bytes)
+    {
+        return (std::max<size_t>(bytes, 1) + PageBytes - 1) & ~(PageBytes - 1);
+    }
+
+    static std::atomic<Mode>& current()
+    {
+        static std::atomic<Mode> m{Mode::Transparent};
+        return m;
+    }
+};
+
+/*!
+ * \brief   allocator that maps arrays of a huge page or more through
+ *          HugePages and leaves smaller ones to operator new.
+ *
+ * \note    the size alone picks the path, so deallocate() takes the same
+ *          one whatever the mode is by then.
+ */
+template<typename T> struct HugePageAllocator
+{
+    using value_type = T;
+    using is_always_equal = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+
+    HugePageAllocator() = default;
+    template<typename U> HugePageAllocator(const HugePageAllocator<U>&) {}
+
+    T* allocate(size_t n)
+    {
+        size_t bytes = n * sizeof(T);
+        if (bytes < HugePages::PageBytes) return std::allocator<T>{}.allocate(n);
+
+        void* p = HugePages::map(bytes);
+        if (!p) throw std::bad_alloc();
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        size_t bytes = n * sizeof(T);
+        if (bytes < HugePages::PageBytes) std::allocator<T>{}.deallocate(p, n);
+        else HugePages::unmap(p, bytes);
+    }
+
+    template<typename U> bool operator==(const HugePageAllocator<U>&) const
+    {
+        return true;
+    }
+};
+} // namespace ehash
@@ -0,0 +1,196 @@
+
+/*!
+ * \file    lib/EHashNuma.h
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   NUMA node discovery and memory placement without libnuma.
+ *
+ * \note    linux puts a page on the node of the thread that first touches
+ *          it, so a table built by one thread lives on one node and every
+ *          other node pays remote latency for it. the calls here steer
+ *          that: preferNode() sets the calling thread's policy (everything
+ *          it allocates and touches afterwards, pool slabs included, goes
+ *          to the node), bind() moves an existing range. both go straight
+ *          to the set_mempolicy/mbind system calls.
+ *
+ *          topology comes from /sys/devices/system/node. on a single-node
+ *          machine (or without that directory) nodes() is 1 and placement
+ *          is a no-op that succeeds, so callers need no special case.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <linux/mempolicy.h>
+#include <string>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+namespace ehash
+{
+class Numa
+{
+  public:
+    static constexpr int MaxNodes = 1024; //!< size of the node masks
+
+    /*!
+     * \brief   "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}; the format of
+     *          the sysfs node and cpu lists.
+     */
+    static std::vector<int> parseList(const std::string& text)
+    {
+        std::vector<int> out;
+        const char* s = text.c_str();
+        while (*s)
+        {
+            char* end;
+            long lo = std::strtol(s, &end, 10);
+            if (end == s) break;
+            long hi = lo;
+            if (*end == '-') hi = std::strtol(end + 1, &end, 10);
+            for (long i = lo; i <= hi; ++i) out.push_back(int(i));
+            s = *end == ',' ? end + 1 : end;
+            if (*s == '\n') break;
+        }
+        return out;
+    }
+
+    /*!
+     * \brief   online nodes, {0} when the system does not say.
+     */
+    static const std::vector<int>& online()
+    {
+        static const std::vector<int> list = [] {
+            std::vector<int> l =
+                parseList(readLine("/sys/devices/system/node/online"));
+            return l.empty() ? std::vector<int>{0} : l;
+        }();
+        return list;
+    }
+
+    /*!
+     * \brief   number of online nodes.
+     */
+    static size_t nodes() { return online().size(); }
+
+    /*!
+     * \brief   cpus of a node; empty when unknown.
+     */
+    static std::vector<int> cpusOf(int node)
+    {
+        return parseList(readLine("/sys/devices/system/node/node" +
+                                  std::to_string(node) + "/cpulist"));
+    }
+
+    /*!
+     * \brief   node of a cpu; 0 when unknown.
+     */
+    static int nodeOfCpu(int cpu)
+    {
+        for (int node : online())
+        {
+            for (int c : cpusOf(node))
+            {
+                if (c == cpu) return node;
+            }
+        }
+        return 0;
+    }
+
+    /*!
+     * \brief   allocate the calling thread's new pages on node, falling
+     *          back to other nodes when it is full.
+     *
+     * \return  false if node is not online or the kernel refused; the
+     *          policy is unchanged then.
+     */
+    static bool preferNode(int node)
+    {
+        if (!isOnline(node)) return false;
+        if (nodes() <= 1) return true;
+        Mask mask;
+        mask.set(node);
+        return ::syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask.bits,
+                         Mask::Bits + 1) == 0;
+    }
+
+    /*!
+     * \brief   place the pages of [p, p + bytes) on node, moving the ones
+     *          already touched.
+     *
+     * \note    the range is widened to whole pages. false if node is not
+     *          online or the kernel refused.
+     */
+    static bool bind(void* p, size_t bytes, int node)
+    {
+        if (!isOnline(node)) return false;
+        if (nodes() <= 1) return true;
+        Mask mask;
+        mask.set(node);
+
+        uintptr_t page = uintptr_t(::sysconf(_SC_PAGESIZE));
+        uintptr_t start = reinterpret_cast<uintptr_t>(p) & ~(page - 1);
+        uintptr_t end = reinterpret_cast<uintptr_t>(p) + bytes;
+        return ::syscall(SYS_mbind, start, end - start, MPOL_PREFERRED,
+                         mask.bits, Mask::Bits + 1, MPOL_MF_MOVE) == 0;
+    }
+
+    /*!
+     * \brief   node of the page holding p, -1 if it is not mapped yet or
+     *          the kernel has no NUMA support.
+     */
+    static int nodeOf(const void* p)
+    {
+        int node = -1;
+        if (::syscall(SYS_get_mempolicy, &node, nullptr, 0, p,
+                      MPOL_F_NODE | MPOL_F_ADDR) != 0)
+        {
+            return -1;
+        }
+        return node;
+    }
+
+    /*!
+     * \brief   node is one of online().
+     */
+    static bool isOnline(int node)
+    {
+        for (int n : online())
+        {
+            if (n == node) return true;
+        }
+        return false;
+    }
+
+  private:
+    struct Mask
+    {
+        static constexpr size_t Word = sizeof(unsigned long) * 8;
+        static constexpr size_t Bits = MaxNodes;
+        unsigned long bits[Bits / Word] = {};
+
+        void set(int node)
+        {
+            if (node < 0 || node >= MaxNodes) return;
+            bits[node / Word] |= 1ul << (node % Word);
+        }
+    };
+
+    static std::string readLine(const std::string& path)
+    {
+        std::string line;
+        if (FILE* f = std::fopen(path.c_str(), "r"))
+        {
+            char buf[4096];
+            if (std::fgets(buf, sizeof buf, f)) line = buf;
+            std::fclose(f);
+        }
+        return line;
+    }
+};
+} // namespace ehash
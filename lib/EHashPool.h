@@ -0,0 +1,333 @@
+
+/*!
+ * \file    lib/EHashPool.h
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   size-class pool for small, short-lived nodes.
+ *
+ * \note    blocks are handed out in 16-byte granules from 2 MiB slabs.
+ *          each thread keeps its own free lists, so allocate/deallocate are
+ *          a few loads and stores without atomics. a block freed on another
+ *          thread goes to that thread's lists; when a thread exits, or
+ *          frees far more of a size than it allocates, its lists go whole
+ *          to a shared depot, without a walk over their blocks, and
+ *          other threads refill empty lists from there. an exiting thread's
+ *          uncarved slab end goes there too, for the next thread needing
+ *          a slab, so short-lived workers do not map one each.
+ *          slabs are never returned to the system: the pool only grows
+ *          to the peak.
+ *
+ *          blocks whose size is a multiple of 64 bytes start on a cache
+ *          line, so a node of one line never straddles two. slabs are
+ *          one huge page each (see EHashHugePages.h), so the nodes of a
+ *          large table are covered by few TLB entries.
+ */
+
+#pragma once
+#include "EHashHugePages.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace ehash
+{
+class NodePool
+{
+  public:
+    static constexpr size_t Granule = 16;        //!< block size step
+    static constexpr size_t LineBytes = 64;      //!< cache line
+    static constexpr size_t MaxBytes = 4096;     //!< bigger: operator new
+    static constexpr size_t SlabBytes = HugePages::PageBytes; //!< mapped
+    static constexpr size_t BatchBytes = 4096;   //!< carved per refill
+    static constexpr size_t KeepBytes = 65536;   //!< per list, then depot
+    static constexpr size_t Classes = MaxBytes / Granule;
+
+    /*!
+     * \brief   block of at least bytes, aligned to Granule.
+     */
+    static void* allocate(size_t bytes)
+    {
+        if (bytes > MaxBytes) return ::operator new(bytes);
+
+        size_t cls = classOf(bytes);
+        Cache& c = cache();
+        if (!c.lists[cls]) refill(c, cls);
+
+        FreeBlock* b = c.lists[cls];
+        c.lists[cls] = b->next;
+        c.counts[cls]--;
+        return b;
+    }
+
+    /*!
+     * \brief   give back a block; bytes must match the allocate() call.
+     */
+    static void deallocate(void* p, size_t bytes)
+    {
+        if (bytes > MaxBytes)
+        {
+            ::operator delete(p);
+            return;
+        }
+
+        size_t cls = classOf(bytes);
+        Cache& c = cache();
+        auto* b = static_cast<FreeBlock*>(p);
+        b->next = c.lists[cls];
+        c.lists[cls] = b;
+        if (++c.counts[cls] == keepOf(cls)) retire(c, cls);
+    }
+
+  private:
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    using List = std::pair<FreeBlock*, uint32_t>; //!< head, length
+
+    /*!
+     * \brief   free lists given up by threads, one stack of lists per class.
+     */
+    struct Depot
+    {
+        std::mutex lock;
+        std::vector<List> lists[Classes];
+        std::vector<std::pair<char*, char*>> tails; //!< uncarved slab ends
+        std::atomic<bool> stocked{false}; //!< anything deposited yet
+    };
+
+    /*!
+     * \brief   per-thread free lists and the slab being carved.
+     */
+    struct Cache
+    {
+        FreeBlock* lists[Classes] = {};
+        uint32_t counts[Classes] = {};    //!< blocks on lists[cls]
+        FreeBlock* spares[Classes] = {};  //!< a full list, held back
+        char* bump = nullptr; //!< next unused byte of the slab
+        char* end = nullptr;  //!< end of the slab
+
+        ~Cache()
+        {
+            Depot& d = depot();
+            std::lock_guard<std::mutex> guard(d.lock);
+            for (size_t cls = 0; cls < Classes; ++cls)
+            {
+                auto& stack = d.lists[cls];
+                if (lists[cls]) stack.emplace_back(lists[cls], counts[cls]);
+                if (spares[cls]) stack.emplace_back(spares[cls], keepOf(cls));
+            }
+            if (bump && size_t(end - bump) >= MaxBytes + LineBytes)
+            {
+                d.tails.emplace_back(bump, end);
+            }
+            d.stocked.store(true, std::memory_order_relaxed);
+        }
+    };
+
+    static size_t classOf(size_t bytes)
+    {
+        return bytes ? (bytes - 1) / Granule : 0;
+    }
+
+    static uint32_t keepOf(size_t cls)
+    {
+        return uint32_t(KeepBytes / ((cls + 1) * Granule));
+    }
+
+    /*!
+     * \brief   set aside a full list; the one set aside before goes to the
+     *          depot.
+     *
+     * \note    a thread that frees more than it allocates, such as one
+     *          dropping snapshots whose chains other threads unshared,
+     *          would otherwise hoard blocks those threads map anew. the
+     *          spare keeps a thread that frees and allocates around the
+     *          limit off the depot lock.
+     */
+    static void retire(Cache& c, size_t cls)
+    {
+        if (FreeBlock* spare = c.spares[cls])
+        {
+            Depot& d = depot();
+            std::lock_guard<std::mutex> guard(d.lock);
+            d.lists[cls].emplace_back(spare, keepOf(cls));
+            d.stocked.store(true, std::memory_order_relaxed);
+        }
+        c.spares[cls] = c.lists[cls];
+        c.lists[cls] = nullptr;
+        c.counts[cls] = 0;
+    }
+
+    static Depot& depot()
+    {
+        static Depot* d = new Depot; // outlives every thread's cache
+        return *d;
+    }
+
+    static Cache& cache()
+    {
+        thread_local Cache c;
+        return c;
+    }
+
+    /*!
+     * \brief   carve on from a slab end left by an exited thread.
+     *
+     * \return  false if the depot has none.
+     */
+    static bool adoptTail(Cache& c)
+    {
+        Depot& d = depot();
+        if (!d.stocked.load(std::memory_order_relaxed)) return false;
+
+        std::lock_guard<std::mutex> guard(d.lock);
+        if (d.tails.empty()) return false;
+        std::tie(c.bump, c.end) = d.tails.back();
+        d.tails.pop_back();
+        return true;
+    }
+
+    static void refill(Cache& c, size_t cls)
+    {
+        if (c.spares[cls])
+        {
+            c.lists[cls] = std::exchange(c.spares[cls], nullptr);
+            c.counts[cls] = keepOf(cls);
+            return;
+        }
+
+        Depot& d = depot();
+        if (d.stocked.load(std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> guard(d.lock);
+            if (!d.lists[cls].empty())
+            {
+                std::tie(c.lists[cls], c.counts[cls]) = d.lists[cls].back();
+                d.lists[cls].pop_back();
+                return;
+            }
+        }
+
+        // carve a batch, so slab bookkeeping is off the per-block path
+        size_t bytes = (cls + 1) * Granule;
+        size_t align = bytes % LineBytes ? Granule : LineBytes;
+        for (size_t n = std::max<size_t>(BatchBytes / bytes, 1); n; --n)
+        {
+            c.bump += -reinterpret_cast<uintptr_t>(c.bump) & (align - 1);
+            if (c.bump > c.end || size_t(c.end - c.bump) < bytes)
+            {
+                // the tail of the old slab is lost; under MaxBytes per slab
+                if (!adoptTail(c))
+                {
+                    c.bump = static_cast<char*>(HugePages::map(SlabBytes));
+                    if (!c.bump) throw std::bad_alloc();
+                    c.end = c.bump + SlabBytes;
+                }
+                c.bump += -reinterpret_cast<uintptr_t>(c.bump) & (align - 1);
+            }
+
+            auto* b = reinterpret_cast<FreeBlock*>(c.bump);
+            b->next = c.lists[cls];
+            c.lists[cls] = b;
+            c.counts[cls]++;
+            c.bump += bytes;
+        }
+    }
+};
+
+/*!
+ * \brief   value kept out of line in a pool block; the owner holds only
+ *          the pointer.
+ *
+ * \note    moving one moves the pointer, so the value itself never moves
+ *          and pointers to it stay valid. copying copies the value into a
+ *          new block.
+ */
+template<typename V> class PooledValue
+{
+    V* p; //!< null once moved from
+
+    static void* allocate()
+    {
+        if constexpr (alignof(V) > NodePool::Granule)
+        {
+            return ::operator new(sizeof(V), std::align_val_t(alignof(V)));
+        }
+        else
+        {
+            return NodePool::allocate(sizeof(V));
+        }
+    }
+
+    static void release(void* b)
+    {
+        if constexpr (alignof(V) > NodePool::Granule)
+        {
+            ::operator delete(b, std::align_val_t(alignof(V)));
+        }
+        else
+        {
+            NodePool::deallocate(b, sizeof(V));
+        }
+    }
+
+  public:
+    explicit PooledValue(const V& v)
+    {
+        void* b = allocate();
+        try
+        {
+            p = new (b) V(v);
+        }
+        catch (...)
+        {
+            release(b); // a throwing copy must not strand the block
+            throw;
+        }
+    }
+
+    PooledValue(const PooledValue& o) : PooledValue(*o.p) {}
+    PooledValue(PooledValue&& o) noexcept : p(std::exchange(o.p, nullptr)) {}
+
+    PooledValue& operator=(PooledValue o) noexcept
+    {
+        std::swap(p, o.p);
+        return *this;
+    }
+
+    PooledValue& operator=(const V& v)
+    {
+        *p = v; // in place: the value keeps its address
+        return *this;
+    }
+
+    ~PooledValue()
+    {
+        if (!p) return;
+        p->~V();
+        release(p);
+    }
+
+    V& get() const { return *p; }
+};
+
+/*!
+ * \brief   whether a Flat EHash stores values of type V out of line
+ *          (a Stable one always does).
+ *
+ * \note    on for values over 32 bytes: a rehash then moves 8-byte handles
+ *          and a chain walk reads keys without the values between them.
+ *          specialize to force either layout for a type.
+ */
+template<typename V> inline constexpr bool storeOutOfLine = sizeof(V) > 32;
+} // namespace ehash
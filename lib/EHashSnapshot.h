@@ -0,0 +1,218 @@
+
+/*!
+ * \file    lib/EHashSnapshot.h
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   point-in-time EHash snapshots, written in the background.
+ *
+ * \note    snapshotInBackground() forks: the child sees the map exactly as
+ *          it was at fork() and writes it out while the parent keeps
+ *          mutating its own copy. the kernel copies a page only when the
+ *          parent first writes to it, so the serving path pays for fork()
+ *          (page table copy) and for the pages it touches meanwhile, not
+ *          for the walk.
+ *
+ *          buckets and pool slabs sit on 2 MiB pages (EHashHugePages.h).
+ *          a transparent huge page written during a snapshot is split and
+ *          only its 4 KiB page copied on current kernels, so the fault
+ *          costs what a small page does, but the parent keeps the split
+ *          mapping until khugepaged collapses it again: a snapshot under
+ *          heavy writes gives back much of the TLB reach (test_snapshot
+ *          measures both). hugetlbfs pages (HugePages::Mode::Explicit) are
+ *          copied whole, 2 MiB per first write, and need a free page in
+ *          the reserve for it; without one the kernel kills the child
+ *          and the snapshot reports Failed.
+ *
+ *          file := magic[8] | u64 tag | u64 records | records
+ *
+ *          records use the EHashWal framing (insert records only); tag is
+ *          the caller's, e.g. the first log segment the snapshot does not
+ *          cover. the file is written to <path>.tmp, synced and renamed,
+ *          so <path> is always a complete snapshot or the previous one.
+ */
+
+#pragma once
+#include "EHashWal.h"
+#include <cstdio>
+#include <sched.h>
+#include <string>
+#include <sys/wait.h>
+
+namespace ehash
+{
+constexpr char SnapshotMagic[8] = {'E', 'H', 'S', 'N', 'A', 'P', '1', '\0'};
+constexpr size_t SnapshotHeader = 24;
+
+/*!
+ * \brief   state of a background snapshot.
+ */
+enum class SnapshotStatus
+{
+    Running,
+    Done,
+    Failed
+};
+
+namespace detail
+{
+inline bool writeAll(int fd, const char* p, size_t n)
+{
+    while (n)
+    {
+        ssize_t w = ::write(fd, p, n);
+        if (w < 0 && errno == EINTR) continue;
+        if (w < 0) return false;
+        p += w;
+        n -= size_t(w);
+    }
+    return true;
+}
+
+inline bool syncParentDir(const std::string& path)
+{
+    size_t slash = path.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : path.substr(0, slash);
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return false;
+    bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+} // namespace detail
+
+/*!
+ * \brief   write map to path, synchronously.
+ *
+ * \return  false on an I/O error; path is then left untouched.
+ */
+template<typename K, typename V, typename S>
+bool writeSnapshot(const EHash<K, V, S>& map, const std::string& path,
+                   uint64_t tag)
+{
+    constexpr size_t Chunk = 1 << 20;
+
+    std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                    0644);
+    if (fd < 0) return false;
+
+    std::string buf;
+    buf.reserve(Chunk + 4096);
+    buf.append(SnapshotMagic, sizeof SnapshotMagic);
+    uint64_t records = map.size();
+    detail::walPut(buf, tag);
+    detail::walPut(buf, records);
+
+    bool ok = true;
+    map.forEach([&](const K& key, const V& value) {
+        detail::walRecord(buf, detail::WalOp::Insert, key, &value);
+        if (buf.size() >= Chunk && ok)
+        {
+            ok = detail::writeAll(fd, buf.data(), buf.size());
+            buf.clear();
+        }
+    });
+
+    ok = ok && detail::writeAll(fd, buf.data(), buf.size());
+    ok = ok && ::fdatasync(fd) == 0;
+    ok = ::close(fd) == 0 && ok;
+    ok = ok && ::rename(tmp.c_str(), path.c_str()) == 0;
+    ok = ok && detail::syncParentDir(path);
+    if (!ok) ::unlink(tmp.c_str());
+    return ok;
+}
+
+/*!
+ * \brief   fork and write map to path from the child.
+ *
+ * \return  child pid to pass to snapshotStatus(); -1 if fork() failed.
+ *
+ * \note    only the calling thread exists in the child, so the map must
+ *          not be mutated by any other thread around the call. the child
+ *          closes inherited descriptors (sockets the parent closes must not
+ *          linger), drops the caller's CPU pinning so it does not compete
+ *          with it, and skips atexit handlers and stdio flushing.
+ */
+template<typename K, typename V, typename S>
+pid_t snapshotInBackground(const EHash<K, V, S>& map,
+                           const std::string& path, uint64_t tag)
+{
+    pid_t pid = ::fork();
+    if (pid != 0) return pid;
+
+    ::close_range(3, ~0u, 0);
+    cpu_set_t all;
+    CPU_ZERO(&all);
+    for (long i = 0, n = ::sysconf(_SC_NPROCESSORS_ONLN); i < n; ++i)
+    {
+        CPU_SET(i, &all);
+    }
+    ::sched_setaffinity(0, sizeof all, &all);
+
+    ::_exit(writeSnapshot(map, path, tag) ? 0 : 1);
+}
+
+/*!
+ * \brief   poll (or with wait, reap) a snapshotInBackground() child.
+ */
+inline SnapshotStatus snapshotStatus(pid_t pid, bool wait)
+{
+    int status = 0;
+    pid_t r;
+    do
+    {
+        r = ::waitpid(pid, &status, wait ? 0 : WNOHANG);
+    } while (r < 0 && errno == EINTR);
+
+    if (r == 0) return SnapshotStatus::Running;
+    if (r < 0) return SnapshotStatus::Failed;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0
+               ? SnapshotStatus::Done
+               : SnapshotStatus::Failed;
+}
+
+/*!
+ * \brief   load a snapshot into map.
+ *
+ * \param   tag receives the snapshot's tag; 0 when there is no snapshot
+ * \return  false if the file exists but is unreadable or incomplete.
+ */
+template<typename K, typename V, typename S>
+bool loadSnapshot(const std::string& path, EHash<K, V, S>& map,
+                  uint64_t& tag)
+{
+    tag = 0;
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return errno == ENOENT;
+
+    struct stat st;
+    bool ok = ::fstat(fd, &st) == 0;
+    auto size = ok ? static_cast<size_t>(st.st_size) : 0;
+    ok = ok && size >= SnapshotHeader;
+
+    void* m = ok ? ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0)
+                 : MAP_FAILED;
+    ::close(fd);
+    if (m == MAP_FAILED) return false;
+    ::madvise(m, size, MADV_SEQUENTIAL);
+
+    const char* base = static_cast<const char*>(m);
+    const char* p = base + sizeof SnapshotMagic;
+    uint64_t records = 0;
+    ok = std::memcmp(base, SnapshotMagic, sizeof SnapshotMagic) == 0 &&
+         detail::walGet(p, base + size, tag) &&
+         detail::walGet(p, base + size, records);
+
+    if (ok)
+    {
+        map.reserve(map.size() + records);
+        WalReplay r = detail::walApply(base + SnapshotHeader,
+                                       size - SnapshotHeader, map);
+        ok = r.records == records && r.tornBytes == 0;
+    }
+    ::munmap(m, size);
+    return ok;
+}
+} // namespace ehash
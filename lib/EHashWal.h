@@ -0,0 +1,428 @@
+
+/*!
+ * \file    lib/EHashWal.h
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   append-only write-ahead log for EHash mutations.
+ *
+ * \note    records are buffered in memory and written with one write() per
+ *          commit(); fdatasync runs once per sync interval or byte threshold
+ *          (group commit), so a burst of writes shares a single sync.
+ *
+ *          record := u32 len | u32 crc32c | u8 op | key [value]
+ *
+ *          len and crc cover everything after the crc. fixed-width keys and
+ *          values are stored raw, std::string as u32 length + bytes (little
+ *          endian host order). replay stops at the first short or corrupt
+ *          record, or one with an op it does not know, and cuts the file
+ *          there: a torn tail from a crash mid write is dropped, never
+ *          misread.
+ */
+
+#pragma once
+#include "EHash.h"
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+
+namespace ehash
+{
+/*!
+ * \brief   group commit policy.
+ */
+struct WalOptions
+{
+    uint64_t syncIntervalUs = 1000; //!< fdatasync at least this often
+    size_t syncBytes = 1 << 20;     //!< or once this much is unsynced
+};
+
+/*!
+ * \brief   outcome of EHashWal::replay().
+ */
+struct WalReplay
+{
+    size_t records = 0;   //!< records applied
+    size_t bytes = 0;     //!< valid log bytes
+    size_t tornBytes = 0; //!< bytes cut off the end
+    bool ok = true;       //!< false if the file could not be read
+};
+
+namespace detail
+{
+enum class WalOp : uint8_t
+{
+    Insert = 1,
+    Remove = 2
+};
+
+constexpr size_t WalHeader = 8;          //!< len + crc
+constexpr uint32_t WalMaxRecord = 1u << 30; //!< sanity bound on len
+
+inline uint32_t crc32c_sw(uint32_t crc, const char* p, size_t n)
+{
+    static const auto table = [] {
+        struct T
+        {
+            uint32_t v[256];
+        } t{};
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c >> 1) ^ (0x82f63b78u & -(c & 1));
+            t.v[i] = c;
+        }
+        return t;
+    }();
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        crc = table.v[(crc ^ uint8_t(p[i])) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#ifdef EHASH_X86_KERNELS
+__attribute__((target("sse4.2"))) inline uint32_t
+crc32c_hw(uint32_t crc, const char* p, size_t n)
+{
+    uint64_t c = crc;
+    for (; n >= 8; p += 8, n -= 8)
+    {
+        uint64_t w;
+        std::memcpy(&w, p, 8);
+        c = _mm_crc32_u64(c, w);
+    }
+    for (; n; ++p, --n) c = _mm_crc32_u8(uint32_t(c), uint8_t(*p));
+    return uint32_t(c);
+}
+#endif
+
+/*!
+ * \brief   CRC-32C (Castagnoli), SSE4.2 instruction when available.
+ */
+inline uint32_t crc32c(const char* p, size_t n)
+{
+#ifdef EHASH_X86_KERNELS
+    static const bool hw = __builtin_cpu_supports("sse4.2");
+    if (hw) return ~crc32c_hw(~0u, p, n);
+#endif
+    return ~crc32c_sw(~0u, p, n);
+}
+
+/*!
+ * \brief   field codec; add overloads for other key/value types.
+ */
+template<typename T>
+    requires std::is_trivially_copyable_v<T>
+void walPut(std::string& out, const T& v)
+{
+    out.append(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+inline void walPut(std::string& out, const std::string& s)
+{
+    auto n = static_cast<uint32_t>(s.size());
+    walPut(out, n);
+    out.append(s);
+}
+
+template<typename T>
+    requires std::is_trivially_copyable_v<T>
+bool walGet(const char*& p, const char* end, T& v)
+{
+    if (size_t(end - p) < sizeof(T)) return false;
+    std::memcpy(&v, p, sizeof(T));
+    p += sizeof(T);
+    return true;
+}
+
+inline bool walGet(const char*& p, const char* end, std::string& s)
+{
+    uint32_t n;
+    if (!walGet(p, end, n) || size_t(end - p) < n) return false;
+    s.assign(p, n);
+    p += n;
+    return true;
+}
+
+/*!
+ * \brief   append one framed record; value is null for removals.
+ */
+template<typename K, typename V>
+void walRecord(std::string& out, WalOp op, const K& key, const V* value)
+{
+    size_t start = out.size();
+    out.append(WalHeader, '\0');
+    out += static_cast<char>(op);
+    walPut(out, key);
+    if (value) walPut(out, *value);
+
+    size_t body = start + WalHeader;
+    auto len = static_cast<uint32_t>(out.size() - body);
+    uint32_t crc = crc32c(out.data() + body, len);
+    std::memcpy(&out[start], &len, 4);
+    std::memcpy(&out[start + 4], &crc, 4);
+}
+
+/*!
+ * \brief   apply the records in [base, base + size) to map.
+ *
+ * \return  records applied; bytes is the valid prefix, tornBytes the rest.
+ */
+template<typename K, typename V, typename S>
+WalReplay walApply(const char* base, size_t size, EHash<K, V, S>& map)
+{
+    WalReplay r;
+
+    // pass 1: validate and count, so the map is sized only once
+    size_t inserts = 0;
+    size_t pos = 0;
+    while (size - pos >= WalHeader + 1)
+    {
+        uint32_t len, crc;
+        std::memcpy(&len, base + pos, 4);
+        std::memcpy(&crc, base + pos + 4, 4);
+        if (len == 0 || len > WalMaxRecord) break;
+        if (size - pos - WalHeader < len) break;
+        if (crc32c(base + pos + WalHeader, len) != crc) break;
+
+        // an op from a newer format is not taken for a remove
+        auto op = WalOp(base[pos + WalHeader]);
+        if (op != WalOp::Insert && op != WalOp::Remove) break;
+        inserts += op == WalOp::Insert;
+        pos += WalHeader + len;
+    }
+    r.bytes = pos;
+    r.tornBytes = size - pos;
+    map.reserve(map.size() + inserts);
+
+    // pass 2: apply
+    K key{};
+    V value{};
+    for (const char* p = base; p < base + r.bytes;)
+    {
+        uint32_t len;
+        std::memcpy(&len, p, 4);
+        const char* end = p + WalHeader + len;
+        const char* q = p + WalHeader + 1;
+
+        bool good = walGet(q, end, key);
+        if (good && WalOp(p[WalHeader]) == WalOp::Insert)
+        {
+            good = walGet(q, end, value);
+            if (good) map.insert(key, value);
+        }
+        else if (good)
+        {
+            map.remove(key);
+        }
+        r.records += good;
+        p = end;
+    }
+    return r;
+}
+} // namespace detail
+} // namespace ehash
+
+/*!
+ * \brief   write-ahead log of one EHash.
+ *
+ * \tparam  K key type (trivially copyable or std::string).
+ * \tparam  V value type (trivially copyable or std::string).
+ *
+ * \note    single writer. a mutation is durable once a commit() or sync()
+ *          that followed it has synced; see WalOptions for the window.
+ */
+template<typename K, typename V> class EHashWal
+{
+    using Clock = std::chrono::steady_clock;
+    using Op = ehash::detail::WalOp;
+
+    int fd = -1;
+    ehash::WalOptions opts;
+    std::string buf;             //!< records not yet written
+    size_t unsynced = 0;         //!< written bytes not yet synced
+    uint64_t durableRecords = 0; //!< records covered by a good sync
+    Clock::time_point lastSync;  //!< time of the last fdatasync
+
+    bool write()
+    {
+        size_t pos = 0;
+        while (pos < buf.size())
+        {
+            ssize_t n = ::write(fd, buf.data() + pos, buf.size() - pos);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0)
+            {
+                // keep the unwritten rest so a retry resumes mid record
+                buf.erase(0, pos);
+                unsynced += pos;
+                return false;
+            }
+            pos += size_t(n);
+        }
+        stats.writes += pos ? 1 : 0;
+        stats.bytes += pos;
+        unsynced += pos;
+        buf.clear();
+        return true;
+    }
+
+  public:
+    /*!
+     * \brief   counters for tuning the group commit policy.
+     */
+    struct Stats
+    {
+        uint64_t records = 0; //!< records logged
+        uint64_t bytes = 0;   //!< bytes written
+        uint64_t writes = 0;  //!< write() batches
+        uint64_t syncs = 0;   //!< fdatasync calls
+    } stats;
+
+    explicit EHashWal(ehash::WalOptions options = {}) : opts(options) {}
+
+    ~EHashWal()
+    {
+        if (fd >= 0)
+        {
+            sync();
+            ::close(fd);
+        }
+    }
+
+    EHashWal(const EHashWal&) = delete;
+    EHashWal& operator=(const EHashWal&) = delete;
+
+    /*!
+     * \brief   open (or create) the log; new records go to its end.
+     */
+    bool open(const std::string& path)
+    {
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC,
+                    0644);
+        lastSync = Clock::now();
+        return fd >= 0;
+    }
+
+    /*!
+     * \brief   apply every record of the open log to map.
+     *
+     * \note    sizes the map for the logged inserts before applying them,
+     *          and truncates a torn tail so later appends follow the last
+     *          good record. call once, right after open().
+     */
+    template<typename S> ehash::WalReplay replay(EHash<K, V, S>& map)
+    {
+        ehash::WalReplay r;
+
+        struct stat st;
+        if (::fstat(fd, &st) < 0)
+        {
+            r.ok = false;
+            return r;
+        }
+        auto size = static_cast<size_t>(st.st_size);
+        if (size == 0) return r;
+
+        void* m = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m == MAP_FAILED)
+        {
+            r.ok = false;
+            return r;
+        }
+        ::madvise(m, size, MADV_SEQUENTIAL);
+        r = ehash::detail::walApply(static_cast<const char*>(m), size, map);
+        ::munmap(m, size);
+
+        if (r.tornBytes && ::ftruncate(fd, static_cast<off_t>(r.bytes)) < 0)
+        {
+            r.ok = false;
+        }
+        return r;
+    }
+
+    /*!
+     * \brief   log map.insert(key, value).
+     */
+    void logInsert(const K& key, const V& value)
+    {
+        ehash::detail::walRecord(buf, Op::Insert, key, &value);
+        stats.records++;
+    }
+
+    /*!
+     * \brief   log map.remove(key).
+     */
+    void logRemove(const K& key)
+    {
+        ehash::detail::walRecord<K, V>(buf, Op::Remove, key, nullptr);
+        stats.records++;
+    }
+
+    /*!
+     * \brief   write buffered records; fdatasync if the policy says so.
+     *
+     * \return  false on an I/O error.
+     */
+    bool commit()
+    {
+        if (!buf.empty() && !write()) return false;
+        if (unsynced == 0) return true;
+
+        if (unsynced >= opts.syncBytes ||
+            Clock::now() - lastSync >=
+                std::chrono::microseconds(opts.syncIntervalUs))
+        {
+            return sync();
+        }
+        return true;
+    }
+
+    /*!
+     * \brief   write and fdatasync everything logged so far.
+     *
+     * \note    a failed fdatasync keeps the bytes unsynced, so the next
+     *          commit() or sync() tries again.
+     */
+    bool sync()
+    {
+        if (!buf.empty() && !write()) return false;
+        lastSync = Clock::now();
+        if (unsynced != 0)
+        {
+            stats.syncs++;
+            if (::fdatasync(fd) != 0) return false;
+            unsynced = 0;
+        }
+        durableRecords = stats.records;
+        return true;
+    }
+
+    /*!
+     * \brief   records logged so far that a sync has made durable.
+     */
+    uint64_t durable() const { return durableRecords; }
+
+    /*!
+     * \brief   microseconds until commit() would sync; -1 if nothing is
+     *          waiting for a sync.
+     */
+    int64_t syncDueUs() const
+    {
+        if (unsynced == 0 && buf.empty()) return -1;
+        auto age = std::chrono::duration_cast<std::chrono::microseconds>(
+                       Clock::now() - lastSync)
+                       .count();
+        return std::max<int64_t>(0, int64_t(opts.syncIntervalUs) - age);
+    }
+};
@@ -0,0 +1,397 @@
+
+/*!
+ * \file    lib/ExtendibleEHash.h
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   hashmap that grows one page at a time (extendible hashing).
+ *
+ * \note    a directory of 2^depth page pointers is indexed by the low bits
+ *          of the hash; several slots may share a page whose local depth
+ *          is lower. a page holds 32 entries plus a one-byte tag (high hash
+ *          bits) per entry, compared 16 at a time with SSE2.
+ *
+ *          a full page splits on its next hash bit into itself and one new
+ *          page, and only the directory slots of that page are updated.
+ *          the directory (8 bytes per slot, ~2% of the data) doubles when
+ *          a page at full depth splits; the entries themselves are never
+ *          rehashed as a whole, so growth needs one page of extra memory,
+ *          not a second table.
+ *
+ *          keys that no split can separate (equal in every directory bit),
+ *          or that would push the directory past DirPerPage slots per
+ *          page, go to overflow pages chained off their page instead; a
+ *          later split of that page deals the chain out again. hashes are
+ *          mixed with a per-map random seed, so keys cannot be aimed at
+ *          one page from outside.
+ */
+
+#pragma once
+#include "EHashBatch.h"
+#include "EHashPool.h"
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*!
+ * \brief   extendible-hashing hashmap.
+ *
+ * \tparam  K key type.
+ * \tparam  V value type.
+ *
+ * \note    same interface as EHash. pointers returned by find() are valid
+ *          until the next insert or remove.
+ */
+template<typename K, typename V> class ExtendibleEHash
+{
+    /*!
+     * \brief   internal key-value pair.
+     */
+    struct Pair
+    {
+        K key;   //!< the key
+        V value; //!< associated value
+    };
+
+    static constexpr size_t Slots = 32;     //!< entries per page
+    static constexpr unsigned MaxDepth = 32; //!< hash bits the directory uses
+    static constexpr size_t DirPerPage = 16; //!< directory cap, slots a page
+
+    /*!
+     * \brief   bucket page; entries [0, count) are in use.
+     */
+    struct Page
+    {
+        uint8_t tags[Slots];       //!< top hash byte of each entry
+        uint32_t depth = 0;        //!< hash bits shared by its keys
+        uint32_t count = 0;        //!< entries in use
+        Page* overflow = nullptr;  //!< next page of unsplittable keys
+        alignas(Pair) unsigned char storage[Slots * sizeof(Pair)];
+
+        Pair* pairs()
+        {
+            return std::launder(reinterpret_cast<Pair*>(storage));
+        }
+    };
+
+    static_assert(alignof(Pair) <= ehash::NodePool::Granule,
+                  "over-aligned keys or values are not supported");
+
+    std::vector<Page*> directory; //!< low hash bits -> page
+    unsigned globalDepth = 0;     //!< log2 of directory size
+    size_t numElements = 0;       //!< number of elements
+    size_t numPages = 0;          //!< pages allocated
+    uint64_t hashSeed = 0;        //!< mixed into every hash
+
+    uint64_t hashOf(const K& key) const
+    {
+        if constexpr (ehash::BatchHashable<K>)
+        {
+            return ehash::hash_key(key, hashSeed);
+        }
+        else
+        {
+            return ehash::mix64(std::hash<K>{}(key) ^ hashSeed);
+        }
+    }
+
+    static uint8_t tagOf(uint64_t hash)
+    {
+        return uint8_t(hash >> 56);
+    }
+
+    Page* pageOf(uint64_t hash) const
+    {
+        return directory[hash & ((uint64_t(1) << globalDepth) - 1)];
+    }
+
+    Page* newPage(uint32_t depth)
+    {
+        Page* p = new (ehash::NodePool::allocate(sizeof(Page))) Page;
+        p->depth = depth;
+        numPages++;
+        return p;
+    }
+
+    void freePage(Page* p)
+    {
+        Pair* e = p->pairs();
+        for (size_t i = 0; i < p->count; ++i) e[i].~Pair();
+        p->~Page();
+        ehash::NodePool::deallocate(p, sizeof(Page));
+        numPages--;
+    }
+
+    /*!
+     * \brief   entries of p whose tag is tag, as a bitmask.
+     */
+    static uint32_t match(const Page* p, uint8_t tag)
+    {
+        uint32_t live = p->count == Slots ? ~0u : (1u << p->count) - 1;
+#if defined(__SSE2__)
+        __m128i t = _mm_set1_epi8(char(tag));
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p->tags));
+        __m128i hi =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(p->tags + 16));
+        uint32_t m = uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(lo, t))) |
+                     uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(hi, t))) << 16;
+        return m & live;
+#else
+        uint32_t m = 0;
+        for (size_t i = 0; i < p->count; ++i) m |= uint32_t(p->tags[i] == tag) << i;
+        return m & live;
+#endif
+    }
+
+    /*!
+     * \brief   the page holding key and its slot, or {nullptr, 0}.
+     */
+    static std::pair<Page*, size_t> locate(Page* p, const K& key, uint8_t tag)
+    {
+        for (; p; p = p->overflow)
+        {
+            for (uint32_t m = match(p, tag); m; m &= m - 1)
+            {
+                size_t i = size_t(std::countr_zero(m));
+                if (p->pairs()[i].key == key) return {p, i};
+            }
+        }
+        return {nullptr, 0};
+    }
+
+    static void append(Page* p, Pair&& pair, uint8_t tag)
+    {
+        new (p->pairs() + p->count) Pair(std::move(pair));
+        p->tags[p->count++] = tag;
+    }
+
+    /*!
+     * \brief   append to the first page of p's chain with room, chaining a
+     *          new page if all are full.
+     */
+    void chain(Page* p, Pair&& pair, uint8_t tag)
+    {
+        while (p->count == Slots && p->overflow) p = p->overflow;
+        if (p->count == Slots) p = p->overflow = newPage(p->depth);
+        append(p, std::move(pair), tag);
+    }
+
+    /*!
+     * \brief   split the full page that hash maps to on its next bit.
+     *
+     * \return  false if the keys of the page (and its chain) and hash
+     *          agree on every directory bit, so no split can separate
+     *          them, or if the split would need a directory of more than
+     *          DirPerPage slots per page.
+     */
+    bool split(uint64_t hash)
+    {
+        Page* p = pageOf(hash);
+
+        // a directory far larger than the pages means keys aimed at a few
+        // of them; doubling it again would not spread them, only cost
+        // 8 bytes a slot
+        if (p->depth == globalDepth &&
+            directory.size() * 2 > DirPerPage * numPages)
+        {
+            return false;
+        }
+
+        // no split separates keys that agree on all directory bits
+        uint64_t diff = 0;
+        for (Page* q = p; q; q = q->overflow)
+        {
+            Pair* e = q->pairs();
+            for (size_t i = 0; i < q->count; ++i)
+            {
+                diff |= hashOf(e[i].key) ^ hash;
+            }
+        }
+        if (!(diff & ((uint64_t(1) << MaxDepth) - 1) >> p->depth << p->depth))
+        {
+            return false;
+        }
+
+        if (p->depth == globalDepth)
+        {
+            // the only step that is not one page: 8 bytes per slot
+            size_t n = directory.size();
+            directory.resize(n * 2);
+            std::copy_n(directory.begin(), n, directory.begin() + n);
+            globalDepth++;
+        }
+
+        uint64_t bit = uint64_t(1) << p->depth;
+        Page* sibling = newPage(p->depth + 1);
+        p->depth++;
+        Page* rest = std::exchange(p->overflow, nullptr);
+
+        // the entries with the new bit set move over, the rest compact
+        Pair* e = p->pairs();
+        size_t keep = 0;
+        for (size_t i = 0, n = p->count; i < n; ++i)
+        {
+            if (hashOf(e[i].key) & bit)
+            {
+                append(sibling, std::move(e[i]), p->tags[i]);
+            }
+            else if (keep != i)
+            {
+                e[keep] = std::move(e[i]);
+                p->tags[keep] = p->tags[i];
+                keep++;
+            }
+            else
+            {
+                keep++;
+            }
+        }
+        for (size_t i = keep; i < p->count; ++i) e[i].~Pair();
+        p->count = uint32_t(keep);
+
+        // the chain is dealt out over both sides, then freed
+        while (rest)
+        {
+            Pair* r = rest->pairs();
+            for (size_t i = 0; i < rest->count; ++i)
+            {
+                Page* to = hashOf(r[i].key) & bit ? sibling : p;
+                chain(to, std::move(r[i]), rest->tags[i]);
+            }
+            freePage(std::exchange(rest, rest->overflow));
+        }
+
+        uint64_t low = hash & (bit - 1);
+        for (uint64_t i = low | bit; i < directory.size(); i += bit << 1)
+        {
+            directory[i] = sibling;
+        }
+        return true;
+    }
+
+    /*!
+     * \brief   visit every distinct page once (lowest directory slot).
+     */
+    template<typename F> void eachPage(F&& fn) const
+    {
+        for (size_t i = 0; i < directory.size(); ++i)
+        {
+            Page* p = directory[i];
+            if (i >= (size_t(1) << p->depth)) continue; // seen at i mod 2^d
+            for (; p; p = p->overflow) fn(p);
+        }
+    }
+
+  public:
+    ExtendibleEHash() : ExtendibleEHash(ehash::random_seed()) {}
+
+    /*!
+     * \brief   map with a given hash seed, for reproducible layouts.
+     */
+    explicit ExtendibleEHash(uint64_t seed)
+        : directory{newPage(0)}, hashSeed(seed)
+    {
+    }
+
+    ~ExtendibleEHash()
+    {
+        std::vector<Page*> pages;
+        eachPage([&](Page* p) { pages.push_back(p); });
+        for (Page* p : pages) freePage(p);
+    }
+
+    ExtendibleEHash(const ExtendibleEHash&) = delete;
+    ExtendibleEHash& operator=(const ExtendibleEHash&) = delete;
+
+    void insert(const K& key, const V& value)
+    {
+        uint64_t hash = hashOf(key);
+        uint8_t tag = tagOf(hash);
+        for (;;)
+        {
+            Page* p = pageOf(hash);
+            auto [at, i] = locate(p, key, tag);
+            if (at)
+            {
+                at->pairs()[i].value = value;
+                return;
+            }
+
+            if (p->count < Slots)
+            {
+                append(p, Pair{key, value}, tag);
+                numElements++;
+                return;
+            }
+            if (split(hash)) continue;
+
+            chain(p, Pair{key, value}, tag);
+            numElements++;
+            return;
+        }
+    }
+
+    V* find(const K& key)
+    {
+        uint64_t hash = hashOf(key);
+        auto [p, i] = locate(pageOf(hash), key, tagOf(hash));
+        return p ? &p->pairs()[i].value : nullptr;
+    }
+
+    bool remove(const K& key)
+    {
+        uint64_t hash = hashOf(key);
+        auto [p, i] = locate(pageOf(hash), key, tagOf(hash));
+        if (!p) return false;
+
+        // the last entry of the page fills the hole
+        Pair* e = p->pairs();
+        size_t last = p->count - 1;
+        if (i != last)
+        {
+            e[i] = std::move(e[last]);
+            p->tags[i] = p->tags[last];
+        }
+        e[last].~Pair();
+        p->count--;
+        numElements--;
+        return true;
+    }
+
+    /*!
+     * \brief   call fn(key, value) for every element, in page order.
+     */
+    template<typename F> void forEach(F&& fn) const
+    {
+        eachPage([&](Page* p) {
+            Pair* e = p->pairs();
+            for (size_t i = 0; i < p->count; ++i) fn(e[i].key, e[i].value);
+        });
+    }
+
+    /*!
+     * \brief   number of stored elements.
+     */
+    size_t size() const { return numElements; }
+
+    /*!
+     * \brief   the seed mixed into every hash.
+     */
+    uint64_t seed() const { return hashSeed; }
+
+    /*!
+     * \brief   bytes held by pages and directory.
+     */
+    size_t memory() const
+    {
+        return numPages * sizeof(Page) + directory.capacity() * sizeof(Page*);
+    }
+};
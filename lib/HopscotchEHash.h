@@ -0,0 +1,345 @@
+
+/*!
+ * \file    lib/HopscotchEHash.h
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   open-addressing hashmap with hopscotch neighborhoods.
+ *
+ * \note    every key lives within H = 32 slots of its home bucket, and the
+ *          home bucket's hop bitmap says which of those slots hold its
+ *          keys. a lookup reads the bitmap and compares only the keys it
+ *          marks: the home bucket and its neighborhood, one or two cache
+ *          lines for small entries, no probe loop.
+ *
+ *          insert probes linearly for a free slot and then hops it back
+ *          towards home: an entry between the free slot and home that may
+ *          still live at the free slot (it stays within H of its own home)
+ *          moves there, and the free slot takes its place. when the load
+ *          passes maxLoad the table doubles. when no entry can move, it
+ *          doubles once if at least half full; otherwise the keys crowd
+ *          one home, no size would fit them, and the key goes to a small
+ *          overflow list instead, searched only while it is not empty.
+ *          hashes are mixed with a per-map random seed, so keys cannot be
+ *          aimed at one neighborhood from outside.
+ *
+ *          the table has H - 1 spare slots at the end instead of wrapping
+ *          around, so a neighborhood is always one contiguous range. a
+ *          displacement changes one bitmap and two slots, the unit a
+ *          fine-grained concurrent variant would lock or version.
+ */
+
+#pragma once
+#include "EHashBatch.h"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+/*!
+ * \brief   hopscotch hashmap.
+ *
+ * \tparam  K key type.
+ * \tparam  V value type.
+ *
+ * \note    same interface as EHash. pointers returned by find() are valid
+ *          until the next insert or remove.
+ */
+template<typename K, typename V> class HopscotchEHash
+{
+    /*!
+     * \brief   internal key-value pair.
+     */
+    struct Pair
+    {
+        K key;   //!< the key
+        V value; //!< associated value
+    };
+
+    /*!
+     * \brief   slot of the table.
+     */
+    struct Bucket
+    {
+        uint32_t hop = 0;  //!< bit i: slot home + i holds a key of this home
+        bool full = false; //!< the pair is constructed
+        alignas(Pair) unsigned char storage[sizeof(Pair)];
+
+        Pair& pair()
+        {
+            return *std::launder(reinterpret_cast<Pair*>(storage));
+        }
+    };
+
+  public:
+    static constexpr size_t H = 32; //!< neighborhood size
+
+  private:
+    std::unique_ptr<Bucket[]> slots; //!< capacity + H - 1 buckets
+    size_t mask = 0;                 //!< capacity - 1
+    size_t numElements = 0;          //!< number of elements, overflow too
+    float maxLoad = 0.95f;           //!< load factor threshold
+    uint64_t hashSeed = 0;           //!< mixed into every hash
+    std::vector<Pair> overflow;      //!< keys no neighborhood could take
+
+    uint64_t hashOf(const K& key) const
+    {
+        if constexpr (ehash::BatchHashable<K>)
+        {
+            return ehash::hash_key(key, hashSeed);
+        }
+        else
+        {
+            return ehash::mix64(std::hash<K>{}(key) ^ hashSeed);
+        }
+    }
+
+    size_t capacityOf() const { return mask + 1; }
+
+    Bucket* locate(size_t home, const K& key) const
+    {
+        Bucket* b = &slots[home];
+        for (uint32_t m = b->hop; m; m &= m - 1)
+        {
+            Bucket* at = b + std::countr_zero(m);
+            if (at->pair().key == key) return at;
+        }
+        return nullptr;
+    }
+
+    Pair* overflowed(const K& key)
+    {
+        for (Pair& p : overflow)
+        {
+            if (p.key == key) return &p;
+        }
+        return nullptr;
+    }
+
+    /*!
+     * \brief   move an entry that may live at free into it.
+     *
+     * \return  the slot that became free (closer to the front), or
+     *          size_t(-1) if no entry in the H - 1 slots before free can
+     *          move there.
+     */
+    size_t hop(size_t free)
+    {
+        for (size_t home = free - (H - 1); home < free; ++home)
+        {
+            uint32_t bits = slots[home].hop;
+            if (!bits) continue;
+
+            // the home's first entry; it must lie before free
+            size_t from = home + size_t(std::countr_zero(bits));
+            if (from >= free) continue;
+
+            Bucket& src = slots[from];
+            Bucket& dst = slots[free];
+            new (dst.storage) Pair(std::move(src.pair()));
+            dst.full = true;
+            src.pair().~Pair();
+            src.full = false;
+            slots[home].hop = (bits & ~(uint32_t(1) << (from - home))) |
+                              uint32_t(1) << (free - home);
+            return from;
+        }
+        return size_t(-1);
+    }
+
+    /*!
+     * \brief   insert a key known to be absent.
+     *
+     * \return  false if it does not fit without a resize; pair is then
+     *          left as it was.
+     */
+    bool place(size_t home, Pair&& pair)
+    {
+        size_t end = capacityOf() + H - 1;
+        size_t free = home;
+        while (free < end && slots[free].full) free++;
+        if (free == end) return false;
+
+        while (free - home >= H)
+        {
+            free = hop(free);
+            if (free == size_t(-1)) return false;
+        }
+
+        new (slots[free].storage) Pair(std::move(pair));
+        slots[free].full = true;
+        slots[home].hop |= uint32_t(1) << (free - home);
+        return true;
+    }
+
+    /*!
+     * \brief   move everything into a table of newCapacity slots.
+     *
+     * \note    the overflow list gets another try; an entry that finds no
+     *          slot (practically never at H = 32 with distinct hashes)
+     *          goes to it rather than growing the table again.
+     */
+    void rehash(size_t newCapacity)
+    {
+        std::unique_ptr<Bucket[]> old = std::move(slots);
+        size_t oldEnd = capacityOf() + H - 1;
+        slots.reset(new Bucket[newCapacity + H - 1]);
+        mask = newCapacity - 1;
+
+        std::vector<Pair> spill = std::move(overflow);
+        overflow.clear();
+        for (size_t i = 0; i < oldEnd; ++i)
+        {
+            if (!old[i].full) continue;
+            Pair& p = old[i].pair();
+            if (!place(hashOf(p.key) & mask, std::move(p)))
+            {
+                overflow.push_back(std::move(p));
+            }
+        }
+        clear(old.get(), oldEnd);
+
+        for (Pair& p : spill)
+        {
+            if (!place(hashOf(p.key) & mask, std::move(p)))
+            {
+                overflow.push_back(std::move(p));
+            }
+        }
+    }
+
+    static void clear(Bucket* b, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (b[i].full) b[i].pair().~Pair();
+        }
+    }
+
+  public:
+    explicit HopscotchEHash(size_t size = 8)
+        : HopscotchEHash(size, ehash::random_seed())
+    {
+    }
+
+    /*!
+     * \brief   map with a given hash seed, for reproducible layouts.
+     */
+    HopscotchEHash(size_t size, uint64_t seed) : hashSeed(seed)
+    {
+        size_t cap = std::bit_ceil(std::max<size_t>(size, 8));
+        slots.reset(new Bucket[cap + H - 1]);
+        mask = cap - 1;
+    }
+
+    ~HopscotchEHash()
+    {
+        if (slots) clear(slots.get(), capacityOf() + H - 1);
+    }
+
+    HopscotchEHash(const HopscotchEHash&) = delete;
+    HopscotchEHash& operator=(const HopscotchEHash&) = delete;
+
+    void insert(const K& key, const V& value)
+    {
+        uint64_t hash = hashOf(key);
+        if (Bucket* b = locate(hash & mask, key))
+        {
+            b->pair().value = value;
+            return;
+        }
+        if (Pair* p = overflow.empty() ? nullptr : overflowed(key))
+        {
+            p->value = value;
+            return;
+        }
+
+        if (++numElements > maxLoad * capacityOf())
+        {
+            rehash(capacityOf() * 2);
+        }
+        if (place(hash & mask, Pair{key, value})) return;
+
+        // doubling makes room in a full table, not for keys that crowd one
+        // home: grow once at most, and only if at least half full
+        if (numElements >= capacityOf() / 2)
+        {
+            rehash(capacityOf() * 2);
+            if (place(hash & mask, Pair{key, value})) return;
+        }
+        overflow.push_back(Pair{key, value});
+    }
+
+    V* find(const K& key)
+    {
+        if (Bucket* b = locate(hashOf(key) & mask, key))
+        {
+            return &b->pair().value;
+        }
+        Pair* p = overflow.empty() ? nullptr : overflowed(key);
+        return p ? &p->value : nullptr;
+    }
+
+    bool remove(const K& key)
+    {
+        size_t home = hashOf(key) & mask;
+        Bucket* b = locate(home, key);
+        if (!b)
+        {
+            Pair* p = overflow.empty() ? nullptr : overflowed(key);
+            if (!p) return false;
+            *p = std::move(overflow.back());
+            overflow.pop_back();
+            numElements--;
+            return true;
+        }
+
+        b->pair().~Pair();
+        b->full = false;
+        slots[home].hop &= ~(uint32_t(1) << (b - &slots[home]));
+        numElements--;
+        return true;
+    }
+
+    /*!
+     * \brief   call fn(key, value) for every element, in slot order.
+     */
+    template<typename F> void forEach(F&& fn) const
+    {
+        for (size_t i = 0, n = capacityOf() + H - 1; i < n; ++i)
+        {
+            if (slots[i].full) fn(slots[i].pair().key, slots[i].pair().value);
+        }
+        for (const Pair& p : overflow) fn(p.key, p.value);
+    }
+
+    /*!
+     * \brief   number of stored elements.
+     */
+    size_t size() const { return numElements; }
+
+    /*!
+     * \brief   home buckets (the table has H - 1 more slots).
+     */
+    size_t capacity() const { return capacityOf(); }
+
+    /*!
+     * \brief   elements on the overflow list.
+     */
+    size_t overflowCount() const { return overflow.size(); }
+
+    /*!
+     * \brief   the seed mixed into every hash.
+     */
+    uint64_t seed() const { return hashSeed; }
+
+    /*!
+     * \brief   resize threshold as a fraction of capacity().
+     */
+    void setMaxLoad(float load) { maxLoad = load; }
+};
@@ -0,0 +1,247 @@
+
+/*!
+ * \file    lib/LinearEHash.h
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   hashmap that grows one bucket per step (linear hashing).
+ *
+ * \note    the table is 2^level buckets plus `split` more: buckets below
+ *          the split pointer have already been split for this round and
+ *          are addressed with one more hash bit,
+ *
+ *            idx = hash mod 2^level;  if idx < split: hash mod 2^(level+1)
+ *
+ *          when the load goes over maxLoad, bucket `split` is split into
+ *          itself and bucket 2^level + split, and the pointer advances;
+ *          when it reaches 2^level, the round ends and level grows. every
+ *          step touches one chain, so growth costs the same small amount on
+ *          every insert instead of a whole rehash now and then.
+ *
+ *          buckets live in fixed segments reached through a directory, so
+ *          adding a bucket never moves the others. hashes are mixed with a
+ *          per-map random seed, so keys cannot be aimed at one chain from
+ *          outside.
+ */
+
+#pragma once
+#include "EHashBatch.h"
+#include "EHashPool.h"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <vector>
+
+/*!
+ * \brief   linear-hashing hashmap.
+ *
+ * \tparam  K key type.
+ * \tparam  V value type.
+ *
+ * \note    same interface as EHash; chained buckets, nodes from NodePool.
+ */
+template<typename K, typename V> class LinearEHash
+{
+    /*!
+     * \brief   chain node; keeps the hash so a split never rehashes keys.
+     */
+    struct Node
+    {
+        Node* next;    //!< next in the bucket
+        uint64_t hash; //!< full hash of key
+        K key;         //!< the key
+        V value;       //!< associated value
+    };
+
+    static_assert(alignof(Node) <= ehash::NodePool::Granule,
+                  "over-aligned keys or values are not supported");
+
+    static constexpr unsigned SegmentBits = 12; //!< 4096 buckets a segment
+    static constexpr size_t SegmentSize = size_t(1) << SegmentBits;
+
+    std::vector<std::unique_ptr<Node*[]>> segments; //!< bucket heads
+    unsigned level = 0;      //!< 2^level buckets at the start of the round
+    size_t split = 0;        //!< next bucket to split
+    size_t numElements = 0;  //!< number of elements
+    float maxLoad = 0.75f;   //!< load factor threshold
+    uint64_t hashSeed = 0;   //!< mixed into every hash
+
+    uint64_t hashOf(const K& key) const
+    {
+        if constexpr (ehash::BatchHashable<K>)
+        {
+            return ehash::hash_key(key, hashSeed);
+        }
+        else
+        {
+            return ehash::mix64(std::hash<K>{}(key) ^ hashSeed);
+        }
+    }
+
+    size_t buckets() const { return (size_t(1) << level) + split; }
+
+    size_t indexOf(uint64_t hash) const
+    {
+        size_t idx = hash & ((size_t(1) << level) - 1);
+        if (idx < split) idx = hash & ((size_t(2) << level) - 1);
+        return idx;
+    }
+
+    Node*& bucket(size_t idx)
+    {
+        return segments[idx >> SegmentBits][idx & (SegmentSize - 1)];
+    }
+
+    Node* bucket(size_t idx) const
+    {
+        return segments[idx >> SegmentBits][idx & (SegmentSize - 1)];
+    }
+
+    /*!
+     * \brief   split bucket `split` and advance the pointer.
+     */
+    void grow()
+    {
+        size_t to = (size_t(1) << level) + split;
+        if ((to >> SegmentBits) == segments.size())
+        {
+            segments.emplace_back(new Node*[SegmentSize]());
+        }
+
+        // relink: nodes with the new bit set move to the new bucket
+        size_t bit = size_t(1) << level;
+        Node** stay = &bucket(split);
+        Node** move = &bucket(to);
+        for (Node* n = *stay; n; n = n->next)
+        {
+            if (n->hash & bit)
+            {
+                *move = n;
+                move = &n->next;
+            }
+            else
+            {
+                *stay = n;
+                stay = &n->next;
+            }
+        }
+        *stay = nullptr;
+        *move = nullptr;
+
+        if (++split == bit)
+        {
+            split = 0;
+            level++;
+        }
+    }
+
+    Node* search(const K& key, uint64_t hash)
+    {
+        for (Node* n = bucket(indexOf(hash)); n; n = n->next)
+        {
+            if (n->hash == hash && n->key == key) return n;
+        }
+        return nullptr;
+    }
+
+  public:
+    explicit LinearEHash(size_t size = 8)
+        : LinearEHash(size, ehash::random_seed())
+    {
+    }
+
+    /*!
+     * \brief   map with a given hash seed, for reproducible layouts.
+     */
+    LinearEHash(size_t size, uint64_t seed) : hashSeed(seed)
+    {
+        while ((size_t(1) << level) < size) level++;
+        size_t n = std::max((size_t(1) << level) >> SegmentBits, size_t(1));
+        for (size_t i = 0; i < n; ++i)
+        {
+            segments.emplace_back(new Node*[SegmentSize]());
+        }
+    }
+
+    ~LinearEHash()
+    {
+        for (size_t i = 0, n = buckets(); i < n; ++i)
+        {
+            for (Node* c = bucket(i); c;)
+            {
+                Node* next = c->next;
+                c->~Node();
+                ehash::NodePool::deallocate(c, sizeof(Node));
+                c = next;
+            }
+        }
+    }
+
+    LinearEHash(const LinearEHash&) = delete;
+    LinearEHash& operator=(const LinearEHash&) = delete;
+
+    void insert(const K& key, const V& value)
+    {
+        uint64_t hash = hashOf(key);
+        if (Node* n = search(key, hash))
+        {
+            n->value = value;
+            return;
+        }
+
+        if ((float)numElements / buckets() > maxLoad) grow();
+
+        Node*& head = bucket(indexOf(hash));
+        head = new (ehash::NodePool::allocate(sizeof(Node)))
+            Node{head, hash, key, value};
+        numElements++;
+    }
+
+    V* find(const K& key)
+    {
+        Node* n = search(key, hashOf(key));
+        return n ? &n->value : nullptr;
+    }
+
+    bool remove(const K& key)
+    {
+        uint64_t hash = hashOf(key);
+        for (Node** link = &bucket(indexOf(hash)); *link;
+             link = &(*link)->next)
+        {
+            Node* n = *link;
+            if (n->hash != hash || !(n->key == key)) continue;
+
+            *link = n->next;
+            n->~Node();
+            ehash::NodePool::deallocate(n, sizeof(Node));
+            numElements--;
+            return true;
+        }
+        return false;
+    }
+
+    /*!
+     * \brief   call fn(key, value) for every element, in bucket order.
+     */
+    template<typename F> void forEach(F&& fn) const
+    {
+        for (size_t i = 0, n = buckets(); i < n; ++i)
+        {
+            for (Node* c = bucket(i); c; c = c->next) fn(c->key, c->value);
+        }
+    }
+
+    /*!
+     * \brief   number of stored elements.
+     */
+    size_t size() const { return numElements; }
+
+    /*!
+     * \brief   the seed mixed into every hash.
+     */
+    uint64_t seed() const { return hashSeed; }
+};
@@ -0,0 +1,677 @@
+
+/*!
+ * \file    lib/PersistentEHash.h
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   immutable hashmap: a hash array mapped trie (HAMT).
+ *
+ * \note    every level consumes 5 bits of the 64-bit hash and holds up to
+ *          32 slots, addressed through two bitmaps: dataMap marks slots
+ *          with an inline key-value entry, nodeMap slots with a child
+ *          node. a slot's position in the node is the popcount of the
+ *          bitmap below its bit, so nodes store only occupied slots. keys
+ *          whose 64 hash bits all collide end up in a collision node that
+ *          is searched linearly.
+ *
+ *          insert() and remove() copy the path from the root to the
+ *          changed slot (at most 13 nodes, ~log32 n) and share every other
+ *          node with the version they started from. nodes are reference
+ *          counted and come from NodePool.
+ *
+ *          unlike EHash, the hash has no per-map seed, so it does not
+ *          resist hash flooding: keys chosen to collide in all 64 bits
+ *          pile into one collision node and make lookups O(n). keep
+ *          untrusted keys out, or hash them with a secret first.
+ */
+
+#pragma once
+#include "EHashBatch.h"
+#include "EHashPool.h"
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <utility>
+
+/*!
+ * \brief   persistent (immutable, structurally shared) hashmap.
+ *
+ * \tparam  K key type.
+ * \tparam  V value type.
+ *
+ * \note    a version never changes once built; copying one is O(1), so
+ *          snapshots and undo are just kept versions. versions may be read,
+ *          copied, derived from and dropped on any thread. a Transient
+ *          builds a version in place and belongs to one thread.
+ */
+template<typename K, typename V> class PersistentEHash
+{
+    /*!
+     * \brief   key-value pair stored inline in a node.
+     */
+    struct Entry
+    {
+        K key;   //!< the key
+        V value; //!< associated value
+    };
+
+    /*!
+     * \brief   trie node header; entries and then children follow it.
+     */
+    struct Node
+    {
+        std::atomic<uint32_t> refs{1}; //!< versions and parents holding it
+        uint32_t dataMap = 0;          //!< slots holding an entry
+        uint32_t nodeMap = 0;          //!< slots holding a child
+        uint32_t count = 0;            //!< entries (collision nodes: no map)
+    };
+
+    static_assert(alignof(Entry) <= ehash::NodePool::Granule,
+                  "over-aligned keys or values are not supported");
+
+    static constexpr unsigned Bits = 5;      //!< hash bits per level
+    static constexpr unsigned HashBits = 64; //!< deeper: collision node
+
+    static constexpr size_t EntryOffset =
+        (sizeof(Node) + alignof(Entry) - 1) / alignof(Entry) * alignof(Entry);
+
+    Node* root = nullptr;    //!< null for the empty map
+    size_t numElements = 0;  //!< number of elements
+
+    // ---- node layout ------------------------------------------------------
+
+    static size_t childOffset(size_t entries)
+    {
+        size_t end = EntryOffset + entries * sizeof(Entry);
+        return (end + alignof(Node*) - 1) / alignof(Node*) * alignof(Node*);
+    }
+
+    static size_t bytesOf(size_t entries, size_t children)
+    {
+        return childOffset(entries) + children * sizeof(Node*);
+    }
+
+    static Entry* entries(Node* n)
+    {
+        return std::launder(reinterpret_cast<Entry*>(
+            reinterpret_cast<char*>(n) + EntryOffset));
+    }
+
+    static Node** children(Node* n)
+    {
+        return reinterpret_cast<Node**>(reinterpret_cast<char*>(n) +
+                                        childOffset(n->count));
+    }
+
+    static size_t childCount(const Node* n)
+    {
+        return size_t(std::popcount(n->nodeMap));
+    }
+
+    static size_t slot(uint32_t map, uint32_t bit)
+    {
+        return size_t(std::popcount(map & (bit - 1)));
+    }
+
+    static uint32_t bitOf(uint64_t hash, unsigned shift)
+    {
+        return 1u << ((hash >> shift) & 31);
+    }
+
+    static bool singleton(const Node* n)
+    {
+        return n->count == 1 && n->nodeMap == 0;
+    }
+
+    // ---- node lifetime ----------------------------------------------------
+
+    /*!
+     * \brief   raw node; the caller constructs its entries and children.
+     */
+    static Node* make(uint32_t dataMap, uint32_t nodeMap, size_t count)
+    {
+        size_t kids = size_t(std::popcount(nodeMap));
+        Node* n = new (ehash::NodePool::allocate(bytesOf(count, kids))) Node;
+        n->dataMap = dataMap;
+        n->nodeMap = nodeMap;
+        n->count = uint32_t(count);
+        return n;
+    }
+
+    /*!
+     * \brief   destroy the entries and free the memory, not the children.
+     */
+    static void dropShell(Node* n)
+    {
+        size_t bytes = bytesOf(n->count, childCount(n));
+        Entry* e = entries(n);
+        for (size_t i = 0; i < n->count; ++i) e[i].~Entry();
+        n->~Node();
+        ehash::NodePool::deallocate(n, bytes);
+    }
+
+    static void share(Node* n)
+    {
+        if (n) n->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void release(Node* n)
+    {
+        if (!n || n->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+        Node** kids = children(n);
+        for (size_t i = 0, c = childCount(n); i < c; ++i) release(kids[i]);
+        dropShell(n);
+    }
+
+    static bool unique(const Node* n)
+    {
+        return n->refs.load(std::memory_order_acquire) == 1;
+    }
+
+    /*!
+     * \brief   copy (or, for a node being consumed, move) entries [from, to).
+     */
+    static void takeEntries(Node* n, size_t from, size_t to, Entry* dst,
+                            bool move)
+    {
+        Entry* src = entries(n);
+        for (size_t i = from; i < to; ++i, ++dst)
+        {
+            if (move) new (dst) Entry(std::move(src[i]));
+            else new (dst) Entry(src[i]);
+        }
+    }
+
+    /*!
+     * \brief   share (or, for a node being consumed, hand over) children.
+     */
+    static void takeChildren(Node* n, size_t from, size_t to, Node** dst,
+                             bool move)
+    {
+        Node** src = children(n);
+        for (size_t i = from; i < to; ++i, ++dst)
+        {
+            *dst = src[i];
+            if (!move) share(src[i]);
+        }
+    }
+
+    /*!
+     * \brief   n with entry slot i replaced by (key, value) or, if insert,
+     *          a new entry inserted before slot i.
+     *
+     * \param   edit n is consumed (moved from and freed)
+     */
+    static Node* withEntry(Node* n, uint32_t dataMap, size_t i, bool insert,
+                           const K& key, const V& value, bool edit)
+    {
+        size_t count = n->count + (insert ? 1 : 0);
+        size_t kids = childCount(n);
+        Node* r = make(dataMap, n->nodeMap, count);
+        Entry* e = entries(r);
+
+        takeEntries(n, 0, i, e, edit);
+        new (e + i) Entry{key, value};
+        takeEntries(n, insert ? i : i + 1, n->count, e + i + 1, edit);
+        takeChildren(n, 0, kids, children(r), edit);
+        if (edit) dropShell(n);
+        return r;
+    }
+
+    /*!
+     * \brief   n with entry slot i turned into child sub at child slot j.
+     */
+    static Node* entryToChild(Node* n, uint32_t bit, size_t i, Node* sub,
+                              bool edit)
+    {
+        size_t j = slot(n->nodeMap, bit);
+        size_t kids = childCount(n);
+        Node* r = make(n->dataMap & ~bit, n->nodeMap | bit, n->count - 1);
+        Entry* e = entries(r);
+        Node** c = children(r);
+
+        takeEntries(n, 0, i, e, edit);
+        takeEntries(n, i + 1, n->count, e + i, edit);
+        takeChildren(n, 0, j, c, edit);
+        c[j] = sub;
+        takeChildren(n, j, kids, c + j + 1, edit);
+        if (edit) dropShell(n);
+        return r;
+    }
+
+    /*!
+     * \brief   n with child slot j replaced by the one entry of sub.
+     *
+     * \note    sub is always consumed: it was just built for this. with
+     *          edit, the caller has already let go of the old child.
+     */
+    static Node* childToEntry(Node* n, uint32_t bit, size_t j, Node* sub,
+                              bool edit)
+    {
+        size_t i = slot(n->dataMap, bit);
+        size_t kids = childCount(n);
+        Node* r = make(n->dataMap | bit, n->nodeMap & ~bit, n->count + 1);
+        Entry* e = entries(r);
+        Node** c = children(r);
+
+        takeEntries(n, 0, i, e, edit);
+        new (e + i) Entry(std::move(entries(sub)[0]));
+        takeEntries(n, i, n->count, e + i + 1, edit);
+        takeChildren(n, 0, j, c, edit);
+        takeChildren(n, j + 1, kids, c + j, edit);
+        dropShell(sub);
+        if (edit) dropShell(n);
+        return r;
+    }
+
+    /*!
+     * \brief   n without entry slot i (or child slot j if i is npos).
+     */
+    static Node* without(Node* n, uint32_t bit, size_t i, bool edit)
+    {
+        bool entry = i != size_t(-1);
+        size_t j = entry ? 0 : slot(n->nodeMap, bit);
+        size_t kids = childCount(n);
+        Node* r = make(entry ? n->dataMap & ~bit : n->dataMap,
+                       entry ? n->nodeMap : n->nodeMap & ~bit,
+                       n->count - (entry ? 1 : 0));
+        Entry* e = entries(r);
+        Node** c = children(r);
+
+        if (entry)
+        {
+            takeEntries(n, 0, i, e, edit);
+            takeEntries(n, i + 1, n->count, e + i, edit);
+            takeChildren(n, 0, kids, c, edit);
+        }
+        else
+        {
+            takeEntries(n, 0, n->count, e, edit);
+            takeChildren(n, 0, j, c, edit);
+            takeChildren(n, j + 1, kids, c + j, edit);
+        }
+        if (edit) dropShell(n);
+        return r;
+    }
+
+    /*!
+     * \brief   smallest subtree holding entry a (hash ha) and (key, value).
+     */
+    static Node* pair(Entry&& a, uint64_t ha, const K& key, const V& value,
+                      uint64_t hash, unsigned shift)
+    {
+        if (shift >= HashBits)
+        {
+            Node* r = make(0, 0, 2);
+            new (entries(r)) Entry(std::move(a));
+            new (entries(r) + 1) Entry{key, value};
+            return r;
+        }
+
+        uint32_t ba = bitOf(ha, shift);
+        uint32_t bb = bitOf(hash, shift);
+        if (ba == bb)
+        {
+            Node* r = make(0, ba, 0);
+            children(r)[0] = pair(std::move(a), ha, key, value, hash,
+                                  shift + Bits);
+            return r;
+        }
+
+        Node* r = make(ba | bb, 0, 2);
+        Entry* e = entries(r);
+        new (e + (ba < bb ? 0 : 1)) Entry(std::move(a));
+        new (e + (ba < bb ? 1 : 0)) Entry{key, value};
+        return r;
+    }
+
+    // ---- operations -------------------------------------------------------
+
+    /*!
+     * \brief   n with key set to value.
+     *
+     * \param   edit   n is exclusively ours: update in place or consume it
+     * \param   added  set when the key was new
+     * \return  n itself if updated in place, else a new node
+     */
+    static Node* put(Node* n, const K& key, const V& value, uint64_t hash,
+                     unsigned shift, bool edit, bool& added)
+    {
+        if (shift >= HashBits)
+        {
+            Entry* e = entries(n);
+            for (size_t i = 0; i < n->count; ++i)
+            {
+                if (!(e[i].key == key)) continue;
+                if (edit)
+                {
+                    e[i].value = value;
+                    return n;
+                }
+                return withEntry(n, 0, i, false, key, value, false);
+            }
+            added = true;
+            return withEntry(n, 0, n->count, true, key, value, edit);
+        }
+
+        uint32_t bit = bitOf(hash, shift);
+        if (n->dataMap & bit)
+        {
+            size_t i = slot(n->dataMap, bit);
+            Entry& e = entries(n)[i];
+            if (e.key == key)
+            {
+                if (edit)
+                {
+                    e.value = value;
+                    return n;
+                }
+                return withEntry(n, n->dataMap, i, false, key, value, false);
+            }
+
+            // two keys share the slot: push both one level down
+            added = true;
+            Entry moved = edit ? Entry(std::move(e)) : Entry(e);
+            Node* sub = pair(std::move(moved), hashOf(moved.key), key, value,
+                             hash, shift + Bits);
+            return entryToChild(n, bit, i, sub, edit);
+        }
+
+        if (n->nodeMap & bit)
+        {
+            size_t j = slot(n->nodeMap, bit);
+            Node* child = children(n)[j];
+            bool own = edit && unique(child);
+            Node* next = put(child, key, value, hash, shift + Bits, own, added);
+            if (next == child) return n;
+            if (!own && edit) release(child);
+            if (!edit) return copyWithChild(n, j, next);
+
+            children(n)[j] = next;
+            return n;
+        }
+
+        added = true;
+        return withEntry(n, n->dataMap | bit, slot(n->dataMap, bit), true,
+                         key, value, edit);
+    }
+
+    /*!
+     * \brief   copy of n whose child slot j is next (taken over).
+     */
+    static Node* copyWithChild(Node* n, size_t j, Node* next)
+    {
+        size_t kids = childCount(n);
+        Node* r = make(n->dataMap, n->nodeMap, n->count);
+        Node** c = children(r);
+
+        takeEntries(n, 0, n->count, entries(r), false);
+        takeChildren(n, 0, j, c, false);
+        c[j] = next;
+        takeChildren(n, j + 1, kids, c + j + 1, false);
+        return r;
+    }
+
+    /*!
+     * \brief   n without key.
+     *
+     * \param   edit n is exclusively ours: consume it if it changes
+     * \return  n itself if nothing changed, nullptr if n became empty,
+     *          else a new node
+     */
+    static Node* erase(Node* n, const K& key, uint64_t hash, unsigned shift,
+                       bool edit, bool& removed)
+    {
+        if (shift >= HashBits)
+        {
+            Entry* e = entries(n);
+            for (size_t i = 0; i < n->count; ++i)
+            {
+                if (!(e[i].key == key)) continue;
+                removed = true;
+                if (n->count == 1)
+                {
+                    if (edit) dropShell(n);
+                    return nullptr;
+                }
+                return without(n, 0, i, edit);
+            }
+            return n;
+        }
+
+        uint32_t bit = bitOf(hash, shift);
+        if (n->dataMap & bit)
+        {
+            size_t i = slot(n->dataMap, bit);
+            if (!(entries(n)[i].key == key)) return n;
+
+            removed = true;
+            if (n->count == 1 && n->nodeMap == 0)
+            {
+                if (edit) dropShell(n);
+                return nullptr;
+            }
+            return without(n, bit, i, edit);
+        }
+
+        if (n->nodeMap & bit)
+        {
+            size_t j = slot(n->nodeMap, bit);
+            Node* child = children(n)[j];
+            bool own = edit && unique(child);
+            Node* next = erase(child, key, hash, shift + Bits, own, removed);
+            if (next == child) return n;
+            if (!own && edit) release(child);
+
+            if (!next) return without(n, bit, size_t(-1), edit);
+
+            // a lone entry moves up: the trie stays canonical
+            if (singleton(next)) return childToEntry(n, bit, j, next, edit);
+            if (!edit) return copyWithChild(n, j, next);
+
+            children(n)[j] = next;
+            return n;
+        }
+
+        return n;
+    }
+
+    static void walk(Node* n, auto& fn)
+    {
+        Entry* e = entries(n);
+        for (size_t i = 0; i < n->count; ++i) fn(e[i].key, e[i].value);
+
+        Node** kids = children(n);
+        for (size_t i = 0, c = childCount(n); i < c; ++i) walk(kids[i], fn);
+    }
+
+    /*!
+     * \brief   full hash of a key: EHash's hash without its per-map seed.
+     */
+    static uint64_t hashOf(const K& key)
+    {
+        if constexpr (ehash::BatchHashable<K>)
+        {
+            return ehash::hash_key(key);
+        }
+        else
+        {
+            return std::hash<K>{}(key);
+        }
+    }
+
+    PersistentEHash(Node* root, size_t n) : root(root), numElements(n) {}
+
+  public:
+    class Transient;
+
+    PersistentEHash() = default;
+
+    ~PersistentEHash() { release(root); }
+
+    PersistentEHash(const PersistentEHash& o)
+        : root(o.root), numElements(o.numElements)
+    {
+        share(root);
+    }
+
+    PersistentEHash(PersistentEHash&& o) noexcept
+        : root(std::exchange(o.root, nullptr)),
+          numElements(std::exchange(o.numElements, 0))
+    {
+    }
+
+    PersistentEHash& operator=(PersistentEHash o) noexcept
+    {
+        std::swap(root, o.root);
+        std::swap(numElements, o.numElements);
+        return *this;
+    }
+
+    /*!
+     * \brief   new version with key set to value; this one is unchanged.
+     */
+    [[nodiscard]] PersistentEHash insert(const K& key, const V& value) const
+    {
+        uint64_t hash = hashOf(key);
+        if (!root)
+        {
+            Node* r = make(bitOf(hash, 0), 0, 1);
+            new (entries(r)) Entry{key, value};
+            return PersistentEHash(r, 1);
+        }
+
+        bool added = false;
+        Node* r = put(root, key, value, hash, 0, false, added);
+        return PersistentEHash(r, numElements + (added ? 1 : 0));
+    }
+
+    /*!
+     * \brief   new version without key; this one is unchanged.
+     */
+    [[nodiscard]] PersistentEHash remove(const K& key) const
+    {
+        if (!root) return *this;
+
+        bool removed = false;
+        Node* r = erase(root, key, hashOf(key), 0, false, removed);
+        if (!removed) return *this;
+        return PersistentEHash(r, numElements - 1);
+    }
+
+    const V* find(const K& key) const
+    {
+        uint64_t hash = hashOf(key);
+        Node* n = root;
+        for (unsigned shift = 0; n; shift += Bits)
+        {
+            if (shift >= HashBits)
+            {
+                Entry* e = entries(n);
+                for (size_t i = 0; i < n->count; ++i)
+                {
+                    if (e[i].key == key) return &e[i].value;
+                }
+                return nullptr;
+            }
+
+            uint32_t bit = bitOf(hash, shift);
+            if (n->dataMap & bit)
+            {
+                Entry& e = entries(n)[slot(n->dataMap, bit)];
+                return e.key == key ? &e.value : nullptr;
+            }
+            if (!(n->nodeMap & bit)) return nullptr;
+            n = children(n)[slot(n->nodeMap, bit)];
+        }
+        return nullptr;
+    }
+
+    /*!
+     * \brief   call fn(key, value) for every element, in trie order.
+     */
+    template<typename F> void forEach(F&& fn) const
+    {
+        if (root) walk(root, fn);
+    }
+
+    /*!
+     * \brief   number of stored elements.
+     */
+    size_t size() const { return numElements; }
+
+    bool empty() const { return numElements == 0; }
+
+    /*!
+     * \brief   start a batch of changes on top of this version.
+     */
+    Transient transient() const { return Transient(*this); }
+
+    /*!
+     * \brief   mutable builder for a new version.
+     *
+     * \note    the first change of a node copies it if any version still
+     *          uses it; nodes the transient created (or is the only user
+     *          of) are then updated in place, so a bulk build does not
+     *          copy a path per operation. persistent() hands the result
+     *          over as an ordinary version and leaves the transient empty.
+     */
+    class Transient
+    {
+        friend class PersistentEHash;
+
+        PersistentEHash map;
+
+        explicit Transient(const PersistentEHash& from) : map(from) {}
+
+      public:
+        Transient() = default;
+
+        void insert(const K& key, const V& value)
+        {
+            Node*& root = map.root;
+            uint64_t hash = hashOf(key);
+            if (!root)
+            {
+                root = make(bitOf(hash, 0), 0, 1);
+                new (entries(root)) Entry{key, value};
+                map.numElements = 1;
+                return;
+            }
+
+            bool own = unique(root);
+            bool added = false;
+            Node* r = put(root, key, value, hash, 0, own, added);
+            if (r != root && !own) release(root);
+            root = r;
+            map.numElements += added ? 1 : 0;
+        }
+
+        bool remove(const K& key)
+        {
+            Node*& root = map.root;
+            if (!root) return false;
+
+            bool own = unique(root);
+            bool removed = false;
+            Node* r = erase(root, key, hashOf(key), 0, own, removed);
+            if (r != root && !own) release(root);
+            root = r;
+            map.numElements -= removed ? 1 : 0;
+            return removed;
+        }
+
+        const V* find(const K& key) const { return map.find(key); }
+
+        size_t size() const { return map.size(); }
+
+        /*!
+         * \brief   the built version; the transient is empty afterwards.
+         */
+        PersistentEHash persistent() { return std::move(map); }
+    };
+};
@@ -0,0 +1,664 @@
+
+/*!
+ * \file    lib/SpillEHash.h
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   hashmap for tables larger than memory: extendible hashing over
+ *          pages in a file, with a page cache in front.
+ *
+ * \note    the file is an array of 4 KiB pages, each a bucket of fixed-size
+ *          entries. memory holds the hot part only:
+ *
+ *            directory   2^depth page numbers, indexed by the low hash bits
+ *            filters     a small bloom filter per page, so most lookups of
+ *                        absent keys never touch the page
+ *            cache       LRU page frames; dirty frames are written back
+ *                        when they are evicted or on flush()
+ *
+ *          a full page splits on its next hash bit into itself and a new
+ *          page at the end of the file; the directory doubles only when
+ *          the page was already as deep as the directory. nothing is ever
+ *          rehashed as a whole, so the file grows a page at a time. keys
+ *          that agree on every directory bit cannot be split apart: they
+ *          go to overflow pages chained behind their page instead, so no
+ *          hash can double the directory toward MaxDepth. hashes are
+ *          mixed with a per-map random seed, as in EHash, so keys cannot
+ *          be aimed at one page from outside.
+ *
+ *          find_batch() looks at a whole block of keys first and asks the
+ *          kernel to read every page it is going to miss (fadvise
+ *          WILLNEED), so the reads overlap instead of waiting one by one.
+ */
+
+#pragma once
+#include "EHashBatch.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <list>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <unistd.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ehash
+{
+/*!
+ * \brief   memory budget of a SpillEHash.
+ */
+struct SpillOptions
+{
+    size_t cachePages = 4096;  //!< page frames kept in memory (16 MiB)
+    size_t filterBytes = 128;  //!< bloom filter per page; 0 disables
+};
+} // namespace ehash
+
+/*!
+ * \brief   disk-backed hashmap of fixed-size keys and values.
+ *
+ * \tparam  K key type, trivially copyable.
+ * \tparam  V value type, trivially copyable.
+ *
+ * \note    the file is scratch space: open() truncates it and nothing is
+ *          recovered from it. one thread at a time. I/O errors are sticky:
+ *          after one, operations fail and error() returns the errno.
+ */
+template<typename K, typename V> class SpillEHash
+{
+    static_assert(std::is_trivially_copyable_v<K> &&
+                      std::is_trivially_copyable_v<V>,
+                  "SpillEHash stores keys and values as raw bytes");
+
+  public:
+    static constexpr size_t PageBytes = 4096;
+    static constexpr uint32_t MaxDepth = 30; //!< directory limit (4 GiB)
+
+    /*!
+     * \brief   I/O and cache counters.
+     */
+    struct Stats
+    {
+        uint64_t hits = 0;      //!< page found in the cache
+        uint64_t reads = 0;     //!< pages read from the file
+        uint64_t writes = 0;    //!< pages written back
+        uint64_t filtered = 0;  //!< lookups answered by a filter alone
+        uint64_t prefetch = 0;  //!< read-ahead hints issued
+        uint64_t splits = 0;    //!< page splits
+    };
+
+  private:
+    /*!
+     * \brief   page header; keys[cap] and then values[cap] follow it.
+     */
+    struct PageHeader
+    {
+        uint32_t count; //!< entries in the page
+        uint32_t depth; //!< hash bits shared by all its keys
+    };
+
+    static constexpr size_t Capacity =
+        (PageBytes - sizeof(PageHeader)) / (sizeof(K) + sizeof(V));
+    static constexpr size_t KeysAt = sizeof(PageHeader);
+    static constexpr size_t ValuesAt = KeysAt + Capacity * sizeof(K);
+
+    static_assert(Capacity >= 2, "entries too large for a page");
+
+    /*!
+     * \brief   in-memory copy of a page.
+     */
+    struct Frame
+    {
+        uint32_t page = 0;
+        bool dirty = false;
+        std::list<Frame*>::iterator lru; //!< position, front = recent
+        std::unique_ptr<char[]> data{new char[PageBytes]()};
+    };
+
+    ehash::SpillOptions opts;
+    int fd = -1;
+    int ioError = 0;
+
+    uint32_t globalDepth = 0;
+    std::vector<uint32_t> directory{0}; //!< hash low bits -> page
+    uint32_t numPages = 0;
+    size_t numElements = 0;
+    uint64_t hashSeed = 0; //!< mixed into every hash
+
+    /*!
+     * \brief   overflow chain behind a page.
+     */
+    struct Link
+    {
+        uint32_t next = 0; //!< next overflow page; 0 (never one) ends it
+        uint64_t hash = 0; //!< a hash of the keys chained behind the page
+    };
+
+    std::vector<Link> links; //!< per page, kept in memory like filters
+
+    size_t filterWords = 0;              //!< uint64_t per page filter
+    std::vector<uint64_t> filters;       //!< numPages * filterWords
+
+    std::vector<std::unique_ptr<Frame>> frames;
+    std::unordered_map<uint32_t, Frame*> cached; //!< page -> frame
+    std::list<Frame*> lru;
+    Frame* pinned = nullptr; //!< not to be evicted (the page being split)
+
+    static constexpr size_t BatchBlock = 64;
+
+    // ---- hashing ----------------------------------------------------------
+
+    uint64_t hashOf(const K& key) const
+    {
+        if constexpr (ehash::BatchHashable<K>)
+        {
+            return ehash::hash_key(key, hashSeed);
+        }
+        else
+        {
+            return ehash::mix64(std::hash<K>{}(key) ^ hashSeed);
+        }
+    }
+
+    uint32_t pageOf(uint64_t hash) const
+    {
+        return directory[hash & ((uint64_t(1) << globalDepth) - 1)];
+    }
+
+    // ---- filters ----------------------------------------------------------
+
+    /*!
+     * \brief   the two filter bits of a hash, from its high half (the low
+     *          bits pick the page, so all keys of a page share them).
+     */
+    void filterBits(uint64_t hash, size_t bit[2]) const
+    {
+        size_t bits = filterWords * 64;
+        bit[0] = size_t(hash >> 32) % bits;
+        bit[1] = size_t(ehash::mix64(hash) >> 32) % bits;
+    }
+
+    void filterAdd(uint32_t page, uint64_t hash)
+    {
+        if (!filterWords) return;
+        size_t bit[2];
+        filterBits(hash, bit);
+        uint64_t* f = &filters[page * filterWords];
+        for (size_t b : bit) f[b / 64] |= uint64_t(1) << (b % 64);
+    }
+
+    bool filterMayHave(uint32_t page, uint64_t hash) const
+    {
+        if (!filterWords) return true;
+        size_t bit[2];
+        filterBits(hash, bit);
+        const uint64_t* f = &filters[page * filterWords];
+        for (size_t b : bit)
+        {
+            if (!(f[b / 64] >> (b % 64) & 1)) return false;
+        }
+        return true;
+    }
+
+    /*!
+     * \brief   rebuild a page's filter from its keys (drops removed keys).
+     */
+    void filterRebuild(uint32_t page, const char* data)
+    {
+        if (!filterWords) return;
+        std::fill_n(&filters[page * filterWords], filterWords, 0);
+        for (size_t i = 0, n = header(data).count; i < n; ++i)
+        {
+            filterAdd(page, hashOf(keyAt(data, i)));
+        }
+    }
+
+    // ---- page layout ------------------------------------------------------
+
+    static PageHeader header(const char* data)
+    {
+        PageHeader h;
+        std::memcpy(&h, data, sizeof h);
+        return h;
+    }
+
+    static void setHeader(char* data, PageHeader h)
+    {
+        std::memcpy(data, &h, sizeof h);
+    }
+
+    static K keyAt(const char* data, size_t i)
+    {
+        K k;
+        std::memcpy(&k, data + KeysAt + i * sizeof(K), sizeof(K));
+        return k;
+    }
+
+    static V valueAt(const char* data, size_t i)
+    {
+        V v;
+        std::memcpy(&v, data + ValuesAt + i * sizeof(V), sizeof(V));
+        return v;
+    }
+
+    static void put(char* data, size_t i, const K& key, const V& value)
+    {
+        std::memcpy(data + KeysAt + i * sizeof(K), &key, sizeof(K));
+        std::memcpy(data + ValuesAt + i * sizeof(V), &value, sizeof(V));
+    }
+
+    static size_t search(const char* data, const K& key)
+    {
+        for (size_t i = 0, n = header(data).count; i < n; ++i)
+        {
+            if (keyAt(data, i) == key) return i;
+        }
+        return size_t(-1);
+    }
+
+    // ---- page cache -------------------------------------------------------
+
+    bool writeBack(Frame& f)
+    {
+        if (!f.dirty) return true;
+        off_t at = off_t(f.page) * off_t(PageBytes);
+        if (::pwrite(fd, f.data.get(), PageBytes, at) != ssize_t(PageBytes))
+        {
+            ioError = errno ? errno : EIO;
+            return false;
+        }
+        f.dirty = false;
+        stats.writes++;
+        return true;
+    }
+
+    /*!
+     * \brief   a frame to load page into: a fresh one below the budget,
+     *          else the least recently used one, written back first.
+     */
+    Frame* victim()
+    {
+        if (frames.size() < opts.cachePages)
+        {
+            frames.push_back(std::make_unique<Frame>());
+            return frames.back().get();
+        }
+
+        auto it = std::prev(lru.end());
+        if (*it == pinned) --it;
+        Frame* f = *it;
+        if (!writeBack(*f)) return nullptr;
+        lru.erase(it);
+        cached.erase(f->page);
+        return f;
+    }
+
+    /*!
+     * \brief   frame of page, read from the file unless fresh.
+     *
+     * \param   fresh the page is new: start it empty instead of reading
+     */
+    Frame* frame(uint32_t page, bool fresh = false)
+    {
+        if (ioError) return nullptr;
+
+        auto found = cached.find(page);
+        if (found != cached.end())
+        {
+            Frame* f = found->second;
+            lru.splice(lru.begin(), lru, f->lru);
+            stats.hits++;
+            return f;
+        }
+
+        Frame* f = victim();
+        if (!f) return nullptr;
+        f->page = page;
+        f->dirty = fresh;
+        if (fresh)
+        {
+            std::memset(f->data.get(), 0, sizeof(PageHeader));
+        }
+        else
+        {
+            off_t at = off_t(page) * off_t(PageBytes);
+            if (::pread(fd, f->data.get(), PageBytes, at) != ssize_t(PageBytes))
+            {
+                ioError = errno ? errno : EIO;
+                return nullptr;
+            }
+            stats.reads++;
+        }
+
+        lru.push_front(f);
+        f->lru = lru.begin();
+        cached.emplace(page, f);
+        return f;
+    }
+
+    uint32_t newPage(uint32_t depth)
+    {
+        uint32_t page = numPages++;
+        filters.resize(size_t(numPages) * filterWords, 0);
+        links.resize(numPages);
+        if (Frame* f = frame(page, true)) setHeader(f->data.get(), {0, depth});
+        return page;
+    }
+
+    /*!
+     * \brief   the page of key's chain that holds it, valid until the next
+     *          frame() call; slot is its entry. null if absent or on an
+     *          I/O error.
+     */
+    Frame* locate(uint32_t page, uint64_t hash, const K& key, size_t& slot)
+    {
+        for (;; page = links[page].next)
+        {
+            if (filterMayHave(page, hash))
+            {
+                Frame* f = frame(page);
+                if (!f) return nullptr;
+                slot = search(f->data.get(), key);
+                if (slot != size_t(-1)) return f;
+            }
+            if (!links[page].next) return nullptr;
+        }
+    }
+
+    void add(Frame* f, uint64_t hash, const K& key, const V& value)
+    {
+        char* data = f->data.get();
+        PageHeader h = header(data);
+        put(data, h.count++, key, value);
+        setHeader(data, h);
+        filterAdd(f->page, hash);
+        f->dirty = true;
+        numElements++;
+    }
+
+    /*!
+     * \brief   add key to the overflow chain of page, for keys no split
+     *          can separate from the page's own.
+     */
+    bool chain(uint32_t page, uint64_t hash, const K& key, const V& value)
+    {
+        links[page].hash = hash;
+        uint32_t last = page;
+        for (uint32_t p = links[page].next; p; p = links[p].next)
+        {
+            Frame* f = frame(p);
+            if (!f) return false;
+            if (header(f->data.get()).count < Capacity)
+            {
+                add(f, hash, key, value);
+                return true;
+            }
+            last = p;
+        }
+
+        uint32_t fresh = newPage(MaxDepth);
+        links[last].next = fresh;
+        Frame* f = frame(fresh);
+        if (!f) return false;
+        add(f, hash, key, value);
+        return true;
+    }
+
+    // ---- growth -----------------------------------------------------------
+
+    /*!
+     * \brief   split the full page that hash maps to on its next bit.
+     *
+     * \return  false if I/O failed, or if no split can separate the keys
+     *          of the page and hash: they agree on every directory bit, or
+     *          the directory is at MaxDepth.
+     */
+    bool split(uint64_t hash)
+    {
+        uint32_t page = pageOf(hash);
+        Frame* from = frame(page);
+        if (!from) return false;
+
+        // no split separates keys that agree on all directory bits
+        PageHeader h = header(from->data.get());
+        uint64_t diff = 0;
+        for (size_t i = 0; i < h.count; ++i)
+        {
+            diff |= hashOf(keyAt(from->data.get(), i)) ^ hash;
+        }
+        if (!(diff & ((uint64_t(1) << MaxDepth) - 1) >> h.depth << h.depth))
+        {
+            return false;
+        }
+
+        if (h.depth == globalDepth)
+        {
+            if (globalDepth == MaxDepth) return false;
+            directory.resize(directory.size() * 2);
+            std::copy_n(directory.begin(), directory.size() / 2,
+                        directory.begin() + directory.size() / 2);
+            globalDepth++;
+        }
+
+        pinned = from;
+        uint32_t sibling = newPage(h.depth + 1);
+        Frame* to = frame(sibling);
+        pinned = nullptr;
+        if (!to) return false;
+
+        // move the keys with the new bit set over
+        char* a = from->data.get();
+        char* b = to->data.get();
+        uint64_t bit = uint64_t(1) << h.depth;
+        size_t keep = 0;
+        size_t moved = 0;
+        for (size_t i = 0; i < h.count; ++i)
+        {
+            K k = keyAt(a, i);
+            V v = valueAt(a, i);
+            if (hashOf(k) & bit) put(b, moved++, k, v);
+            else put(a, keep++, k, v);
+        }
+        setHeader(a, {uint32_t(keep), h.depth + 1});
+        setHeader(b, {uint32_t(moved), h.depth + 1});
+        from->dirty = to->dirty = true;
+        filterRebuild(page, a);
+        filterRebuild(sibling, b);
+        if (links[page].next && (links[page].hash & bit))
+        {
+            links[sibling] = std::exchange(links[page], Link{});
+        }
+
+        // directory slots of the old page with the new bit set
+        uint64_t low = hash & (bit - 1);
+        for (uint64_t i = low | bit; i < directory.size(); i += bit << 1)
+        {
+            directory[i] = sibling;
+        }
+        stats.splits++;
+        return true;
+    }
+
+  public:
+    Stats stats;
+
+    explicit SpillEHash(ehash::SpillOptions opts = {})
+        : SpillEHash(opts, ehash::random_seed())
+    {
+    }
+
+    /*!
+     * \brief   map with a given hash seed, for reproducible layouts.
+     */
+    SpillEHash(ehash::SpillOptions opts, uint64_t seed)
+        : opts(opts), hashSeed(seed)
+    {
+        this->opts.cachePages = std::max<size_t>(opts.cachePages, 2);
+        filterWords = (opts.filterBytes + 7) / 8;
+    }
+
+    ~SpillEHash()
+    {
+        if (fd >= 0) ::close(fd);
+    }
+
+    SpillEHash(const SpillEHash&) = delete;
+    SpillEHash& operator=(const SpillEHash&) = delete;
+
+    /*!
+     * \brief   create (or truncate) the backing file.
+     */
+    bool open(const std::string& path)
+    {
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+                    0644);
+        if (fd < 0) return false;
+        newPage(0);
+        return true;
+    }
+
+    /*!
+     * \brief   insert or overwrite.
+     *
+     * \return  false on an I/O error.
+     */
+    bool insert(const K& key, const V& value)
+    {
+        uint64_t hash = hashOf(key);
+        for (;;)
+        {
+            uint32_t page = pageOf(hash);
+            size_t i;
+            if (Frame* f = locate(page, hash, key, i))
+            {
+                put(f->data.get(), i, key, value);
+                f->dirty = true;
+                return true;
+            }
+            if (ioError) return false;
+
+            Frame* f = frame(page);
+            if (!f) return false;
+            if (header(f->data.get()).count < Capacity)
+            {
+                add(f, hash, key, value);
+                return true;
+            }
+            if (split(hash)) continue;
+            if (ioError) return false;
+            return chain(page, hash, key, value);
+        }
+    }
+
+    std::optional<V> find(const K& key)
+    {
+        uint64_t hash = hashOf(key);
+        uint32_t page = pageOf(hash);
+        if (!links[page].next && !filterMayHave(page, hash))
+        {
+            stats.filtered++;
+            return std::nullopt;
+        }
+
+        size_t i;
+        Frame* f = locate(page, hash, key, i);
+        if (!f) return std::nullopt;
+        return valueAt(f->data.get(), i);
+    }
+
+    /*!
+     * \brief   look up many keys, overlapping the page reads.
+     *
+     * \param   out out[i] receives find(keys[i]); at least keys.size() long
+     */
+    void find_batch(std::span<const K> keys, std::span<std::optional<V>> out)
+    {
+        for (size_t base = 0; base < keys.size(); base += BatchBlock)
+        {
+            size_t n = std::min(BatchBlock, keys.size() - base);
+            uint64_t hashes[BatchBlock];
+            if constexpr (ehash::BatchHashable<K>)
+            {
+                ehash::hash_batch(keys.subspan(base, n),
+                                  std::span<uint64_t>(hashes, n), hashSeed);
+            }
+            else
+            {
+                for (size_t i = 0; i < n; ++i) hashes[i] = hashOf(keys[base + i]);
+            }
+
+            for (size_t i = 0; i < n; ++i)
+            {
+                uint32_t page = pageOf(hashes[i]);
+                if (filterMayHave(page, hashes[i]) && !cached.count(page))
+                {
+                    ::posix_fadvise(fd, off_t(page) * off_t(PageBytes),
+                                    PageBytes, POSIX_FADV_WILLNEED);
+                    stats.prefetch++;
+                }
+            }
+
+            for (size_t i = 0; i < n; ++i) out[base + i] = find(keys[base + i]);
+        }
+    }
+
+    bool remove(const K& key)
+    {
+        uint64_t hash = hashOf(key);
+        size_t i;
+        Frame* f = locate(pageOf(hash), hash, key, i);
+        if (!f) return false;
+        char* data = f->data.get();
+
+        // the last entry fills the hole; the filter keeps a stale bit until
+        // the page next splits
+        PageHeader h = header(data);
+        h.count--;
+        put(data, i, keyAt(data, h.count), valueAt(data, h.count));
+        setHeader(data, h);
+        f->dirty = true;
+        numElements--;
+        return true;
+    }
+
+    /*!
+     * \brief   write every dirty page back.
+     */
+    bool flush()
+    {
+        for (Frame* f : lru)
+        {
+            if (!writeBack(*f)) return false;
+        }
+        return true;
+    }
+
+    /*!
+     * \brief   number of stored elements.
+     */
+    size_t size() const { return numElements; }
+
+    /*!
+     * \brief   the seed mixed into every hash.
+     */
+    uint64_t seed() const { return hashSeed; }
+
+    /*!
+     * \brief   pages in the file.
+     */
+    size_t pages() const { return numPages; }
+
+    /*!
+     * \brief   errno of the first failed read or write, 0 if none.
+     */
+    int error() const { return ioError; }
+};
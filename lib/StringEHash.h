@@ -0,0 +1,388 @@
+
+/*!
+ * \file    lib/StringEHash.h
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   hashmap with short string keys inline and long ones interned
+ *          in an arena.
+ *
+ * \note    EHash<std::string, V> gives every key past the SSO limit its own
+ *          heap block: 16+ bytes of malloc overhead per key, keys scattered
+ *          over the heap, and one free() per key on destruction.
+ *
+ *          here a key of up to 23 bytes is stored in the entry itself, as a
+ *          length byte plus the zero-padded bytes, and compared against
+ *          the probe with two 16-byte SIMD loads: a hit costs no pointer
+ *          chase. longer keys are appended to 64 KiB arena chunks owned by
+ *          the map and the entry holds their (offset, length).
+ *
+ *          entries (hash, key, value) sit densely in one array, so
+ *          iteration streams through it in insertion order; a hash index
+ *          of 8-byte slots (32 hash bits + entry number, linear probing)
+ *          points into the array. destroying or clearing the map frees
+ *          each arena chunk once rather than each key.
+ *
+ *          removed keys leave dead bytes in the arena; once they outweigh
+ *          the live ones the live keys are copied into fresh chunks.
+ */
+
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*!
+ * \brief   string-keyed hashmap.
+ *
+ * \tparam  V value type.
+ *
+ * \note    same interface as EHash, with std::string_view keys. pointers
+ *          returned by find() are valid until the next insert or remove.
+ */
+template<typename V> class StringEHash
+{
+  public:
+    static constexpr size_t InlineMax = 23; //!< longest key kept inline
+
+  private:
+    static constexpr uint8_t Spilled = 0xff; //!< Key::len of arena keys
+
+    /*!
+     * \brief   key of an entry: inline bytes, or where the arena has them.
+     *
+     * \note    inline: len is the length and text the bytes, zero padded,
+     *          so two equal keys are equal in all 24 bytes. spilled: len
+     *          is Spilled, the length is at text + 3 and the arena offset
+     *          (chunk << ChunkBits | position) at text + 7.
+     */
+    struct Key
+    {
+        uint8_t len;
+        char text[InlineMax];
+    };
+
+    static_assert(sizeof(Key) == 24);
+
+    /*!
+     * \brief   one key-value pair.
+     */
+    struct Entry
+    {
+        uint64_t hash; //!< full hash of the key
+        Key key;       //!< the key or its place in the arena
+        V value;       //!< associated value
+    };
+
+    static constexpr unsigned ChunkBits = 16;
+    static constexpr size_t ChunkBytes = size_t(1) << ChunkBits;
+
+    std::vector<std::unique_ptr<char[]>> chunks; //!< the arena
+    size_t bumpChunk = 0;         //!< chunk that takes the next small key
+    size_t bumpPos = ChunkBytes;  //!< its first unused byte (full: none yet)
+    size_t reserved = 0;          //!< bytes allocated for the arena
+    size_t liveBytes = 0;         //!< arena bytes of current entries
+    size_t deadBytes = 0;         //!< arena bytes of removed entries
+
+    std::vector<Entry> entries;  //!< dense; removes move the last one in
+    std::vector<uint64_t> slots; //!< hash >> 32 << 32 | entry + 1; 0 = empty
+    size_t mask = 0;             //!< slots.size() - 1
+    float maxLoad = 0.75f;       //!< load factor threshold
+
+    static uint64_t hashOf(std::string_view key)
+    {
+        return std::hash<std::string_view>{}(key);
+    }
+
+    static uint32_t tagOf(uint64_t hash) { return uint32_t(hash >> 32); }
+
+    static bool spilled(const Key& k) { return k.len == Spilled; }
+
+    static uint32_t spilledLength(const Key& k)
+    {
+        uint32_t length;
+        std::memcpy(&length, k.text + 3, sizeof length);
+        return length;
+    }
+
+    static uint64_t spilledOffset(const Key& k)
+    {
+        uint64_t offset;
+        std::memcpy(&offset, k.text + 7, sizeof offset);
+        return offset;
+    }
+
+    static Key spilledKey(uint64_t offset, uint32_t length)
+    {
+        Key k{};
+        k.len = Spilled;
+        std::memcpy(k.text + 3, &length, sizeof length);
+        std::memcpy(k.text + 7, &offset, sizeof offset);
+        return k;
+    }
+
+    /*!
+     * \brief   the inline form of s, if it is short enough.
+     */
+    static bool inlined(std::string_view s, Key& k)
+    {
+        if (s.size() > InlineMax) return false;
+        k = Key{};
+        k.len = uint8_t(s.size());
+        std::memcpy(k.text, s.data(), s.size());
+        return true;
+    }
+
+    static bool sameInline(const Key& a, const Key& b)
+    {
+#if defined(__SSE2__)
+        // bytes 0-15 and 8-23
+        auto* pa = reinterpret_cast<const char*>(&a);
+        auto* pb = reinterpret_cast<const char*>(&b);
+        __m128i lo = _mm_cmpeq_epi8(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(pa)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(pb)));
+        __m128i hi = _mm_cmpeq_epi8(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(pa + 8)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(pb + 8)));
+        return _mm_movemask_epi8(_mm_and_si128(lo, hi)) == 0xffff;
+#else
+        return std::memcmp(&a, &b, sizeof(Key)) == 0;
+#endif
+    }
+
+    static std::string_view keyIn(
+        const std::vector<std::unique_ptr<char[]>>& arena, const Key& k)
+    {
+        if (!spilled(k)) return {k.text, k.len};
+        uint64_t offset = spilledOffset(k);
+        return {arena[offset >> ChunkBits].get() + (offset & (ChunkBytes - 1)),
+                spilledLength(k)};
+    }
+
+    std::string_view keyOf(const Entry& e) const
+    {
+        return keyIn(chunks, e.key);
+    }
+
+    /*!
+     * \brief   copy key bytes into the arena.
+     *
+     * \return  the entry offset.
+     */
+    uint64_t intern(std::string_view key)
+    {
+        size_t len = key.size();
+        if (len >= ChunkBytes / 2)
+        {
+            // a big key gets a chunk of its own, the bump chunk stays
+            chunks.emplace_back(new char[len]);
+            reserved += len;
+            key.copy(chunks.back().get(), len);
+            return uint64_t(chunks.size() - 1) << ChunkBits;
+        }
+
+        if (len > ChunkBytes - bumpPos)
+        {
+            chunks.emplace_back(new char[ChunkBytes]);
+            reserved += ChunkBytes;
+            bumpChunk = chunks.size() - 1;
+            bumpPos = 0;
+        }
+        key.copy(chunks[bumpChunk].get() + bumpPos, len);
+        uint64_t offset = uint64_t(bumpChunk) << ChunkBits | bumpPos;
+        bumpPos += len;
+        return offset;
+    }
+
+    /*!
+     * \brief   slot of key, or size_t(-1).
+     */
+    size_t locate(std::string_view key, uint64_t hash) const
+    {
+        Key probe;
+        bool isShort = inlined(key, probe);
+        uint32_t tag = tagOf(hash);
+        for (size_t i = hash & mask;; i = (i + 1) & mask)
+        {
+            uint64_t s = slots[i];
+            if (!s) return size_t(-1);
+            if (uint32_t(s >> 32) != tag) continue;
+            const Key& k = entries[uint32_t(s) - 1].key;
+            if (isShort ? sameInline(k, probe)
+                        : spilled(k) && spilledLength(k) == key.size() &&
+                              keyIn(chunks, k) == key)
+            {
+                return i;
+            }
+        }
+    }
+
+    void place(uint64_t hash, size_t entry)
+    {
+        size_t i = hash & mask;
+        while (slots[i]) i = (i + 1) & mask;
+        slots[i] = uint64_t(tagOf(hash)) << 32 | uint64_t(entry + 1);
+    }
+
+    void rehash(size_t newSize)
+    {
+        slots.assign(newSize, 0);
+        mask = newSize - 1;
+        for (size_t i = 0; i < entries.size(); ++i) place(entries[i].hash, i);
+    }
+
+    /*!
+     * \brief   empty slot hole, shifting later slots of the run back so
+     *          every key stays reachable from its home without tombstones.
+     */
+    void unlink(size_t hole)
+    {
+        for (size_t j = (hole + 1) & mask; slots[j]; j = (j + 1) & mask)
+        {
+            size_t home = entries[uint32_t(slots[j]) - 1].hash & mask;
+            if (((j - home) & mask) >= ((j - hole) & mask))
+            {
+                slots[hole] = slots[j];
+                hole = j;
+            }
+        }
+        slots[hole] = 0;
+    }
+
+    /*!
+     * \brief   copy the live keys into fresh chunks.
+     */
+    void compact()
+    {
+        std::vector<std::unique_ptr<char[]>> old = std::move(chunks);
+        chunks.clear();
+        bumpPos = ChunkBytes;
+        reserved = 0;
+        for (Entry& e : entries)
+        {
+            if (!spilled(e.key)) continue;
+            uint32_t length = spilledLength(e.key);
+            e.key = spilledKey(intern(keyIn(old, e.key)), length);
+        }
+        deadBytes = 0;
+    }
+
+  public:
+    explicit StringEHash(size_t size = 8)
+    {
+        size_t cap = std::bit_ceil(
+            std::max<size_t>(static_cast<size_t>(size / maxLoad) + 1, 8));
+        slots.assign(cap, 0);
+        mask = cap - 1;
+    }
+
+    StringEHash(const StringEHash&) = delete;
+    StringEHash& operator=(const StringEHash&) = delete;
+    StringEHash(StringEHash&&) noexcept = default;
+    StringEHash& operator=(StringEHash&&) noexcept = default;
+
+    void insert(std::string_view key, const V& value)
+    {
+        uint64_t hash = hashOf(key);
+        size_t i = locate(key, hash);
+        if (i != size_t(-1))
+        {
+            entries[uint32_t(slots[i]) - 1].value = value;
+            return;
+        }
+
+        if (entries.size() + 1 > maxLoad * slots.size())
+        {
+            rehash(slots.size() * 2);
+        }
+        Key k;
+        if (!inlined(key, k))
+        {
+            k = spilledKey(intern(key), uint32_t(key.size()));
+            liveBytes += key.size();
+        }
+        entries.push_back({hash, k, value});
+        place(hash, entries.size() - 1);
+    }
+
+    V* find(std::string_view key)
+    {
+        size_t i = locate(key, hashOf(key));
+        return i == size_t(-1) ? nullptr : &entries[uint32_t(slots[i]) - 1].value;
+    }
+
+    bool remove(std::string_view key)
+    {
+        size_t i = locate(key, hashOf(key));
+        if (i == size_t(-1)) return false;
+
+        size_t idx = uint32_t(slots[i]) - 1;
+        unlink(i);
+        if (spilled(entries[idx].key))
+        {
+            liveBytes -= spilledLength(entries[idx].key);
+            deadBytes += spilledLength(entries[idx].key);
+        }
+
+        // the last entry moves into the gap; repoint its slot
+        size_t last = entries.size() - 1;
+        if (idx != last)
+        {
+            size_t j = entries[last].hash & mask;
+            while (uint32_t(slots[j]) != last + 1) j = (j + 1) & mask;
+            slots[j] = slots[j] >> 32 << 32 | uint64_t(idx + 1);
+            entries[idx] = std::move(entries[last]);
+        }
+        entries.pop_back();
+
+        if (deadBytes > liveBytes && deadBytes >= ChunkBytes) compact();
+        return true;
+    }
+
+    /*!
+     * \brief   call fn(key, value) for every element, in entry order.
+     */
+    template<typename F> void forEach(F&& fn) const
+    {
+        for (const Entry& e : entries) fn(keyOf(e), e.value);
+    }
+
+    /*!
+     * \brief   drop every element; frees the arena chunk by chunk and keeps
+     *          the index at its size.
+     */
+    void clear()
+    {
+        entries.clear();
+        chunks.clear();
+        std::fill(slots.begin(), slots.end(), 0);
+        bumpPos = ChunkBytes;
+        reserved = liveBytes = deadBytes = 0;
+    }
+
+    /*!
+     * \brief   number of stored elements.
+     */
+    size_t size() const { return entries.size(); }
+
+    /*!
+     * \brief   bytes held by arena, entries and index.
+     */
+    size_t memory() const
+    {
+        return reserved + entries.capacity() * sizeof(Entry) +
+               slots.capacity() * sizeof(uint64_t);
+    }
+};
@@ -0,0 +1,144 @@
+
+/*!
+ * \file    src/Histogram.h
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   HDR style latency histogram (log-linear buckets).
+ *
+ * \note    values below 2048 are counted exactly; above, every power of
+ *          two is split into 1024 linear sub-buckets, so any recorded
+ *          value is off by at most 0.1%. covers 1ns .. ~2^50ns.
+ */
+
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+/*!
+ * \brief   fixed-precision histogram of non-negative integer values.
+ */
+class Histogram
+{
+    static constexpr unsigned SubBits = 10;              //!< 1024 per octave
+    static constexpr uint64_t Linear = 2ULL << SubBits;  //!< exact below
+    static constexpr unsigned Octaves = 50 - SubBits;    //!< up to ~2^50
+
+    std::vector<uint64_t> counts;
+    uint64_t total = 0;
+    uint64_t maxValue = 0;
+    uint64_t minValue = ~uint64_t(0);
+    long double sum = 0;
+
+    static size_t indexOf(uint64_t v)
+    {
+        if (v < Linear) return static_cast<size_t>(v);
+        unsigned shift = std::bit_width(v) - (SubBits + 1);
+        uint64_t sub = (v >> shift) - (1ULL << SubBits);
+        return Linear + (shift - 1) * (1ULL << SubBits) + sub;
+    }
+
+    static uint64_t valueOf(size_t idx)
+    {
+        if (idx < Linear) return idx;
+        size_t rel = idx - Linear;
+        unsigned shift = static_cast<unsigned>(rel >> SubBits) + 1;
+        uint64_t sub = (rel & ((1ULL << SubBits) - 1)) + (1ULL << SubBits);
+        // middle of the sub-bucket
+        return (sub << shift) + ((1ULL << shift) >> 1);
+    }
+
+  public:
+    Histogram() : counts(Linear + Octaves * (1ULL << SubBits)) {}
+
+    /*!
+     * \brief   count one value; larger than the range clamps to the top.
+     */
+    void record(uint64_t v)
+    {
+        size_t idx = std::min(indexOf(v), counts.size() - 1);
+        counts[idx]++;
+        total++;
+        sum += v;
+        maxValue = std::max(maxValue, v);
+        minValue = std::min(minValue, v);
+    }
+
+    /*!
+     * \brief   add every count of another histogram.
+     */
+    void merge(const Histogram& o)
+    {
+        for (size_t i = 0; i < counts.size(); ++i) counts[i] += o.counts[i];
+        total += o.total;
+        sum += o.sum;
+        maxValue = std::max(maxValue, o.maxValue);
+        minValue = std::min(minValue, o.minValue);
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t max() const { return maxValue; }
+    uint64_t min() const { return total ? minValue : 0; }
+    double mean() const { return total ? double(sum / total) : 0.0; }
+
+    /*!
+     * \brief   smallest recorded value v with at least q of counts <= v.
+     */
+    uint64_t percentile(double q) const
+    {
+        if (total == 0) return 0;
+        uint64_t want = static_cast<uint64_t>(q / 100.0 * total + 0.5);
+        want = std::clamp<uint64_t>(want, 1, total);
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); ++i)
+        {
+            seen += counts[i];
+            if (seen >= want) return std::min(valueOf(i), maxValue);
+        }
+        return maxValue;
+    }
+
+    /*!
+     * \brief   print the percentile distribution, HdrHistogram style.
+     *
+     * \param   out   destination stream
+     * \param   scale divide values by this (e.g. 1000 for us from ns)
+     */
+    void print(FILE* out, double scale) const
+    {
+        std::fprintf(out, "%12s %12s %12s %14s\n", "Value", "Percentile",
+                     "TotalCount", "1/(1-Percentile)");
+
+        // halve the distance to 100% at every step, 4 ticks per halving
+        double q = 0;
+        for (int halvings = 0; halvings < 20; ++halvings)
+        {
+            double remaining = 100.0 / (1 << halvings);
+            for (int tick = 0; tick < 4; ++tick)
+            {
+                double p = 100.0 - remaining + remaining / 2 * tick / 4;
+                if (p < q) continue;
+                q = p;
+
+                uint64_t v = percentile(p);
+                uint64_t below = 0;
+                for (size_t i = 0; i <= std::min(indexOf(v), counts.size() - 1);
+                     ++i)
+                {
+                    below += counts[i];
+                }
+                std::fprintf(out, "%12.3f %12.6f %12llu %14.2f\n", v / scale,
+                             p / 100.0, static_cast<unsigned long long>(below),
+                             p < 100.0 ? 100.0 / (100.0 - p) : 0.0);
+            }
+            if (total >> halvings == 0) break;
+        }
+        std::fprintf(out, "%12.3f %12.6f %12llu %14s\n", maxValue / scale, 1.0,
+                     static_cast<unsigned long long>(total), "inf");
+    }
+};
@@ -0,0 +1,218 @@
+
+/*!
+ * \file    src/IoUring.cpp
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   ring setup, submission and provided buffers.
+ */
+
+#include "IoUring.h"
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+int sysSetup(unsigned entries, io_uring_params* p)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+}
+
+int sysEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags,
+             const void* arg, size_t argLen)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit,
+                                      minComplete, flags, arg, argLen));
+}
+
+int sysRegister(int fd, unsigned op, const void* arg, unsigned n)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, op, arg, n));
+}
+
+template<typename T> T* at(void* base, unsigned offset)
+{
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+} // namespace
+
+IoUring::~IoUring()
+{
+    if (bufRing) ::munmap(bufRing, bufRingLen);
+    delete[] bufMem;
+    if (sqes) ::munmap(sqes, sqesLen);
+    if (cqMap && cqMap != sqMap) ::munmap(cqMap, cqMapLen);
+    if (sqMap) ::munmap(sqMap, sqMapLen);
+    if (ringFd >= 0) ::close(ringFd);
+}
+
+bool IoUring::init(unsigned entries)
+{
+    io_uring_params p{};
+    p.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+    ringFd = sysSetup(entries, &p);
+    if (ringFd < 0 && errno == EINVAL)
+    {
+        p = io_uring_params{}; // pre-6.0 kernel: plain ring
+        ringFd = sysSetup(entries, &p);
+    }
+    if (ringFd < 0) return false;
+
+    extArg = p.features & IORING_FEAT_EXT_ARG;
+
+    sqMapLen = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqMapLen = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single && cqMapLen > sqMapLen) sqMapLen = cqMapLen;
+
+    sqMap = ::mmap(nullptr, sqMapLen, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqMap == MAP_FAILED)
+    {
+        sqMap = nullptr;
+        return false;
+    }
+
+    cqMap = sqMap;
+    if (!single)
+    {
+        cqMap = ::mmap(nullptr, cqMapLen, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (cqMap == MAP_FAILED)
+        {
+            cqMap = nullptr;
+            return false;
+        }
+    }
+
+    sqesLen = p.sq_entries * sizeof(io_uring_sqe);
+    void* s = ::mmap(nullptr, sqesLen, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (s == MAP_FAILED) return false;
+    sqes = static_cast<io_uring_sqe*>(s);
+
+    sqHead = at<unsigned>(sqMap, p.sq_off.head);
+    sqTail = at<unsigned>(sqMap, p.sq_off.tail);
+    sqArray = at<unsigned>(sqMap, p.sq_off.array);
+    sqMask = *at<unsigned>(sqMap, p.sq_off.ring_mask);
+    sqEntries = p.sq_entries;
+    sqeTail = submitted = *sqTail;
+
+    cqHead = at<unsigned>(cqMap, p.cq_off.head);
+    cqTail = at<unsigned>(cqMap, p.cq_off.tail);
+    cqMask = *at<unsigned>(cqMap, p.cq_off.ring_mask);
+    cqes = at<io_uring_cqe>(cqMap, p.cq_off.cqes);
+    return true;
+}
+
+bool IoUring::initBuffers(uint16_t group, unsigned count, unsigned size)
+{
+    // the ring must be a power of two and page aligned
+    bufRingLen = count * sizeof(io_uring_buf);
+    void* r = ::mmap(nullptr, bufRingLen, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (r == MAP_FAILED) return false;
+    bufRing = static_cast<io_uring_buf_ring*>(r);
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(bufRing);
+    reg.ring_entries = count;
+    reg.bgid = group;
+    if (sysRegister(ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+        ::munmap(bufRing, bufRingLen);
+        bufRing = nullptr;
+        return false;
+    }
+
+    bufCount = count;
+    bufSize = size;
+    bufMem = new char[size_t(count) * size];
+    for (unsigned i = 0; i < count; ++i) recycle(static_cast<uint16_t>(i));
+    return true;
+}
+
+void IoUring::recycle(uint16_t bid)
+{
+    // index from the ring base: in C++ the uapi flex-array wrapper puts
+    // bufs[] 8 bytes in, on top of the tail field the kernel reads
+    io_uring_buf& b = reinterpret_cast<io_uring_buf*>(
+        bufRing)[bufTail & (bufCount - 1)];
+    b.addr = reinterpret_cast<uint64_t>(bufMem + size_t(bid) * bufSize);
+    b.len = bufSize;
+    b.bid = bid;
+    ++bufTail;
+    __atomic_store_n(&bufRing->tail, bufTail, __ATOMIC_RELEASE);
+}
+
+bool IoUring::park()
+{
+    unsigned head = *cqHead;
+    unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    if (head == tail) return false;
+
+    for (; head != tail; ++head) parked.push_back(cqes[head & cqMask]);
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    return true;
+}
+
+io_uring_sqe* IoUring::sqe()
+{
+    // the slot after a full ring is one the kernel has not read yet
+    while (sqeTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries)
+    {
+        int n = submit(0);
+        if (n > 0 || n == -EINTR) continue;
+        if ((n == -EBUSY || n == -EAGAIN) && park()) continue;
+        return nullptr;
+    }
+
+    unsigned idx = sqeTail & sqMask;
+    io_uring_sqe* e = &sqes[idx];
+    std::memset(e, 0, sizeof(*e));
+    sqArray[idx] = idx;
+    ++sqeTail;
+    return e;
+}
+
+int IoUring::submit(unsigned waitFor, uint64_t timeoutNs)
+{
+    unsigned toSubmit = sqeTail - submitted;
+    if (toSubmit == 0 && waitFor == 0) return 0;
+
+    __atomic_store_n(sqTail, sqeTail, __ATOMIC_RELEASE);
+
+    unsigned flags = waitFor ? IORING_ENTER_GETEVENTS : 0;
+    __kernel_timespec ts{};
+    io_uring_getevents_arg arg{};
+    const void* argp = nullptr;
+    size_t argLen = 0;
+
+    if (waitFor && timeoutNs && extArg)
+    {
+        ts.tv_sec = static_cast<int64_t>(timeoutNs / 1'000'000'000);
+        ts.tv_nsec = static_cast<int64_t>(timeoutNs % 1'000'000'000);
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+        flags |= IORING_ENTER_EXT_ARG;
+        argp = &arg;
+        argLen = sizeof(arg);
+    }
+    else if (waitFor && timeoutNs)
+    {
+        waitFor = 0; // no timed waits on this kernel: poll instead
+        flags &= ~IORING_ENTER_GETEVENTS;
+    }
+
+    ++enters;
+    int n = sysEnter(ringFd, toSubmit, waitFor, flags, argp, argLen);
+
+    // EINTR, ETIME, or EBUSY/EAGAIN (completion queue backed up): the
+    // loop drains completions and submits again on its next round
+    if (n < 0) return -errno;
+    submitted += static_cast<unsigned>(n);
+    return n;
+}
@@ -0,0 +1,147 @@
+
+/*!
+ * \file    src/IoUring.h
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   minimal io_uring wrapper on the raw syscalls (no liburing).
+ *
+ * \note    covers what the server needs: batched submission, completion
+ *          draining, and a provided-buffer ring registered with the kernel
+ *          for multishot receives.
+ *
+ *          a full submission queue is submitted before a slot is reused.
+ *          when the kernel refuses (completions backed up), the waiting
+ *          completions are parked in memory and handed out by the next
+ *          drain(), and the submit is tried again.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <vector>
+
+/*!
+ * \brief   one io_uring instance, driven by a single thread.
+ */
+class IoUring
+{
+    int ringFd = -1;
+
+    void* sqMap = nullptr;
+    size_t sqMapLen = 0;
+    void* cqMap = nullptr;
+    size_t cqMapLen = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqesLen = 0;
+
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned sqMask = 0;
+    unsigned sqEntries = 0;
+    unsigned sqeTail = 0;   //!< next sqe handed out by sqe()
+    unsigned submitted = 0; //!< sqes already passed to the kernel
+
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+    std::vector<io_uring_cqe> parked; //!< reaped, not yet drained
+    size_t parkedPos = 0;             //!< next parked one to hand out
+
+    bool extArg = false; //!< IORING_FEAT_EXT_ARG (timed waits)
+
+    io_uring_buf_ring* bufRing = nullptr;
+    size_t bufRingLen = 0;
+    char* bufMem = nullptr;
+    unsigned bufCount = 0;
+    unsigned bufSize = 0;
+    uint16_t bufTail = 0;
+
+    bool park();
+
+  public:
+    uint64_t enters = 0; //!< io_uring_enter syscalls made
+
+    IoUring() = default;
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    /*!
+     * \brief   create the ring; false if io_uring is unavailable.
+     */
+    bool init(unsigned entries);
+
+    /*!
+     * \brief   register count provided buffers of size bytes each.
+     *
+     * \return  false if the kernel lacks buffer rings (< 5.19).
+     */
+    bool initBuffers(uint16_t group, unsigned count, unsigned size);
+
+    /*!
+     * \brief   zeroed sqe to fill; submits first if the ring is full.
+     *
+     * \return  nullptr if the kernel takes no submissions even with the
+     *          completions parked; try again on a later round.
+     */
+    io_uring_sqe* sqe();
+
+    /*!
+     * \brief   submit pending sqes, optionally waiting for completions.
+     *
+     * \param   waitFor    completions to wait for (0 = do not block)
+     * \param   timeoutNs  give up waiting after this long (0 = never)
+     *
+     * \return  sqes consumed, or -errno.
+     */
+    int submit(unsigned waitFor, uint64_t timeoutNs = 0);
+
+    /*!
+     * \brief   hand every available completion to fn and retire it,
+     *          parked ones first.
+     */
+    template<typename F> unsigned drain(F&& fn)
+    {
+        unsigned n = 0;
+        for (;; ++n)
+        {
+            // copy: fn may queue work that wants the slot back, or park
+            // the rest of the ring behind this one
+            io_uring_cqe cqe;
+            if (parkedPos < parked.size())
+            {
+                cqe = parked[parkedPos++];
+            }
+            else
+            {
+                parked.clear();
+                parkedPos = 0;
+                unsigned head = *cqHead;
+                if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) break;
+                cqe = cqes[head & cqMask];
+                __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+            }
+            fn(cqe);
+        }
+        return n;
+    }
+
+    /*!
+     * \brief   data of provided buffer bid.
+     */
+    const char* buffer(uint16_t bid) const
+    {
+        return bufMem + size_t(bid) * bufSize;
+    }
+
+    /*!
+     * \brief   give provided buffer bid back to the kernel.
+     */
+    void recycle(uint16_t bid);
+};
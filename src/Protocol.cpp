@@ -0,0 +1,119 @@
+
+/*!
+ * \file    src/Protocol.cpp
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   request parsing and reply formatting for the ehash server.
+ */
+
+#include "Protocol.h"
+#include <strings.h>
+
+namespace proto
+{
+namespace
+{
+bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+bool equalsNoCase(std::string_view a, const char* b)
+{
+    size_t n = std::char_traits<char>::length(b);
+    return a.size() == n && strncasecmp(a.data(), b, n) == 0;
+}
+} // namespace
+
+void parseRequest(std::string_view line, Request& req)
+{
+    req.op = Op::Invalid;
+    req.args.clear();
+    req.error = nullptr;
+
+    std::string_view cmd;
+    size_t i = 0;
+    while (i < line.size())
+    {
+        while (i < line.size() && isBlank(line[i])) ++i;
+        size_t start = i;
+        while (i < line.size() && !isBlank(line[i])) ++i;
+        if (i == start) break;
+
+        std::string_view token = line.substr(start, i - start);
+        if (cmd.empty())
+        {
+            cmd = token;
+        }
+        else
+        {
+            req.args.push_back(token);
+        }
+    }
+
+    size_t argc = req.args.size();
+    if (cmd.empty())
+    {
+        req.error = "empty request";
+    }
+    else if (equalsNoCase(cmd, "GET"))
+    {
+        if (argc == 1) req.op = Op::Get;
+        else req.error = "GET takes one key";
+    }
+    else if (equalsNoCase(cmd, "SET"))
+    {
+        if (argc == 2) req.op = Op::Set;
+        else req.error = "SET takes a key and a value";
+    }
+    else if (equalsNoCase(cmd, "DEL"))
+    {
+        if (argc == 1) req.op = Op::Del;
+        else req.error = "DEL takes one key";
+    }
+    else if (equalsNoCase(cmd, "MGET"))
+    {
+        if (argc >= 1) req.op = Op::MGet;
+        else req.error = "MGET takes at least one key";
+    }
+    else if (equalsNoCase(cmd, "PING"))
+    {
+        req.op = Op::Ping;
+    }
+    else if (equalsNoCase(cmd, "QUIT"))
+    {
+        req.op = Op::Quit;
+    }
+    else
+    {
+        req.error = "unknown command";
+    }
+}
+
+void appendValue(std::string& out, const std::string* value)
+{
+    if (value)
+    {
+        out += "VALUE ";
+        out += *value;
+        out += '\n';
+    }
+    else
+    {
+        out += "NIL\n";
+    }
+}
+
+void appendArray(std::string& out, size_t n)
+{
+    out += '*';
+    out += std::to_string(n);
+    out += '\n';
+}
+
+void appendError(std::string& out, const char* reason)
+{
+    out += "ERR ";
+    out += reason;
+    out += '\n';
+}
+} // namespace proto
@@ -0,0 +1,80 @@
+
+/*!
+ * \file    src/Protocol.h
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   line based text protocol spoken by the ehash server.
+ *
+ * \note    one request per line, tokens separated by blanks, '\n' or
+ *          "\r\n" terminated. keys and values are single tokens.
+ *
+ *          request                 reply
+ *          GET <key>               VALUE <value> | NIL
+ *          SET <key> <value>       OK
+ *          DEL <key>               1 | 0
+ *          MGET <key> [<key> ...]  *<n> then n GET replies
+ *          PING                    PONG
+ *          QUIT                    (connection closed)
+ *
+ *          malformed requests get "ERR <reason>". requests may be
+ *          pipelined; replies come back in request order.
+ */
+
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace proto
+{
+constexpr size_t MaxLine = 64 * 1024; //!< longest accepted request line
+
+/*!
+ * \brief   request kinds.
+ */
+enum class Op
+{
+    Get,
+    Set,
+    Del,
+    MGet,
+    Ping,
+    Quit,
+    Invalid
+};
+
+/*!
+ * \brief   a parsed request; args point into the parsed line.
+ */
+struct Request
+{
+    Op op = Op::Invalid;
+    std::vector<std::string_view> args; //!< arguments after the command
+    const char* error = nullptr;        //!< reason when op == Invalid
+};
+
+/*!
+ * \brief   parse one request line (terminator already stripped).
+ *
+ * \param   line request text
+ * \param   req  reused output, args are views into line
+ */
+void parseRequest(std::string_view line, Request& req);
+
+/*!
+ * \brief   append a GET style reply for a value (nullptr = missing).
+ */
+void appendValue(std::string& out, const std::string* value);
+
+/*!
+ * \brief   append the header line of an MGET reply.
+ */
+void appendArray(std::string& out, size_t n);
+
+/*!
+ * \brief   append an error reply.
+ */
+void appendError(std::string& out, const char* reason);
+} // namespace proto
@@ -0,0 +1,282 @@
+
+/*!
+ * \file    src/Server.cpp
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   listener setup and shard threads of the ehash server.
+ */
+
+#include "Server.h"
+#include "EHashNuma.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+Server::Server(ServerOptions options) : opts(std::move(options))
+{
+    if (opts.threads == 0)
+    {
+        opts.threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    opts.buckets = std::max<size_t>(1, opts.buckets);
+}
+
+Server::~Server()
+{
+    for (auto& t : threads) t.join();
+    shards.clear();
+
+    if (listenFd >= 0)
+    {
+        ::close(listenFd);
+        if (!opts.unixPath.empty()) ::unlink(opts.unixPath.c_str());
+    }
+}
+
+bool Server::listen()
+{
+    if (!opts.unixPath.empty())
+    {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (opts.unixPath.size() >= sizeof(addr.sun_path))
+        {
+            std::fprintf(stderr, "ehash: socket path too long\n");
+            return false;
+        }
+        std::memcpy(addr.sun_path, opts.unixPath.c_str(),
+                    opts.unixPath.size() + 1);
+
+        listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (listenFd < 0) return false;
+        ::unlink(opts.unixPath.c_str());
+        if (::bind(listenFd, reinterpret_cast<sockaddr*>(&addr),
+                   sizeof(addr)) < 0)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(opts.port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        listenFd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (listenFd < 0) return false;
+        int one = 1;
+        ::setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (::bind(listenFd, reinterpret_cast<sockaddr*>(&addr),
+                   sizeof(addr)) < 0)
+        {
+            return false;
+        }
+    }
+    return ::listen(listenFd, SOMAXCONN) == 0;
+}
+
+bool Server::openWalDir()
+{
+    if (::mkdir(opts.walDir.c_str(), 0755) < 0 && errno != EEXIST)
+    {
+        std::perror("ehash: wal directory");
+        return false;
+    }
+
+    // keys are routed by shard count: refuse files written with another
+    std::string marker = opts.walDir + "/SHARDS";
+    if (FILE* f = std::fopen(marker.c_str(), "r"))
+    {
+        size_t n = 0;
+        bool ok = std::fscanf(f, "%zu", &n) == 1;
+        std::fclose(f);
+        if (!ok || n != opts.threads)
+        {
+            std::fprintf(stderr,
+                         "ehash: %s was written by %zu shards; restart with "
+                         "--threads %zu\n",
+                         opts.walDir.c_str(), n, n);
+            return false;
+        }
+        return true;
+    }
+
+    FILE* f = std::fopen(marker.c_str(), "w");
+    if (!f || std::fprintf(f, "%zu\n", opts.threads) < 0 || std::fclose(f))
+    {
+        std::perror("ehash: wal directory");
+        return false;
+    }
+    return true;
+}
+
+bool Server::start()
+{
+    if (!listen())
+    {
+        std::perror("ehash: listen");
+        return false;
+    }
+    if (!opts.walDir.empty() && !openWalDir()) return false;
+    if (!place()) return false;
+
+    for (size_t i = 0; i < opts.threads; ++i)
+    {
+        shards.push_back(
+            std::make_unique<Shard>(i, shards, opts, listenFd, placement[i]));
+    }
+    for (auto& s : shards)
+    {
+        if (!s->start())
+        {
+            std::perror("ehash: shard setup");
+            return false;
+        }
+    }
+
+    if (!opts.walDir.empty())
+    {
+        // make newly created logs survive a crash too
+        int dir = ::open(opts.walDir.c_str(), O_RDONLY | O_DIRECTORY);
+        if (dir >= 0)
+        {
+            ::fsync(dir);
+            ::close(dir);
+        }
+    }
+    return true;
+}
+
+bool Server::place()
+{
+    for (int node : opts.numaNodes)
+    {
+        if (!ehash::Numa::isOnline(node))
+        {
+            std::fprintf(stderr, "ehash: NUMA node %d is not online\n", node);
+            return false;
+        }
+    }
+
+    const std::vector<int>& online = ehash::Numa::online();
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < opts.threads; ++i)
+    {
+        if (!opts.numaNodes.empty())
+        {
+            placement.push_back(opts.numaNodes[i % opts.numaNodes.size()]);
+        }
+        else if (opts.pin)
+        {
+            placement.push_back(ehash::Numa::nodeOfCpu(int(i % cores)));
+        }
+        else
+        {
+            placement.push_back(online[i % online.size()]);
+        }
+    }
+    return true;
+}
+
+void Server::pin(size_t shard)
+{
+    if (!opts.pin) return;
+
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    size_t cpu = shard % cores;
+    if (!opts.numaNodes.empty())
+    {
+        // the k-th shard placed on a node takes the node's k-th cpu
+        std::vector<int> cpus = ehash::Numa::cpusOf(placement[shard]);
+        size_t k = size_t(std::count(placement.begin(),
+                                     placement.begin() + shard,
+                                     placement[shard]));
+        if (!cpus.empty()) cpu = size_t(cpus[k % cpus.size()]);
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+}
+
+void Server::run()
+{
+    auto started = std::chrono::steady_clock::now();
+
+    for (size_t i = 1; i < shards.size(); ++i)
+    {
+        threads.emplace_back([this, i] {
+            pin(i);
+            shards[i]->run();
+        });
+    }
+
+    pin(0);
+    shards[0]->run();
+
+    for (auto& t : threads) t.join();
+    threads.clear();
+
+    auto stopped = std::chrono::steady_clock::now();
+    report(std::chrono::duration<double>(stopped - started).count());
+}
+
+void Server::report(double seconds) const
+{
+    uint64_t requests = 0;
+    uint64_t syscalls = 0;
+    uint64_t walSyncs = 0;
+    uint64_t snapshots = 0;
+
+    for (size_t i = 0; i < shards.size(); ++i)
+    {
+        const Shard::Stats& st = shards[i]->stats();
+        requests += st.requests;
+        syscalls += st.syscalls;
+        walSyncs += st.walSyncs;
+        snapshots += st.snapshots;
+        std::fprintf(stderr,
+                     "ehash: shard %zu [%s, node %d] %llu requests, "
+                     "%llu syscalls\n",
+                     i, shards[i]->usesUring() ? "io_uring" : "epoll",
+                     placement[i],
+                     static_cast<unsigned long long>(st.requests),
+                     static_cast<unsigned long long>(st.syscalls));
+    }
+
+    std::fprintf(stderr,
+                 "ehash: %llu requests in %.2fs (%.0f req/s), "
+                 "%.3f syscalls/request\n",
+                 static_cast<unsigned long long>(requests), seconds,
+                 seconds > 0 ? requests / seconds : 0.0,
+                 requests ? double(syscalls) / requests : 0.0);
+    if (!opts.walDir.empty())
+    {
+        std::fprintf(stderr,
+                     "ehash: %llu wal syncs (%.1f requests/sync), "
+                     "%llu snapshots\n",
+                     static_cast<unsigned long long>(walSyncs),
+                     walSyncs ? double(requests) / walSyncs : 0.0,
+                     static_cast<unsigned long long>(snapshots));
+    }
+}
+
+void Server::stop()
+{
+    for (auto& s : shards) s->stop();
+}
@@ -0,0 +1,120 @@
+
+/*!
+ * \file    src/Server.h
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   single-binary in-memory key-value server around EHash.
+ *
+ * \note    shard-per-core: N event-loop threads, each pinned to a core and
+ *          owning one EHash shard (see Shard.h); see Protocol.h for the
+ *          wire format.
+ *
+ *          on a NUMA machine every shard has a node, by default the node
+ *          of its core, and allocates its table from that node's memory.
+ *          nodeOf() tells which, so work can be routed to local shards.
+ *
+ *          with a WAL directory every shard logs its SETs and DELs and
+ *          snapshots itself in the background (see ShardLog.h), and
+ *          recovers from both on start. logs are written once per loop
+ *          round and synced per ServerOptions::walSyncUs / walSyncBytes.
+ *          a SET or DEL is answered only once the sync covering its record
+ *          has returned, so an acknowledged write survives a process or
+ *          OS crash; it costs the write up to one sync interval of
+ *          latency, and later replies on the connection wait behind it.
+ *          a GET from another connection may see a write before it is
+ *          durable. while the log cannot be written or synced, writes are
+ *          refused with an error, and those waiting on the failed sync
+ *          are answered with one.
+ */
+
+#pragma once
+#include "Shard.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*!
+ * \brief   socket I/O backend of the event loops.
+ */
+enum class IoBackend
+{
+    Auto,  //!< io_uring when the kernel allows it, else epoll
+    Epoll, //!< readiness based, one syscall per read/write
+    Uring  //!< completion based, batched submissions
+};
+
+/*!
+ * \brief   server configuration.
+ */
+struct ServerOptions
+{
+    std::string unixPath;       //!< listen on this unix socket when set
+    uint16_t port = 7379;       //!< otherwise listen on 127.0.0.1:port
+    size_t buckets = 1 << 16;   //!< initial EHash buckets per shard
+    size_t threads = 0;         //!< event loops; 0 = one per core
+    bool pin = true;            //!< pin loop i to core i
+    bool numa = true;           //!< allocate each shard on its NUMA node
+    std::vector<int> numaNodes; //!< shard i on numaNodes[i % size]; empty =
+                                //!< the node of its core
+    IoBackend io = IoBackend::Auto;
+
+    std::string walDir;              //!< log writes here when set
+    uint64_t walSyncUs = 1000;       //!< group commit: fdatasync interval
+    size_t walSyncBytes = 1 << 20;   //!< or after this many unsynced bytes
+    size_t snapshotBytes = 64 << 20; //!< log bytes between snapshots; 0 = off
+};
+
+/*!
+ * \brief   key-value server: listener plus one Shard per thread.
+ */
+class Server
+{
+    ServerOptions opts;
+    int listenFd = -1;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::vector<std::thread> threads;
+    std::vector<int> placement; //!< NUMA node of each shard
+
+    bool listen();
+    bool place();
+    bool openWalDir();
+    void pin(size_t shard);
+    void report(double seconds) const;
+
+  public:
+    explicit Server(ServerOptions options);
+    ~Server();
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    /*!
+     * \brief   open the listener and set up every shard.
+     *
+     * \return  false (after printing the reason) on failure.
+     */
+    bool start();
+
+    /*!
+     * \brief   serve until stop(); shard 0 runs on the calling thread.
+     *
+     * \note    prints per-shard request and syscall counts on return.
+     */
+    void run();
+
+    /*!
+     * \brief   NUMA node whose memory holds a shard; 0 on one-node systems.
+     *
+     * \note    valid after start().
+     */
+    int nodeOf(size_t shard) const { return placement[shard]; }
+
+    /*!
+     * \brief   ask every shard to return; async-signal-safe.
+     */
+    void stop();
+};
@@ -0,0 +1,1026 @@
+
+/*!
+ * \file    src/Shard.cpp
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   event loops, request routing and cross-shard messaging.
+ */
+
+#include "Shard.h"
+#include "Server.h"
+#include "EHashNuma.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+constexpr size_t ReadChunk = 64 * 1024;     //!< bytes per read() call
+constexpr size_t MaxPendingOut = 4 << 20;   //!< stop reading above this
+constexpr size_t MaxSlots = 4096;           //!< in-flight remote replies
+constexpr size_t QueueDepth = 16 * 1024;    //!< per shard pair
+constexpr int MaxEvents = 256;              //!< epoll_wait batch size
+constexpr uint64_t WakeTag = ~uint64_t(0);  //!< epoll tag of the eventfd
+constexpr uint64_t ListenTag = WakeTag - 1; //!< epoll tag of the listener
+
+constexpr unsigned RingEntries = 1024;   //!< submission queue size
+constexpr uint16_t BufGroup = 0;         //!< provided buffer group id
+constexpr unsigned BufCount = 1024;      //!< provided buffers (power of 2)
+constexpr unsigned BufSize = 16 * 1024;  //!< bytes per provided buffer
+
+/*!
+ * \brief   io_uring completion kinds, kept in the top byte of user_data.
+ */
+enum class Tag : uint8_t
+{
+    Accept = 1,
+    Wake,
+    Recv,
+    Send,
+    Cancel
+};
+
+bool isWrite(proto::Op op)
+{
+    return op == proto::Op::Set || op == proto::Op::Del;
+}
+
+uint64_t pack(Tag tag, int fd = 0, uint32_t gen = 0)
+{
+    return uint64_t(tag) << 56 | uint64_t(gen & 0xffffff) << 32 |
+           static_cast<uint32_t>(fd);
+}
+} // namespace
+
+Shard::Shard(size_t id, std::vector<std::unique_ptr<Shard>>& peers,
+             const ServerOptions& opts, int listenFd, int numaNode)
+    : id(id), peers(peers), opts(opts), listenFd(listenFd),
+      numaNode(numaNode), store(1)
+{
+}
+
+Shard::~Shard()
+{
+    for (auto& c : conns)
+    {
+        if (c) ::close(c->fd);
+    }
+    if (epollFd >= 0) ::close(epollFd);
+    if (wakeFd >= 0) ::close(wakeFd);
+}
+
+size_t Shard::ownerOf(std::string_view key, size_t shards)
+{
+    // remix so the shard bits are independent of the bucket bits that
+    // EHash derives from the same std::hash value
+    return ehash::mix64(std::hash<std::string_view>{}(key)) % shards;
+}
+
+bool Shard::start()
+{
+    epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || wakeFd < 0) return false;
+
+    // exclusive: one shard wakes per incoming connection
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+    ev.data.u64 = ListenTag;
+    if (::epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev) < 0) return false;
+
+    ev.events = EPOLLIN;
+    ev.data.u64 = WakeTag;
+    if (::epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev) < 0) return false;
+
+    for (size_t i = 0; i < peers.size(); ++i)
+    {
+        inbox.push_back(std::make_unique<SpscQueue<Message>>(QueueDepth));
+    }
+    outbox.resize(peers.size());
+    mustWake.resize(peers.size());
+
+    if (!opts.walDir.empty())
+    {
+        log = std::make_unique<ShardLog>(opts, id);
+        if (!log->open()) return false;
+    }
+    return true;
+}
+
+void Shard::stop()
+{
+    stopping.store(true, std::memory_order_relaxed);
+    wake();
+}
+
+void Shard::wake()
+{
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t n = ::write(wakeFd, &one, sizeof(one));
+}
+
+void Shard::run()
+{
+    // allocate the table on this thread, after setting its policy: the
+    // bucket array, the pool slabs and the strings all land on the node
+    if (opts.numa && !ehash::Numa::preferNode(numaNode) && id == 0)
+    {
+        std::perror("ehash: set_mempolicy");
+    }
+    store = ShardLog::Store(opts.buckets);
+
+    // on the loop's thread, so shards recover in parallel; peers' requests
+    // wait in the inbox meanwhile
+    if (log && !log->recover(store))
+    {
+        log.reset(); // do not log on top of files we could not read
+        for (auto& p : peers) p->stop();
+        return;
+    }
+
+    if (opts.io != IoBackend::Epoll && setupRing())
+    {
+        runUring();
+    }
+    else
+    {
+        bool asked = opts.io == IoBackend::Uring;
+        if (asked || (opts.io == IoBackend::Auto && id == 0))
+        {
+            std::fprintf(stderr, "ehash: io_uring unavailable, using epoll\n");
+        }
+        runEpoll();
+    }
+
+    if (log)
+    {
+        log->close();
+        counters.walSyncs = log->stats().syncs;
+        counters.snapshots = log->stats().snapshots;
+        counters.syscalls += log->stats().syscalls;
+    }
+}
+
+int Shard::prepareWait()
+{
+    bool busy = drainInbox();
+    flushOutboxes();
+    serviceDirty();
+
+    // one log write for everything this round changed; the writes its
+    // sync made durable are answered right away
+    int idle = -1;
+    if (log)
+    {
+        log->commit(store);
+        releaseHeld();
+        serviceDirty();
+        idle = log->dueMs();
+    }
+    flushOutboxes();
+
+    if (ring)
+    {
+        if (!acceptArmed) armAccept();
+        if (!wakeArmed) armWake();
+    }
+
+    if (busy) return 0;
+    bool backlog = !dirty.empty() || (ring && !(acceptArmed && wakeArmed));
+    for (auto& q : outbox) backlog |= !q.empty();
+    if (backlog) return idle < 0 ? 1 : std::min(idle, 1);
+
+    // announce the nap, then recheck: a peer either sees the flag and
+    // writes the eventfd, or we see its message here
+    sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return inboxEmpty() ? idle : 0;
+}
+
+void Shard::serviceDirty()
+{
+    // a pump the ring turned away marks its connection again, for the
+    // next round: only the ones queued so far are serviced now
+    size_t n = dirty.size();
+    for (size_t i = 0; i < n; ++i)
+    {
+        Connection* c = conns[dirty[i]].get();
+        if (!c) continue;
+        c->dirty = false;
+        if (ring)
+        {
+            pump(*c);
+        }
+        else
+        {
+            handle(*c);
+        }
+    }
+    dirty.erase(dirty.begin(), dirty.begin() + n);
+}
+
+void Shard::revisit(Connection& c)
+{
+    if (!c.dirty)
+    {
+        c.dirty = true;
+        dirty.push_back(c.fd);
+    }
+}
+
+void Shard::runEpoll()
+{
+    epoll_event events[MaxEvents];
+
+    while (!stopping.load(std::memory_order_relaxed))
+    {
+        int timeout = prepareWait();
+        int n = ::epoll_wait(epollFd, events, MaxEvents, timeout);
+        counters.syscalls++;
+        sleeping.store(false, std::memory_order_relaxed);
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            std::perror("ehash: epoll_wait");
+            return;
+        }
+
+        for (int i = 0; i < n; ++i)
+        {
+            uint64_t tag = events[i].data.u64;
+            if (tag == WakeTag)
+            {
+                [[maybe_unused]] ssize_t r =
+                    ::read(wakeFd, &wakeCount, sizeof(wakeCount));
+                counters.syscalls++;
+                continue;
+            }
+            if (tag == ListenTag)
+            {
+                acceptAll();
+                continue;
+            }
+
+            int fd = static_cast<int>(tag);
+            if (fd < static_cast<int>(conns.size()) && conns[fd])
+            {
+                handle(*conns[fd]);
+            }
+        }
+    }
+}
+
+void Shard::acceptAll()
+{
+    for (;;)
+    {
+        int fd = ::accept4(listenFd, nullptr, nullptr,
+                           SOCK_NONBLOCK | SOCK_CLOEXEC);
+        counters.syscalls++;
+        if (fd < 0)
+        {
+            if (errno == EINTR) continue;
+            return; // EAGAIN (a sibling took it), or out of fds
+        }
+        accepted(fd);
+    }
+}
+
+void Shard::accepted(int fd)
+{
+    // deal connections round-robin: whichever loop the kernel woke for
+    // the accept, the clients end up spread over all of them
+    size_t to = nextPeer++ % peers.size();
+    if (to == id)
+    {
+        adopt(fd);
+        return;
+    }
+
+    Message m;
+    m.kind = Message::Kind::Adopt;
+    m.fd = fd;
+    send(to, m);
+}
+
+void Shard::adopt(int fd)
+{
+    Connection& c = addConnection(fd);
+    if (ring)
+    {
+        armRecv(c);
+        return;
+    }
+
+    // edge triggered: handle() drains the socket on every wakeup
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.u64 = static_cast<uint64_t>(fd);
+    ::epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev); // reports data already there
+    counters.syscalls++;
+}
+
+Shard::Connection& Shard::addConnection(int fd)
+{
+    if (opts.unixPath.empty())
+    {
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        counters.syscalls++;
+    }
+
+    if (static_cast<size_t>(fd) >= conns.size()) conns.resize(fd + 1);
+    conns[fd] = std::make_unique<Connection>();
+    conns[fd]->fd = fd;
+    conns[fd]->gen = nextGen++;
+    return *conns[fd];
+}
+
+bool Shard::overloaded(const Connection& c) const
+{
+    return c.out.size() - c.outPos > MaxPendingOut ||
+           c.slots.size() > MaxSlots;
+}
+
+void Shard::handle(Connection& c)
+{
+    for (;;)
+    {
+        process(c);
+        drainSlots(c);
+        if (!flush(c))
+        {
+            close(c);
+            return;
+        }
+
+        // lines left over when process() hit the in-flight limit
+        bool pending = c.in.find('\n', c.inPos) != std::string::npos;
+        bool done = c.closing || (c.eof && !pending);
+        if (done && c.slots.empty() && c.outPos == c.out.size())
+        {
+            close(c);
+            return;
+        }
+        if (c.closing || overloaded(c))
+        {
+            return; // resumed by EPOLLOUT or by a peer's reply
+        }
+        if (pending) continue;
+        if (c.eof || !readSome(c)) return;
+    }
+}
+
+bool Shard::readSome(Connection& c)
+{
+    size_t old = c.in.size();
+    c.in.resize(old + ReadChunk);
+
+    for (;;)
+    {
+        ssize_t n = ::read(c.fd, c.in.data() + old, ReadChunk);
+        counters.syscalls++;
+        if (n > 0)
+        {
+            c.in.resize(old + n);
+            return true;
+        }
+        if (n < 0 && errno == EINTR) continue;
+
+        c.in.resize(old);
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+        {
+            c.eof = true;
+            return true; // one more round to answer what is buffered
+        }
+        return false;
+    }
+}
+
+void Shard::process(Connection& c)
+{
+    while (!c.closing && !overloaded(c))
+    {
+        size_t nl = c.in.find('\n', c.inPos);
+        if (nl == std::string::npos)
+        {
+            if (c.in.size() - c.inPos > proto::MaxLine)
+            {
+                proto::appendError(
+                    c.slots.empty() ? c.out : newSlot(c, 1).parts[0],
+                    "request too long");
+                c.closing = true;
+            }
+            break;
+        }
+
+        std::string_view line(c.in.data() + c.inPos, nl - c.inPos);
+        proto::parseRequest(line, req);
+        counters.requests++;
+        execute(req, c);
+        c.inPos = nl + 1;
+    }
+
+    // drop consumed bytes; the tail of a partial line stays buffered
+    if (c.inPos == c.in.size())
+    {
+        c.in.clear();
+        c.inPos = 0;
+    }
+    else if (c.inPos > c.in.size() / 2)
+    {
+        c.in.erase(0, c.inPos);
+        c.inPos = 0;
+    }
+}
+
+Shard::Slot& Shard::newSlot(Connection& c, size_t parts)
+{
+    c.slots.emplace_back();
+    c.nextSeq++;
+    c.slots.back().parts.resize(parts);
+    return c.slots.back();
+}
+
+void Shard::execute(const proto::Request& r, Connection& c)
+{
+    const size_t shards = peers.size();
+
+    switch (r.op)
+    {
+    case proto::Op::Get:
+    case proto::Op::Set:
+    case proto::Op::Del:
+    {
+        std::string_view k = r.args[0];
+        std::string_view v = r.op == proto::Op::Set ? r.args[1] : "";
+        size_t owner = shards == 1 ? id : ownerOf(k, shards);
+
+        if (owner == id && log && isWrite(r.op))
+        {
+            // answered once the log sync covering it is done; later
+            // replies queue behind its slot
+            newSlot(c, 1).waiting = 1;
+
+            Message m;
+            m.kind = Message::Kind::Reply;
+            m.from = static_cast<uint32_t>(id);
+            m.fd = c.fd;
+            m.gen = c.gen;
+            m.seq = c.nextSeq - 1;
+            executeLocal(r.op, k, v, m.key);
+            hold(m);
+            break;
+        }
+        if (owner == id)
+        {
+            std::string& out =
+                c.slots.empty() ? c.out : newSlot(c, 1).parts[0];
+            executeLocal(r.op, k, v, out);
+            break;
+        }
+
+        Slot& slot = newSlot(c, 1);
+        slot.waiting = 1;
+
+        Message m;
+        m.kind = Message::Kind::Request;
+        m.op = r.op;
+        m.from = static_cast<uint32_t>(id);
+        m.fd = c.fd;
+        m.gen = c.gen;
+        m.seq = c.nextSeq - 1;
+        m.key.assign(k);
+        m.value.assign(v);
+        send(owner, m);
+        break;
+    }
+
+    case proto::Op::MGet:
+    {
+        bool local = true;
+        for (auto k : r.args)
+        {
+            local &= shards == 1 || ownerOf(k, shards) == id;
+        }
+
+        if (local && c.slots.empty())
+        {
+            proto::appendArray(c.out, r.args.size());
+            for (auto k : r.args) executeLocal(r.op, k, "", c.out);
+            break;
+        }
+
+        Slot& slot = newSlot(c, r.args.size());
+        proto::appendArray(slot.head, r.args.size());
+        for (size_t i = 0; i < r.args.size(); ++i)
+        {
+            std::string_view k = r.args[i];
+            size_t owner = shards == 1 ? id : ownerOf(k, shards);
+            if (owner == id)
+            {
+                executeLocal(r.op, k, "", slot.parts[i]);
+                continue;
+            }
+
+            slot.waiting++;
+            Message m;
+            m.kind = Message::Kind::Request;
+            m.op = r.op;
+            m.from = static_cast<uint32_t>(id);
+            m.fd = c.fd;
+            m.gen = c.gen;
+            m.seq = c.nextSeq - 1;
+            m.part = static_cast<uint32_t>(i);
+            m.key.assign(k);
+            send(owner, m);
+        }
+        break;
+    }
+
+    case proto::Op::Ping:
+        (c.slots.empty() ? c.out : newSlot(c, 1).parts[0]) += "PONG\n";
+        break;
+
+    case proto::Op::Quit:
+        c.closing = true;
+        break;
+
+    case proto::Op::Invalid:
+        proto::appendError(c.slots.empty() ? c.out : newSlot(c, 1).parts[0],
+                           r.error);
+        break;
+    }
+}
+
+void Shard::executeLocal(proto::Op op, std::string_view k, std::string_view v,
+                         std::string& out)
+{
+    if (isWrite(op) && log && log->failing())
+    {
+        // acknowledged writes must reach the log; retried every round
+        proto::appendError(out, "log unavailable, write refused");
+        return;
+    }
+
+    key.assign(k);
+    switch (op)
+    {
+    case proto::Op::Get:
+    case proto::Op::MGet:
+        proto::appendValue(out, store.find(key));
+        break;
+
+    case proto::Op::Set:
+    {
+        std::string value(v);
+        if (log) log->logInsert(key, value);
+        store.insert(key, value);
+        out += "OK\n";
+        break;
+    }
+
+    case proto::Op::Del:
+    {
+        bool removed = store.remove(key);
+        if (removed && log) log->logRemove(key);
+        out += removed ? "1\n" : "0\n";
+        break;
+    }
+
+    default:
+        proto::appendError(out, "not a key operation");
+        break;
+    }
+}
+
+void Shard::drainSlots(Connection& c)
+{
+    while (!c.slots.empty() && c.slots.front().waiting == 0)
+    {
+        Slot& s = c.slots.front();
+        c.out += s.head;
+        for (auto& p : s.parts) c.out += p;
+        c.slots.pop_front();
+    }
+}
+
+void Shard::send(size_t to, Message& m)
+{
+    if (!outbox[to].empty() || !peers[to]->inbox[id]->push(m))
+    {
+        outbox[to].push_back(std::move(m)); // keep order behind the backlog
+        return;
+    }
+    mustWake[to] = true;
+}
+
+void Shard::flushOutboxes()
+{
+    for (size_t to = 0; to < outbox.size(); ++to)
+    {
+        auto& q = outbox[to];
+        while (!q.empty() && peers[to]->inbox[id]->push(q.front()))
+        {
+            q.pop_front();
+            mustWake[to] = true;
+        }
+    }
+
+    // pairs with the fence in run(): either the peer sees our message
+    // before sleeping, or we see it asleep and poke its eventfd
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (size_t to = 0; to < mustWake.size(); ++to)
+    {
+        if (!mustWake[to]) continue;
+        mustWake[to] = false;
+        if (peers[to]->sleeping.load(std::memory_order_relaxed))
+        {
+            peers[to]->wake();
+            counters.syscalls++;
+        }
+    }
+}
+
+bool Shard::inboxEmpty() const
+{
+    for (auto& q : inbox)
+    {
+        if (!q->empty()) return false;
+    }
+    return true;
+}
+
+bool Shard::drainInbox()
+{
+    // bounded so a flood from peers cannot starve local sockets
+    size_t handled = 0;
+    for (auto& q : inbox)
+    {
+        while (handled < QueueDepth && q->pop(msg))
+        {
+            onMessage(msg);
+            handled++;
+        }
+    }
+    return handled == QueueDepth;
+}
+
+void Shard::onMessage(Message& m)
+{
+    if (m.kind == Message::Kind::Adopt)
+    {
+        adopt(m.fd);
+        return;
+    }
+    if (m.kind == Message::Kind::Request)
+    {
+        std::string reply;
+        executeLocal(m.op, m.key, m.value, reply);
+
+        m.kind = Message::Kind::Reply;
+        m.key = std::move(reply);
+        m.value.clear();
+        if (log && isWrite(m.op))
+        {
+            hold(m); // the owner's log must sync it first
+        }
+        else
+        {
+            send(m.from, m);
+        }
+        return;
+    }
+    deliver(m);
+}
+
+void Shard::hold(Message& m)
+{
+    held.emplace_back(log->logged(), std::move(m));
+}
+
+void Shard::releaseHeld()
+{
+    uint64_t durable = log->durable();
+    bool failing = log->failing();
+    while (!held.empty() && (held.front().first <= durable || failing))
+    {
+        Message& m = held.front().second;
+        if (held.front().first > durable)
+        {
+            // applied in memory, but its record may never reach the disk
+            m.key.clear();
+            proto::appendError(m.key, "log failed, write may be lost");
+        }
+
+        if (m.from == id)
+        {
+            deliver(m);
+        }
+        else
+        {
+            send(m.from, m);
+        }
+        held.pop_front();
+    }
+}
+
+void Shard::deliver(Message& m)
+{
+    if (m.fd >= static_cast<int>(conns.size())) return;
+    Connection* c = conns[m.fd].get();
+    if (!c || c->gen != m.gen || c->dead) return; // went away meanwhile
+
+    Slot& slot = c->slots[m.seq - (c->nextSeq - c->slots.size())];
+    slot.parts[m.part] = std::move(m.key);
+    slot.waiting--;
+    revisit(*c);
+}
+
+bool Shard::flush(Connection& c)
+{
+    while (c.outPos < c.out.size())
+    {
+        ssize_t n = ::send(c.fd, c.out.data() + c.outPos,
+                           c.out.size() - c.outPos, MSG_NOSIGNAL);
+        counters.syscalls++;
+        if (n > 0)
+        {
+            c.outPos += n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+
+    c.out.clear();
+    c.outPos = 0;
+    return true;
+}
+
+void Shard::close(Connection& c)
+{
+    int fd = c.fd;
+    ::epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    counters.syscalls += 2;
+    conns[fd].reset();
+}
+
+bool Shard::setupRing()
+{
+    auto r = std::make_unique<IoUring>();
+    if (!r->init(RingEntries)) return false;
+    if (!r->initBuffers(BufGroup, BufCount, BufSize)) return false;
+    ring = std::move(r);
+    return true;
+}
+
+void Shard::runUring()
+{
+    armAccept();
+    armWake();
+
+    while (!stopping.load(std::memory_order_relaxed))
+    {
+        int wait = prepareWait();
+        if (wait == 0)
+        {
+            ring->submit(0);
+        }
+        else
+        {
+            ring->submit(1, wait > 0 ? uint64_t(wait) * 1'000'000 : 0);
+        }
+        sleeping.store(false, std::memory_order_relaxed);
+
+        ring->drain([this](const io_uring_cqe& cqe) { onCompletion(cqe); });
+    }
+    counters.syscalls += ring->enters;
+}
+
+void Shard::armAccept()
+{
+    io_uring_sqe* e = ring->sqe();
+    acceptArmed = e != nullptr; // else prepareWait() tries again
+    if (!e) return;
+    e->opcode = IORING_OP_ACCEPT;
+    e->fd = listenFd;
+    e->ioprio = IORING_ACCEPT_MULTISHOT;
+    e->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    e->user_data = pack(Tag::Accept);
+}
+
+void Shard::armWake()
+{
+    io_uring_sqe* e = ring->sqe();
+    wakeArmed = e != nullptr;
+    if (!e) return;
+    e->opcode = IORING_OP_READ;
+    e->fd = wakeFd;
+    e->addr = reinterpret_cast<uint64_t>(&wakeCount);
+    e->len = sizeof(wakeCount);
+    e->user_data = pack(Tag::Wake);
+}
+
+void Shard::armRecv(Connection& c)
+{
+    io_uring_sqe* e = ring->sqe();
+    if (!e)
+    {
+        revisit(c); // pump() arms it on the next round
+        return;
+    }
+    e->opcode = IORING_OP_RECV;
+    e->fd = c.fd;
+    e->ioprio = IORING_RECV_MULTISHOT;
+    e->flags = IOSQE_BUFFER_SELECT;
+    e->buf_group = BufGroup;
+    e->user_data = pack(Tag::Recv, c.fd, c.gen);
+    c.recvArmed = true;
+}
+
+void Shard::cancelRecv(Connection& c)
+{
+    io_uring_sqe* e = ring->sqe();
+    if (!e)
+    {
+        revisit(c);
+        return;
+    }
+    e->opcode = IORING_OP_ASYNC_CANCEL;
+    e->addr = pack(Tag::Recv, c.fd, c.gen);
+    e->user_data = pack(Tag::Cancel, c.fd, c.gen);
+    c.cancelling = true;
+}
+
+void Shard::startSend(Connection& c)
+{
+    if (c.sendBusy) return;
+    if (c.sendPos < c.sending.size())
+    {
+        submitSend(c); // the ring had no room for it last round
+        return;
+    }
+    if (c.out.empty()) return;
+
+    // the kernel reads from sending while out keeps collecting replies
+    std::swap(c.out, c.sending);
+    c.out.clear();
+    c.sendPos = 0;
+    submitSend(c);
+}
+
+void Shard::submitSend(Connection& c)
+{
+    io_uring_sqe* e = ring->sqe();
+    if (!e)
+    {
+        revisit(c);
+        return;
+    }
+    e->opcode = IORING_OP_SEND;
+    e->fd = c.fd;
+    e->addr = reinterpret_cast<uint64_t>(c.sending.data() + c.sendPos);
+    e->len = static_cast<uint32_t>(c.sending.size() - c.sendPos);
+    e->msg_flags = MSG_NOSIGNAL;
+    e->user_data = pack(Tag::Send, c.fd, c.gen);
+    c.sendBusy = true;
+}
+
+void Shard::pump(Connection& c)
+{
+    if (c.dead)
+    {
+        retire(c); // a cancel the ring turned away
+        return;
+    }
+
+    bool pending = false;
+    for (;;)
+    {
+        process(c);
+        drainSlots(c);
+        pending = c.in.find('\n', c.inPos) != std::string::npos;
+        if (!pending || c.closing || overloaded(c)) break;
+    }
+    startSend(c);
+
+    bool done = c.closing || (c.eof && !pending);
+    bool sent = !c.sendBusy && c.sendPos == c.sending.size();
+    if (done && c.slots.empty() && c.out.empty() && sent)
+    {
+        retire(c);
+        return;
+    }
+
+    // flow control: stop receiving while replies pile up
+    bool wantRecv = !c.eof && !c.closing && !overloaded(c);
+    if (wantRecv && !c.recvArmed)
+    {
+        armRecv(c);
+    }
+    else if (!wantRecv && c.recvArmed && !c.cancelling)
+    {
+        cancelRecv(c);
+    }
+}
+
+void Shard::retire(Connection& c)
+{
+    c.dead = true;
+    if (c.recvArmed)
+    {
+        if (!c.cancelling) cancelRecv(c);
+        return; // finished when the recv completes
+    }
+    if (c.sendBusy) return; // the kernel still reads c.sending
+
+    int fd = c.fd;
+    ::close(fd);
+    counters.syscalls++;
+    conns[fd].reset();
+}
+
+void Shard::onCompletion(const io_uring_cqe& cqe)
+{
+    Tag tag = static_cast<Tag>(cqe.user_data >> 56);
+    bool more = cqe.flags & IORING_CQE_F_MORE;
+
+    if (tag == Tag::Accept)
+    {
+        if (cqe.res >= 0) accepted(cqe.res);
+        if (!more) armAccept();
+        return;
+    }
+    if (tag == Tag::Wake)
+    {
+        armWake();
+        return;
+    }
+    if (tag == Tag::Cancel) return;
+
+    int fd = static_cast<int32_t>(cqe.user_data & 0xffffffff);
+    uint32_t gen = static_cast<uint32_t>(cqe.user_data >> 32) & 0xffffff;
+    Connection* c = fd < static_cast<int>(conns.size()) ? conns[fd].get()
+                                                        : nullptr;
+
+    if (tag == Tag::Recv)
+    {
+        if (cqe.flags & IORING_CQE_F_BUFFER)
+        {
+            uint16_t bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+            if (c && cqe.res > 0) c->in.append(ring->buffer(bid), cqe.res);
+            ring->recycle(bid);
+        }
+        if (!c || (c->gen & 0xffffff) != gen) return;
+
+        if (!more)
+        {
+            c->recvArmed = false;
+            c->cancelling = false;
+        }
+        if (cqe.res == 0 ||
+            (cqe.res < 0 && cqe.res != -ENOBUFS && cqe.res != -ECANCELED))
+        {
+            c->eof = true;
+        }
+    }
+    else // Tag::Send
+    {
+        if (!c || (c->gen & 0xffffff) != gen) return;
+
+        c->sendBusy = false;
+        if (cqe.res < 0)
+        {
+            c->closing = true; // peer is gone; drop what is left
+            c->out.clear();
+            c->sending.clear();
+            c->sendPos = 0;
+        }
+        else
+        {
+            c->sendPos += cqe.res;
+            if (c->sendPos < c->sending.size()) submitSend(*c); // short
+        }
+    }
+
+    if (c->dead)
+    {
+        retire(*c);
+    }
+    else
+    {
+        pump(*c);
+    }
+}
@@ -0,0 +1,248 @@
+
+/*!
+ * \file    src/Shard.h
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   one event-loop thread of the ehash server and the EHash it owns.
+ *
+ * \note    shared-nothing: a key belongs to exactly one shard (ownerOf()).
+ *          accepted connections are dealt round-robin over the shards and
+ *          stay where they were dealt; requests for keys owned elsewhere
+ *          travel to the owner over a lock-free SPSC queue and the reply
+ *          travels back the same way. replies are slotted per connection
+ *          so pipelined requests still answer in order. with a log, the
+ *          owner holds a write's reply until the group sync covering its
+ *          record has returned.
+ *
+ *          socket I/O runs on io_uring (multishot accept/recv into
+ *          registered provided buffers, one batched submit per loop round)
+ *          or, where io_uring is unavailable, on edge-triggered epoll.
+ */
+
+#pragma once
+#include "EHash.h"
+#include "IoUring.h"
+#include "Protocol.h"
+#include "ShardLog.h"
+#include "SpscQueue.h"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct ServerOptions;
+
+/*!
+ * \brief   event loop + EHash shard, driven by one thread.
+ */
+class Shard
+{
+  public:
+    /*!
+     * \brief   cross-shard request, reply, or connection handoff.
+     */
+    struct Message
+    {
+        enum class Kind : uint8_t
+        {
+            Request,
+            Reply,
+            Adopt //!< take over the accepted socket fd
+        };
+
+        Kind kind = Kind::Request;
+        proto::Op op = proto::Op::Invalid;
+        uint32_t from = 0; //!< shard holding the connection
+        int fd = -1;       //!< connection on the origin shard
+        uint32_t gen = 0;  //!< connection generation (fd reuse guard)
+        uint64_t seq = 0;  //!< reply slot on the connection
+        uint32_t part = 0; //!< index inside the slot (MGET)
+        std::string key;   //!< request key, or the formatted reply
+        std::string value; //!< SET value
+    };
+
+    /*!
+     * \brief   counters reported when the server stops.
+     */
+    struct Stats
+    {
+        uint64_t requests = 0; //!< request lines received
+        uint64_t syscalls = 0; //!< system calls made by this loop
+        uint64_t walSyncs = 0;  //!< fdatasync calls on the WAL
+        uint64_t snapshots = 0; //!< background snapshots completed
+    };
+
+  private:
+    /*!
+     * \brief   reply of one request, possibly waiting on other shards.
+     */
+    struct Slot
+    {
+        std::string head;               //!< written before the parts
+        std::vector<std::string> parts; //!< one reply line per key
+        uint32_t waiting = 0;           //!< parts still owed by peers
+    };
+
+    /*!
+     * \brief   per-client state.
+     */
+    struct Connection
+    {
+        int fd = -1;
+        uint32_t gen = 0;
+        std::string in;   //!< received, not yet parsed bytes
+        size_t inPos = 0; //!< start of the first unparsed line
+        std::string out;  //!< replies ready to be written
+        size_t outPos = 0;
+        std::deque<Slot> slots; //!< replies behind a remote one
+        uint64_t nextSeq = 0;   //!< sequence number of the next slot
+        bool closing = false;   //!< QUIT seen or protocol error
+        bool eof = false;       //!< peer shut down its side
+        bool dirty = false;     //!< queued for handle() after the inbox
+
+        // io_uring backend only
+        std::string sending;     //!< buffer owned by the in-flight send
+        size_t sendPos = 0;      //!< bytes of sending already sent
+        bool sendBusy = false;   //!< a send is in flight
+        bool recvArmed = false;  //!< the multishot recv is live
+        bool cancelling = false; //!< cancel of the recv submitted
+        bool dead = false;       //!< closed, waiting for in-flight ops
+    };
+
+    const size_t id;
+    std::vector<std::unique_ptr<Shard>>& peers;
+    const ServerOptions& opts;
+    const int listenFd;
+    const int numaNode; //!< node the store is allocated on
+
+    ShardLog::Store store; //!< built in run()
+    std::unique_ptr<ShardLog> log; //!< null without a WAL directory
+
+    int epollFd = -1;
+    int wakeFd = -1;
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> sleeping{false}; //!< blocked waiting for events
+
+    std::unique_ptr<IoUring> ring; //!< null when running on epoll
+    uint64_t wakeCount = 0;        //!< target of the eventfd read
+    bool acceptArmed = false;      //!< multishot accept submitted
+    bool wakeArmed = false;        //!< eventfd read submitted
+    Stats counters;
+
+    std::vector<std::unique_ptr<SpscQueue<Message>>> inbox; //!< by sender
+    std::vector<std::deque<Message>> outbox; //!< by target, queue full
+    std::vector<bool> mustWake;              //!< by target, this round
+
+    //! write replies waiting for the log sync, with the log position
+    //! (ShardLog::logged()) they need durable, oldest first
+    std::deque<std::pair<uint64_t, Message>> held;
+
+    std::vector<std::unique_ptr<Connection>> conns; //!< indexed by fd
+    std::vector<int> dirty;                         //!< fds to revisit
+    uint32_t nextGen = 0;
+    size_t nextPeer = 0; //!< round-robin target for accepted sockets
+
+    proto::Request req; //!< reused parse target
+    std::string key;    //!< reused lookup key
+    Message msg;        //!< reused pop target
+
+    int prepareWait();
+    void serviceDirty();
+    void revisit(Connection& c);
+    void runEpoll();
+    void acceptAll();
+    void accepted(int fd);
+    void adopt(int fd);
+    Connection& addConnection(int fd);
+    void handle(Connection& c);
+    bool readSome(Connection& c);
+    void process(Connection& c);
+    void execute(const proto::Request& r, Connection& c);
+    void executeLocal(proto::Op op, std::string_view k, std::string_view v,
+                      std::string& out);
+    Slot& newSlot(Connection& c, size_t parts);
+    void drainSlots(Connection& c);
+    bool overloaded(const Connection& c) const;
+    bool flush(Connection& c);
+    void close(Connection& c);
+
+    bool setupRing();
+    void runUring();
+    void onCompletion(const io_uring_cqe& cqe);
+    void pump(Connection& c);
+    void armAccept();
+    void armWake();
+    void armRecv(Connection& c);
+    void cancelRecv(Connection& c);
+    void startSend(Connection& c);
+    void submitSend(Connection& c);
+    void retire(Connection& c);
+
+    void send(size_t to, Message& m);
+    bool drainInbox();
+    void onMessage(Message& m);
+    void deliver(Message& m);
+    void hold(Message& m);
+    void releaseHeld();
+    void flushOutboxes();
+    bool inboxEmpty() const;
+
+  public:
+    Shard(size_t id, std::vector<std::unique_ptr<Shard>>& peers,
+          const ServerOptions& opts, int listenFd, int numaNode = 0);
+    ~Shard();
+
+    Shard(const Shard&) = delete;
+    Shard& operator=(const Shard&) = delete;
+
+    /*!
+     * \brief   shard owning a key; the same on every thread.
+     */
+    static size_t ownerOf(std::string_view key, size_t shards);
+
+    /*!
+     * \brief   create epoll/eventfd, the inbound queues, and open the log.
+     *
+     * \note    every shard must be constructed before any is started.
+     */
+    bool start();
+
+    /*!
+     * \brief   recover from the log, then run the event loop until stop().
+     *
+     * \note    the io_uring instance is created here, on the loop's own
+     *          thread, since rings are set up single-issuer.
+     */
+    void run();
+
+    /*!
+     * \brief   true once run() picked io_uring.
+     */
+    bool usesUring() const { return ring != nullptr; }
+
+    /*!
+     * \brief   NUMA node holding this shard's data.
+     */
+    int node() const { return numaNode; }
+
+    /*!
+     * \brief   counters; read after run() returned.
+     */
+    const Stats& stats() const { return counters; }
+
+    /*!
+     * \brief   ask run() to return; async-signal-safe.
+     */
+    void stop();
+
+    /*!
+     * \brief   interrupt epoll_wait; async-signal-safe.
+     */
+    void wake();
+};
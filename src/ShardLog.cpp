@@ -0,0 +1,237 @@
+
+/*!
+ * \file    src/ShardLog.cpp
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   log segments, snapshot scheduling and recovery of a shard.
+ */
+
+#include "ShardLog.h"
+#include "Server.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <dirent.h>
+
+namespace
+{
+constexpr uint64_t PollNs = 10'000'000; //!< snapshot child check interval
+
+uint64_t nowNs()
+{
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+} // namespace
+
+ShardLog::ShardLog(const ServerOptions& opts, size_t shard)
+    : opts(opts), shard(shard)
+{
+}
+
+ShardLog::~ShardLog()
+{
+    if (wal) close();
+}
+
+std::string ShardLog::segmentPath(uint64_t n) const
+{
+    return opts.walDir + "/shard-" + std::to_string(shard) + "." +
+           std::to_string(n) + ".wal";
+}
+
+std::string ShardLog::snapPath() const
+{
+    return opts.walDir + "/shard-" + std::to_string(shard) + ".snap";
+}
+
+bool ShardLog::open()
+{
+    DIR* dir = ::opendir(opts.walDir.c_str());
+    if (!dir) return false;
+
+    while (dirent* e = ::readdir(dir))
+    {
+        size_t id = 0;
+        unsigned long long n = 0;
+        int end = 0;
+        if (std::sscanf(e->d_name, "shard-%zu.%llu.wal%n", &id, &n, &end) ==
+                2 &&
+            e->d_name[end] == '\0' && id == shard)
+        {
+            older.push_back(n);
+        }
+    }
+    ::closedir(dir);
+    std::sort(older.begin(), older.end());
+
+    ::unlink((snapPath() + ".tmp").c_str()); // from a crashed snapshot
+    return openSegment(older.empty() ? 1 : older.back() + 1);
+}
+
+bool ShardLog::openSegment(uint64_t n)
+{
+    auto next = std::make_unique<EHashWal<std::string, std::string>>(
+        ehash::WalOptions{opts.walSyncUs, opts.walSyncBytes});
+    if (!next->open(segmentPath(n))) return false;
+
+    retire();
+    wal = std::move(next);
+    segment = n;
+    return true;
+}
+
+void ShardLog::retire()
+{
+    if (!wal) return;
+    if (!wal->sync())
+    {
+        std::perror("ehash: wal sync");
+        failed = true;
+    }
+    else
+    {
+        synced = base + wal->durable();
+    }
+    base += wal->stats.records;
+    counters.syncs += wal->stats.syncs;
+    counters.syscalls += wal->stats.writes + wal->stats.syncs;
+    wal.reset();
+}
+
+bool ShardLog::recover(Store& store)
+{
+    uint64_t tag = 0;
+    if (!ehash::loadSnapshot(snapPath(), store, tag))
+    {
+        std::fprintf(stderr, "ehash: %s is damaged\n", snapPath().c_str());
+        return false;
+    }
+    size_t fromSnapshot = store.size();
+    oldest = segment;
+
+    size_t records = 0;
+    size_t torn = 0;
+    for (uint64_t n : older)
+    {
+        if (n < tag)
+        {
+            ::unlink(segmentPath(n).c_str()); // snapshot done, delete was not
+            continue;
+        }
+
+        EHashWal<std::string, std::string> log;
+        ehash::WalReplay r;
+        r.ok = log.open(segmentPath(n));
+        if (r.ok) r = log.replay(store);
+        if (!r.ok)
+        {
+            std::perror(("ehash: " + segmentPath(n)).c_str());
+            return false;
+        }
+        if (r.bytes == 0)
+        {
+            ::unlink(segmentPath(n).c_str()); // a restart without writes
+            continue;
+        }
+        oldest = std::min(oldest, n);
+        records += r.records;
+        torn += r.tornBytes;
+    }
+
+    if (fromSnapshot || records || torn)
+    {
+        std::fprintf(stderr,
+                     "ehash: shard %zu recovered %zu keys (%zu from the "
+                     "snapshot, %zu log records, %zu torn bytes dropped)\n",
+                     shard, store.size(), fromSnapshot, records, torn);
+    }
+
+    // fold what was replayed into a fresh snapshot right away, so
+    // restarts do not pile up segments
+    if (records && opts.snapshotBytes) startSnapshot(store);
+    return true;
+}
+
+void ShardLog::commit(const Store& store)
+{
+    if (!wal->commit())
+    {
+        if (!failed) std::perror("ehash: wal write or sync");
+        failed = true;
+    }
+    else
+    {
+        failed = false;
+        synced = base + wal->durable();
+    }
+
+    if (snapPid > 0)
+    {
+        finishSnapshot(false);
+    }
+    else if (opts.snapshotBytes && wal->stats.bytes >= opts.snapshotBytes)
+    {
+        startSnapshot(store);
+    }
+}
+
+int ShardLog::dueMs() const
+{
+    // wake up in time for the next group sync even if nothing arrives
+    int64_t us = wal->syncDueUs();
+    return us < 0 ? -1 : static_cast<int>((us + 999) / 1000);
+}
+
+void ShardLog::startSnapshot(const Store& store)
+{
+    // everything logged so far is in the store the child will see
+    if (!openSegment(segment + 1))
+    {
+        std::perror("ehash: wal segment");
+        return;
+    }
+
+    snapTag = segment;
+    snapPid = ehash::snapshotInBackground(store, snapPath(), snapTag);
+    counters.syscalls++;
+    if (snapPid < 0) std::perror("ehash: snapshot fork");
+    nextPoll = nowNs() + PollNs;
+}
+
+void ShardLog::finishSnapshot(bool wait)
+{
+    if (!wait && nowNs() < nextPoll) return;
+    nextPoll = nowNs() + PollNs;
+
+    counters.syscalls++;
+    ehash::SnapshotStatus st = ehash::snapshotStatus(snapPid, wait);
+    if (st == ehash::SnapshotStatus::Running) return;
+    snapPid = -1;
+
+    if (st == ehash::SnapshotStatus::Failed)
+    {
+        std::fprintf(stderr, "ehash: shard %zu snapshot failed, log kept\n",
+                     shard);
+        return;
+    }
+
+    // log compaction: the snapshot holds everything before snapTag
+    for (uint64_t n = oldest; n < snapTag; ++n)
+    {
+        ::unlink(segmentPath(n).c_str());
+    }
+    oldest = snapTag;
+    counters.snapshots++;
+}
+
+void ShardLog::close()
+{
+    if (snapPid > 0) finishSnapshot(true);
+    retire();
+}
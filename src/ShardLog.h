@@ -0,0 +1,137 @@
+
+/*!
+ * \file    src/ShardLog.h
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   durability of one shard: write-ahead log segments + snapshots.
+ *
+ * \note    files in the WAL directory, per shard i:
+ *
+ *            shard-<i>.<n>.wal   log segment n (EHashWal), n ascending
+ *            shard-<i>.snap      snapshot, tagged with the first segment
+ *                                it does not cover
+ *
+ *          once the live segment has grown past snapshotBytes the log
+ *          moves on to segment n+1 and a forked child writes the shard
+ *          (copy-on-write, see EHashSnapshot.h) tagged n+1. when the child
+ *          succeeds, segments below n+1 are deleted. recovery loads the
+ *          snapshot and replays the segments from its tag on; what a crash
+ *          left behind (segments below the tag, a .tmp snapshot) is
+ *          removed.
+ */
+
+#pragma once
+#include "EHashSnapshot.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+struct ServerOptions;
+
+/*!
+ * \brief   WAL segments and background snapshots of one shard's EHash.
+ */
+class ShardLog
+{
+  public:
+    //! Flat: a looked-up value is copied out before the next write
+    using Store = EHash<std::string, std::string, ehash::Flat>;
+
+    /*!
+     * \brief   counters reported when the server stops.
+     */
+    struct Stats
+    {
+        uint64_t syncs = 0;     //!< fdatasync calls
+        uint64_t syscalls = 0;  //!< log writes and syncs
+        uint64_t snapshots = 0; //!< background snapshots completed
+    };
+
+  private:
+    const ServerOptions& opts;
+    const size_t shard;
+
+    std::unique_ptr<EHashWal<std::string, std::string>> wal; //!< live segment
+    uint64_t segment = 0;        //!< number of the live segment
+    uint64_t base = 0;           //!< records of the retired segments
+    uint64_t synced = 0;         //!< records made durable, all segments
+    std::vector<uint64_t> older; //!< segments found by open()
+    uint64_t oldest = 0;         //!< lowest segment that may be on disk
+    pid_t snapPid = -1;          //!< running snapshot child
+    uint64_t snapTag = 0;        //!< first segment it does not cover
+    uint64_t nextPoll = 0;       //!< ns; when to check on the child again
+    bool failed = false;         //!< last write or sync failed
+    Stats counters;
+
+    std::string segmentPath(uint64_t n) const;
+    std::string snapPath() const;
+    bool openSegment(uint64_t n);
+    void retire();
+    void startSnapshot(const Store& store);
+    void finishSnapshot(bool wait);
+
+  public:
+    ShardLog(const ServerOptions& opts, size_t shard);
+    ~ShardLog();
+
+    ShardLog(const ShardLog&) = delete;
+    ShardLog& operator=(const ShardLog&) = delete;
+
+    /*!
+     * \brief   find this shard's files and open a fresh live segment.
+     */
+    bool open();
+
+    /*!
+     * \brief   load the snapshot, then replay the segments it misses.
+     *
+     * \return  false (after printing the reason) if a file is unreadable.
+     */
+    bool recover(Store& store);
+
+    void logInsert(const std::string& key, const std::string& value)
+    {
+        wal->logInsert(key, value);
+    }
+
+    void logRemove(const std::string& key) { wal->logRemove(key); }
+
+    /*!
+     * \brief   true while the log cannot be written or synced; the shard
+     *          refuses writes until a commit() gets through again.
+     */
+    bool failing() const { return failed; }
+
+    /*!
+     * \brief   end of a loop round: write the round's records, group sync,
+     *          start or reap a background snapshot.
+     */
+    void commit(const Store& store);
+
+    /*!
+     * \brief   ms until a sync is due (the loop must wake by then), or -1.
+     */
+    int dueMs() const;
+
+    /*!
+     * \brief   records logged so far, counted over all segments; a write
+     *          is durable once durable() reaches the count after it.
+     */
+    uint64_t logged() const { return base + wal->stats.records; }
+
+    /*!
+     * \brief   records a sync has made durable.
+     */
+    uint64_t durable() const { return synced; }
+
+    /*!
+     * \brief   wait for a running snapshot and sync everything.
+     */
+    void close();
+
+    const Stats& stats() const { return counters; }
+};
@@ -0,0 +1,92 @@
+
+/*!
+ * \file    src/SpscQueue.h
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   bounded lock-free single-producer single-consumer ring.
+ */
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+
+/*!
+ * \brief   fixed-capacity SPSC queue.
+ *
+ * \tparam  T element type (moved in and out).
+ *
+ * \note    exactly one thread may push and exactly one may pop. head and
+ *          tail live on separate cache lines, and each side caches the
+ *          other side's index so the shared line is only read when the
+ *          queue looks full (producer) or empty (consumer).
+ */
+template<typename T> class SpscQueue
+{
+    static constexpr size_t Line = 64;
+
+    std::unique_ptr<T[]> slots;
+    size_t mask;
+
+    alignas(Line) std::atomic<size_t> head{0}; //!< next slot to pop
+    size_t cachedTail = 0;                     //!< consumer's view of tail
+
+    alignas(Line) std::atomic<size_t> tail{0}; //!< next slot to push
+    size_t cachedHead = 0;                     //!< producer's view of head
+
+  public:
+    /*!
+     * \param   capacity rounded up to a power of two.
+     */
+    explicit SpscQueue(size_t capacity)
+    {
+        size_t n = 1;
+        while (n < capacity) n <<= 1;
+        slots = std::make_unique<T[]>(n);
+        mask = n - 1;
+    }
+
+    /*!
+     * \brief   producer side; false when full (item is left untouched).
+     */
+    bool push(T& item)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cachedHead > mask)
+        {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t - cachedHead > mask) return false;
+        }
+        slots[t & mask] = std::move(item);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /*!
+     * \brief   consumer side; false when empty.
+     */
+    bool pop(T& item)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == cachedTail)
+        {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h == cachedTail) return false;
+        }
+        item = std::move(slots[h & mask]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    /*!
+     * \brief   consumer side emptiness check.
+     */
+    bool empty() const
+    {
+        return head.load(std::memory_order_relaxed) ==
+               tail.load(std::memory_order_acquire);
+    }
+};
@@ -0,0 +1,665 @@
+
+/*!
+ * \file    src/loadgen.cpp
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   load generator for the ehash server (loopback / unix only).
+ *
+ * \note    closed loop: every connection keeps `depth` requests in flight
+ *          and sends the next one as soon as a reply comes back; latency
+ *          runs from the actual send.
+ *
+ *          open loop: requests are due at a fixed total arrival rate,
+ *          spread evenly over the connections. a request that cannot go
+ *          out on time (its connection already has `depth` in flight) is
+ *          sent late but timed from when it was due, so server stalls show
+ *          up in the tail instead of being hidden by the generator backing
+ *          off (coordinated omission).
+ */
+
+#include "EHashBatch.h"
+#include "Histogram.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <barrier>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <random>
+#include <string>
+#include <string_view>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+constexpr uint64_t Never = ~uint64_t(0);
+constexpr size_t PrefillDepth = 64; //!< SETs in flight per connection
+
+uint64_t nowNs()
+{
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+/*!
+ * \brief   load generator configuration.
+ */
+struct Options
+{
+    std::string unixPath;     //!< connect to this unix socket when set
+    uint16_t port = 7379;     //!< otherwise to 127.0.0.1:port
+    size_t connections = 16;  //!< sockets, spread over the threads
+    size_t threads = 1;       //!< generator threads
+    size_t depth = 1;         //!< requests in flight per connection
+    double duration = 10;     //!< measured seconds
+    double warmup = 1;        //!< unmeasured seconds before that
+    double getRatio = 0.9;    //!< share of GETs, the rest are SETs
+    uint64_t keys = 100'000;  //!< key space
+    double theta = 0.99;      //!< zipf skew; 0 = uniform
+    size_t valueSize = 32;    //!< SET value bytes
+    double rate = 0;          //!< open loop requests/s; 0 = closed loop
+    bool prefill = false;     //!< SET every key before the run
+    uint64_t seed = 1;
+};
+
+/*!
+ * \brief   zipfian ranks in [0, n), rank 0 the most popular.
+ *
+ * \note    Gray et al., "Quickly generating billion-record synthetic
+ *          databases" (the YCSB generator): O(n) setup, O(1) per draw.
+ */
+class Zipfian
+{
+    uint64_t n;
+    double theta;
+    double alpha;
+    double zetan;
+    double eta;
+    double half; //!< 1 + 0.5^theta
+
+    static double zeta(uint64_t n, double theta)
+    {
+        double sum = 0;
+        for (uint64_t i = 1; i <= n; ++i) sum += 1.0 / std::pow(double(i), theta);
+        return sum;
+    }
+
+  public:
+    Zipfian(uint64_t n, double theta)
+        : n(n), theta(theta), alpha(1.0 / (1.0 - theta)), zetan(zeta(n, theta))
+    {
+        double zeta2 = zeta(2, theta);
+        eta = (1.0 - std::pow(2.0 / double(n), 1.0 - theta)) /
+              (1.0 - zeta2 / zetan);
+        half = 1.0 + std::pow(0.5, theta);
+    }
+
+    /*!
+     * \brief   rank for a uniform u in [0, 1).
+     */
+    uint64_t operator()(double u) const
+    {
+        double uz = u * zetan;
+        if (uz < 1.0) return 0;
+        if (uz < half) return 1;
+        auto r = static_cast<uint64_t>(double(n) *
+                                       std::pow(eta * u - eta + 1.0, alpha));
+        return std::min(r, n - 1);
+    }
+};
+
+/*!
+ * \brief   one generator socket.
+ */
+struct Conn
+{
+    int fd = -1;
+    std::string in;  //!< received, not yet parsed bytes
+    std::string out; //!< requests not yet written
+    size_t outPos = 0;
+    std::deque<uint64_t> stamps; //!< latency origin of each request in flight
+    uint64_t next = 0;           //!< open loop: when the next request is due
+    bool wantWrite = false;      //!< EPOLLOUT armed
+};
+
+/*!
+ * \brief   counters of one generator thread.
+ */
+struct Result
+{
+    Histogram latency;       //!< ns, measured requests only
+    uint64_t errors = 0;     //!< unexpected replies and lost connections
+    uint64_t unfinished = 0; //!< still in flight when the run ended
+    uint64_t late = 0;       //!< open loop: sent after they were due
+};
+
+/*!
+ * \brief   generator thread: its connections, epoll set and counters.
+ */
+class Worker
+{
+    const Options& opts;
+    const Zipfian& zipf;
+    std::vector<Conn> conns;
+    int epollFd = -1;
+    std::mt19937_64 rng;
+    std::string value;
+    uint64_t measureFrom = Never; //!< requests stamped earlier are not timed
+
+    double uniform() { return double(rng() >> 11) * 0x1.0p-53; }
+
+    static void appendKey(std::string& out, uint64_t rank)
+    {
+        // scatter hot ranks over the key space, and so over the shards
+        char buf[24];
+        int n = std::snprintf(buf, sizeof buf, "k%016llx",
+                              static_cast<unsigned long long>(ehash::mix64(rank)));
+        out.append(buf, size_t(n));
+    }
+
+    void appendSet(Conn& c, uint64_t rank)
+    {
+        c.out += "SET ";
+        appendKey(c.out, rank);
+        c.out += ' ';
+        c.out += value;
+        c.out += '\n';
+    }
+
+    void issue(Conn& c, uint64_t stamp)
+    {
+        bool get = uniform() < opts.getRatio;
+        uint64_t rank = zipf(uniform());
+        if (get)
+        {
+            c.out += "GET ";
+            appendKey(c.out, rank);
+            c.out += '\n';
+        }
+        else
+        {
+            appendSet(c, rank);
+        }
+        c.stamps.push_back(stamp);
+    }
+
+    void watch(Conn& c, bool write)
+    {
+        epoll_event ev{};
+        ev.events = EPOLLIN | (write ? uint32_t(EPOLLOUT) : 0u);
+        ev.data.u32 = static_cast<uint32_t>(&c - conns.data());
+        ::epoll_ctl(epollFd, EPOLL_CTL_MOD, c.fd, &ev);
+        c.wantWrite = write;
+    }
+
+    void lose(Conn& c)
+    {
+        std::fprintf(stderr, "loadgen: connection closed by the server\n");
+        ::epoll_ctl(epollFd, EPOLL_CTL_DEL, c.fd, nullptr);
+        ::close(c.fd);
+        c.fd = -1;
+        result.errors += c.stamps.size() + 1;
+        c.stamps.clear();
+    }
+
+    void flush(Conn& c)
+    {
+        while (c.outPos < c.out.size())
+        {
+            ssize_t n = ::send(c.fd, c.out.data() + c.outPos,
+                               c.out.size() - c.outPos, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && errno == EAGAIN)
+            {
+                if (!c.wantWrite) watch(c, true);
+                return;
+            }
+            if (n < 0) return lose(c);
+            c.outPos += size_t(n);
+        }
+        c.out.clear();
+        c.outPos = 0;
+        if (c.wantWrite) watch(c, false);
+    }
+
+    void receive(Conn& c, uint64_t now)
+    {
+        char buf[64 * 1024];
+        for (;;)
+        {
+            ssize_t n = ::recv(c.fd, buf, sizeof buf, 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && errno == EAGAIN) break;
+            if (n <= 0) return lose(c);
+            c.in.append(buf, size_t(n));
+        }
+
+        // every GET / SET reply is exactly one line
+        size_t pos = 0;
+        for (size_t nl; (nl = c.in.find('\n', pos)) != std::string::npos;
+             pos = nl + 1)
+        {
+            std::string_view line(c.in.data() + pos, nl - pos);
+            bool ok = line.starts_with("VALUE ") || line == "NIL" ||
+                      line == "OK";
+            if (!ok || c.stamps.empty())
+            {
+                result.errors++;
+                if (c.stamps.empty()) continue;
+            }
+
+            uint64_t stamp = c.stamps.front();
+            c.stamps.pop_front();
+            if (stamp >= measureFrom) result.latency.record(now - stamp);
+        }
+        c.in.erase(0, pos);
+    }
+
+    /*!
+     * \brief   wait for socket events until deadline (ns, absolute).
+     */
+    void poll(uint64_t deadline)
+    {
+        epoll_event events[64];
+        uint64_t now = nowNs();
+        uint64_t wait = deadline > now ? deadline - now : 0;
+
+        timespec ts{static_cast<time_t>(wait / 1'000'000'000),
+                    static_cast<long>(wait % 1'000'000'000)};
+        int n = ::epoll_pwait2(epollFd, events, 64, &ts, nullptr);
+        if (n < 0 && errno == ENOSYS) // pre-5.11 kernel: ms resolution
+        {
+            int ms = static_cast<int>((wait + 999'999) / 1'000'000);
+            n = ::epoll_wait(epollFd, events, 64, ms);
+        }
+
+        now = nowNs();
+        for (int i = 0; i < n; ++i)
+        {
+            Conn& c = conns[events[i].data.u32];
+            if (c.fd < 0) continue;
+            if (events[i].events & EPOLLOUT) flush(c);
+            if (c.fd >= 0 && (events[i].events & ~EPOLLOUT)) receive(c, now);
+        }
+    }
+
+    size_t inFlight() const
+    {
+        size_t n = 0;
+        for (const Conn& c : conns) n += c.stamps.size();
+        return n;
+    }
+
+  public:
+    Result result;
+
+    Worker(const Options& opts, const Zipfian& zipf, uint64_t seed)
+        : opts(opts), zipf(zipf), rng(seed), value(opts.valueSize, 'v')
+    {
+    }
+
+    ~Worker()
+    {
+        for (Conn& c : conns)
+            if (c.fd >= 0) ::close(c.fd);
+        if (epollFd >= 0) ::close(epollFd);
+    }
+
+    Worker(const Worker&) = delete;
+    Worker& operator=(const Worker&) = delete;
+
+    /*!
+     * \brief   open n connections to the server.
+     *
+     * \return  false (after printing the reason) on failure.
+     */
+    bool connect(size_t n)
+    {
+        epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+        if (epollFd < 0)
+        {
+            std::perror("epoll_create1");
+            return false;
+        }
+
+        conns.resize(n);
+        for (Conn& c : conns)
+        {
+            bool local = !opts.unixPath.empty();
+            c.fd = ::socket(local ? AF_UNIX : AF_INET,
+                            SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (c.fd < 0)
+            {
+                std::perror("socket");
+                return false;
+            }
+
+            int rc;
+            if (local)
+            {
+                sockaddr_un addr{};
+                addr.sun_family = AF_UNIX;
+                std::strncpy(addr.sun_path, opts.unixPath.c_str(),
+                             sizeof addr.sun_path - 1);
+                rc = ::connect(c.fd, reinterpret_cast<sockaddr*>(&addr),
+                               sizeof addr);
+            }
+            else
+            {
+                sockaddr_in addr{};
+                addr.sin_family = AF_INET;
+                addr.sin_port = htons(opts.port);
+                addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                rc = ::connect(c.fd, reinterpret_cast<sockaddr*>(&addr),
+                               sizeof addr);
+                int one = 1;
+                ::setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+            }
+            if (rc < 0)
+            {
+                std::perror("connect");
+                return false;
+            }
+
+            int one = 1;
+            ::ioctl(c.fd, FIONBIO, &one);
+
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.u32 = static_cast<uint32_t>(&c - conns.data());
+            ::epoll_ctl(epollFd, EPOLL_CTL_ADD, c.fd, &ev);
+        }
+        return true;
+    }
+
+    /*!
+     * \brief   SET the keys of ranks [from, to), untimed.
+     */
+    void prefill(uint64_t from, uint64_t to)
+    {
+        measureFrom = Never;
+        uint64_t rank = from;
+        while (rank < to || inFlight())
+        {
+            for (Conn& c : conns)
+            {
+                if (c.fd < 0) continue;
+                while (rank < to && c.stamps.size() < PrefillDepth)
+                {
+                    appendSet(c, rank++);
+                    c.stamps.push_back(0);
+                }
+                if (c.outPos < c.out.size()) flush(c);
+            }
+            if (std::none_of(conns.begin(), conns.end(),
+                             [](const Conn& c) { return c.fd >= 0; }))
+            {
+                return;
+            }
+            poll(nowNs() + 100'000'000);
+        }
+    }
+
+    /*!
+     * \brief   generate load from start until end, timing requests issued
+     *          from measure on.
+     *
+     * \param   interval open loop: ns between requests on one connection;
+     *                   0 runs closed loop
+     */
+    void run(uint64_t start, uint64_t measure, uint64_t end, uint64_t interval)
+    {
+        measureFrom = measure;
+        for (size_t i = 0; i < conns.size(); ++i)
+        {
+            // stagger the connections so arrivals do not come in bursts
+            conns[i].next = start + interval * i / conns.size();
+        }
+
+        for (uint64_t now = nowNs(); now < end; now = nowNs())
+        {
+            uint64_t wake = end;
+            for (Conn& c : conns)
+            {
+                if (c.fd < 0) continue;
+                if (interval == 0)
+                {
+                    while (c.stamps.size() < opts.depth) issue(c, now);
+                }
+                else
+                {
+                    while (c.next <= now && c.stamps.size() < opts.depth)
+                    {
+                        // timed from when it was due, not from now
+                        if (now - c.next > interval) result.late++;
+                        issue(c, c.next);
+                        c.next += interval;
+                    }
+                    // window full: the next reply wakes us instead
+                    if (c.stamps.size() < opts.depth)
+                    {
+                        wake = std::min(wake, c.next);
+                    }
+                }
+                if (c.outPos < c.out.size()) flush(c);
+            }
+            poll(wake);
+        }
+
+        for (Conn& c : conns)
+        {
+            for (uint64_t stamp : c.stamps)
+                if (stamp >= measureFrom) result.unfinished++;
+        }
+    }
+};
+
+void usage(const char* argv0)
+{
+    std::fprintf(
+        stderr,
+        "usage: %s [--unix PATH | --port N] [--connections N] [--threads N]\n"
+        "          [--depth N] [--duration S] [--warmup S] [--get RATIO]\n"
+        "          [--keys N] [--zipf THETA] [--value N] [--rate R]\n"
+        "          [--prefill] [--seed N]\n"
+        "  --unix PATH       connect to a unix-domain socket\n"
+        "  --port N          connect to 127.0.0.1:N (default 7379)\n"
+        "  --connections N   sockets in total (default 16)\n"
+        "  --threads N       generator threads (default 1)\n"
+        "  --depth N         pipelined requests per connection (default 1)\n"
+        "  --duration S      measured seconds (default 10)\n"
+        "  --warmup S        unmeasured seconds first (default 1)\n"
+        "  --get RATIO       share of GETs, rest SETs (default 0.9)\n"
+        "  --keys N          key space (default 100000)\n"
+        "  --zipf THETA      key skew in [0, 1), 0 = uniform (default 0.99)\n"
+        "  --value N         SET value bytes (default 32)\n"
+        "  --rate R          open loop at R requests/s in total;\n"
+        "                    omitted = closed loop\n"
+        "  --prefill         SET every key before the run\n"
+        "  --seed N          random seed (default 1)\n",
+        argv0);
+}
+
+bool parse(int argc, char** argv, Options& opts)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (!std::strcmp(arg, "--unix") && hasValue)
+        {
+            opts.unixPath = argv[++i];
+        }
+        else if (!std::strcmp(arg, "--port") && hasValue)
+        {
+            opts.port = static_cast<uint16_t>(std::atoi(argv[++i]));
+        }
+        else if (!std::strcmp(arg, "--connections") && hasValue)
+        {
+            opts.connections = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (!std::strcmp(arg, "--threads") && hasValue)
+        {
+            opts.threads = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (!std::strcmp(arg, "--depth") && hasValue)
+        {
+            opts.depth = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (!std::strcmp(arg, "--duration") && hasValue)
+        {
+            opts.duration = std::atof(argv[++i]);
+        }
+        else if (!std::strcmp(arg, "--warmup") && hasValue)
+        {
+            opts.warmup = std::atof(argv[++i]);
+        }
+        else if (!std::strcmp(arg, "--get") && hasValue)
+        {
+            opts.getRatio = std::atof(argv[++i]);
+        }
+        else if (!std::strcmp(arg, "--keys") && hasValue)
+        {
+            opts.keys = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (!std::strcmp(arg, "--zipf") && hasValue)
+        {
+            opts.theta = std::atof(argv[++i]);
+        }
+        else if (!std::strcmp(arg, "--value") && hasValue)
+        {
+            opts.valueSize = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (!std::strcmp(arg, "--rate") && hasValue)
+        {
+            opts.rate = std::atof(argv[++i]);
+        }
+        else if (!std::strcmp(arg, "--prefill"))
+        {
+            opts.prefill = true;
+        }
+        else if (!std::strcmp(arg, "--seed") && hasValue)
+        {
+            opts.seed = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return opts.threads >= 1 && opts.connections >= opts.threads &&
+           opts.depth >= 1 && opts.duration > 0 && opts.warmup >= 0 &&
+           opts.getRatio >= 0 && opts.getRatio <= 1 && opts.keys >= 2 &&
+           opts.theta >= 0 && opts.theta < 1 && opts.valueSize >= 1 &&
+           opts.rate >= 0;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options opts;
+    if (!parse(argc, argv, opts))
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    Zipfian zipf(opts.keys, opts.theta);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (size_t t = 0; t < opts.threads; ++t)
+    {
+        size_t n = opts.connections / opts.threads +
+                   (t < opts.connections % opts.threads);
+        workers.push_back(std::make_unique<Worker>(opts, zipf, opts.seed + t));
+        if (!workers.back()->connect(n)) return EXIT_FAILURE;
+    }
+
+    // per connection gap between arrivals
+    uint64_t interval = 0;
+    if (opts.rate > 0)
+    {
+        interval = static_cast<uint64_t>(1e9 * double(opts.connections) /
+                                         opts.rate);
+        interval = std::max<uint64_t>(interval, 1);
+    }
+
+    uint64_t start = 0;
+    auto warmupNs = static_cast<uint64_t>(opts.warmup * 1e9);
+    auto durationNs = static_cast<uint64_t>(opts.duration * 1e9);
+    std::barrier sync(static_cast<std::ptrdiff_t>(opts.threads),
+                      [&]() noexcept { start = nowNs(); });
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < opts.threads; ++t)
+    {
+        threads.emplace_back([&, t] {
+            Worker& w = *workers[t];
+            if (opts.prefill)
+            {
+                w.prefill(opts.keys * t / opts.threads,
+                          opts.keys * (t + 1) / opts.threads);
+            }
+            sync.arrive_and_wait();
+            w.run(start, start + warmupNs, start + warmupNs + durationNs,
+                  interval);
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    Result total;
+    for (auto& w : workers)
+    {
+        total.latency.merge(w->result.latency);
+        total.errors += w->result.errors;
+        total.unfinished += w->result.unfinished;
+        total.late += w->result.late;
+    }
+
+    const Histogram& h = total.latency;
+    std::printf("%s loop, %zu connections x depth %zu, %zu threads, "
+                "%.0f%% GET, zipf %.2f over %llu keys\n",
+                interval ? "open" : "closed", opts.connections, opts.depth,
+                opts.threads, opts.getRatio * 100, opts.theta,
+                static_cast<unsigned long long>(opts.keys));
+    if (interval)
+    {
+        std::printf("target %.0f req/s, %llu requests sent late "
+                    "(timed from when they were due)\n",
+                    opts.rate, static_cast<unsigned long long>(total.late));
+    }
+    std::printf("%llu requests in %.2fs: %.0f req/s, %llu errors, "
+                "%llu unfinished\n",
+                static_cast<unsigned long long>(h.count()), opts.duration,
+                double(h.count()) / opts.duration,
+                static_cast<unsigned long long>(total.errors),
+                static_cast<unsigned long long>(total.unfinished));
+    std::printf("latency us: min %.1f  p50 %.1f  p90 %.1f  p99 %.1f  "
+                "p99.9 %.1f  p99.99 %.1f  max %.1f  mean %.1f\n\n",
+                h.min() / 1e3, h.percentile(50) / 1e3, h.percentile(90) / 1e3,
+                h.percentile(99) / 1e3, h.percentile(99.9) / 1e3,
+                h.percentile(99.99) / 1e3, h.max() / 1e3, h.mean() / 1e3);
+    h.print(stdout, 1e3);
+
+    return total.errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
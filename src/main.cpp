@@ -4,13 +4,145 @@
  * \author  elijw
  * \license MIT
  *
- * \brief   unused
+ * \brief   ehash key-value server entry point.
  */
 
-#define EXIT_SUCCESS  0
-#define EXIT_FAILUIRE 1
+#include "EHashNuma.h"
+#include "Server.h"
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace
+{
+Server* running = nullptr; //!< target of the signal handler
+
+void onSignal(int) { running->stop(); }
+
+void usage(const char* argv0)
+{
+    std::fprintf(stderr,
+                 "usage: %s [--unix PATH | --port N] [--buckets N]\n"
+                 "          [--threads N] [--no-pin] [--io auto|epoll|uring]\n"
+                 "          [--numa-nodes LIST | --no-numa]\n"
+                 "          [--wal DIR] [--wal-sync-us N] [--wal-sync-bytes N]\n"
+                 "          [--snapshot-bytes N]\n"
+                 "  --unix PATH         listen on a unix-domain socket\n"
+                 "  --port N            listen on 127.0.0.1:N (default 7379)\n"
+                 "  --buckets N         initial hash table buckets per shard\n"
+                 "  --threads N         event loops / shards (default: cores)\n"
+                 "  --no-pin            do not pin event loops to cores\n"
+                 "  --numa-nodes LIST   put shard i on node LIST[i %% len],\n"
+                 "                      e.g. 0,1 or 0-3 (default: the node of\n"
+                 "                      its core)\n"
+                 "  --no-numa           leave memory placement to the kernel\n"
+                 "  --io BACKEND        socket I/O: io_uring with epoll\n"
+                 "                      fallback (auto, default), epoll, or\n"
+                 "                      uring\n"
+                 "  --wal DIR           log writes to DIR, replay them on start\n"
+                 "  --wal-sync-us N     group commit: fdatasync at least every\n"
+                 "                      N microseconds (default 1000)\n"
+                 "  --wal-sync-bytes N  or once N bytes are unsynced\n"
+                 "                      (default 1 MiB)\n"
+                 "  --snapshot-bytes N  snapshot a shard in the background and\n"
+                 "                      drop its older log once N bytes were\n"
+                 "                      logged (default 64 MiB, 0 = never)\n",
+                 argv0);
+}
+} // namespace
 
 int main(int argc, char** argv)
 {
+    ServerOptions opts;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (!std::strcmp(arg, "--unix") && hasValue)
+        {
+            opts.unixPath = argv[++i];
+        }
+        else if (!std::strcmp(arg, "--port") && hasValue)
+        {
+            opts.port = static_cast<uint16_t>(std::atoi(argv[++i]));
+        }
+        else if (!std::strcmp(arg, "--buckets") && hasValue)
+        {
+            opts.buckets = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (!std::strcmp(arg, "--threads") && hasValue)
+        {
+            opts.threads = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (!std::strcmp(arg, "--no-pin"))
+        {
+            opts.pin = false;
+        }
+        else if (!std::strcmp(arg, "--numa-nodes") && hasValue)
+        {
+            opts.numaNodes = ehash::Numa::parseList(argv[++i]);
+            if (opts.numaNodes.empty())
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (!std::strcmp(arg, "--no-numa"))
+        {
+            opts.numa = false;
+        }
+        else if (!std::strcmp(arg, "--io") && hasValue)
+        {
+            const char* io = argv[++i];
+            if (!std::strcmp(io, "epoll"))
+            {
+                opts.io = IoBackend::Epoll;
+            }
+            else if (!std::strcmp(io, "uring"))
+            {
+                opts.io = IoBackend::Uring;
+            }
+            else if (std::strcmp(io, "auto"))
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (!std::strcmp(arg, "--wal") && hasValue)
+        {
+            opts.walDir = argv[++i];
+        }
+        else if (!std::strcmp(arg, "--wal-sync-us") && hasValue)
+        {
+            opts.walSyncUs = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (!std::strcmp(arg, "--wal-sync-bytes") && hasValue)
+        {
+            opts.walSyncBytes = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (!std::strcmp(arg, "--snapshot-bytes") && hasValue)
+        {
+            opts.snapshotBytes = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else
+        {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    Server server(opts);
+    if (!server.start()) return EXIT_FAILURE;
+
+    running = &server;
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    server.run();
     return EXIT_SUCCESS;
 }
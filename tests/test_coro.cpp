@@ -0,0 +1,233 @@
+/*!
+ * \file    tests/test_coro.cpp
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   unit tests for coroutine lookups and a benchmark against find()
+ *          and find_batch() on a table larger than the cache.
+ */
+
+#include "../lib/EHash.h"
+#include "../lib/EHashCoro.h"
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using Map = EHash<uint64_t, uint64_t, ehash::Flat>;
+
+/*!
+ * \brief   key with a constant hash, so its map builds a tree bucket.
+ */
+struct Flood
+{
+    uint64_t id;
+    uint8_t pad = 0;
+    bool operator==(const Flood& o) const { return id == o.id; }
+    bool operator<(const Flood& o) const { return id < o.id; }
+};
+
+template<> struct std::hash<Flood>
+{
+    size_t operator()(const Flood&) const { return 42; }
+};
+
+/*!
+ * \brief   store what lookup() yields for key.
+ */
+template<typename M, typename K, typename V>
+ehash::Task record(M& map, K key, V*& out)
+{
+    out = co_await ehash::lookup(map, key);
+}
+
+/*!
+ * \brief   lookup(key), then lookup of the value found: two dependent
+ *          lookups in one task.
+ */
+ehash::Task chase(Map& map, uint64_t key, uint64_t& sum)
+{
+    uint64_t* v = co_await ehash::lookup(map, key);
+    if (!v) co_return;
+    if (uint64_t* w = co_await ehash::lookup(map, *v)) sum += *w;
+}
+
+ehash::Task fail(Map& map)
+{
+    co_await ehash::lookup(map, 1);
+    throw std::runtime_error("task failed");
+}
+
+/*!
+ * \brief   coroutine lookups agree with find() on hits, misses, shared
+ *          chains, tree buckets and string keys, in every window width.
+ *
+ * \note    will abort if any test fails.
+ */
+void unit_tests()
+{
+    Map map;
+    for (uint64_t i = 0; i < 100'000; ++i) map.insert(i * 2, i * 2 + 1);
+
+    std::vector<uint64_t> keys;
+    for (uint64_t i = 0; i < 20'000; ++i) keys.push_back(i * 3);
+    for (size_t width : {1, 2, 7, 32, 100'000})
+    {
+        ehash::Scheduler sched(width);
+        std::vector<uint64_t*> out(keys.size());
+        sched.run(keys.size(), [&](size_t i) {
+            return record(map, keys[i], out[i]);
+        });
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            assert(out[i] == static_cast<uint64_t*>(map.find(keys[i])));
+        }
+    }
+
+    // chains shared with a snapshot: the lookup copies them, as find() does
+    auto snap = map.snapshot();
+    std::vector<uint64_t*> out(keys.size());
+    ehash::Scheduler sched(16);
+    sched.run(keys.size(), [&](size_t i) {
+        return record(map, keys[i], out[i]);
+    });
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        assert(out[i] == static_cast<uint64_t*>(map.find(keys[i])));
+        if (out[i]) *out[i] += 1; // private to the map
+    }
+    assert(*snap.find(0) == 1 && *map.find(0) == 2);
+
+    // i -> i + 1 in a ring: chase(i) finds i + 2
+    Map ring;
+    for (uint64_t i = 0; i < 1'000; ++i) ring.insert(i, (i + 1) % 1'000);
+    uint64_t sum = 0;
+    sched.run(1'000, [&](size_t i) { return chase(ring, i, sum); });
+    assert(sum == 999 * 1'000 / 2);
+
+    EHash<Flood, uint64_t> tree;
+    for (uint64_t i = 0; i < 1'000; ++i) tree.insert({i}, i);
+    assert(tree.stats().treeified > 0);
+    std::vector<uint64_t*> hits(1'100);
+    sched.run(hits.size(), [&](size_t i) {
+        return record(tree, Flood{i}, hits[i]);
+    });
+    for (uint64_t i = 0; i < hits.size(); ++i)
+    {
+        assert(i < 1'000 ? *hits[i] == i : !hits[i]);
+    }
+
+    EHash<std::string, int> strings;
+    for (int i = 0; i < 1'000; ++i) strings.insert(std::to_string(i), i);
+    std::vector<int*> found(1'001);
+    sched.run(found.size(), [&](size_t i) {
+        return record(strings, std::to_string(i), found[i]);
+    });
+    for (int i = 0; i < 1'000; ++i) assert(*found[i] == i);
+    assert(!found.back());
+
+    bool thrown = false;
+    try
+    {
+        sched.run(10, [&](size_t) { return fail(map); });
+    }
+    catch (const std::runtime_error&)
+    {
+        thrown = true;
+    }
+    assert(thrown);
+    sched.run(0, [&](size_t) { return fail(map); });
+
+    std::cout << "[TEST] all coroutine lookup unit tests passed!\n";
+}
+
+ehash::Task add(Map& map, uint64_t key, uint64_t& sum)
+{
+    if (uint64_t* v = co_await ehash::lookup(map, key)) sum += *v;
+}
+
+/*!
+ * \brief   lookups of random keys, half of them misses, in a map of N
+ *          elements: find(), find_batch(), and coroutines per window.
+ */
+void benchmark(size_t N)
+{
+    using clock = std::chrono::high_resolution_clock;
+    std::mt19937_64 rng(17);
+    std::vector<uint64_t> keys(N);
+    for (auto& k : keys) k = rng();
+    Map map;
+    for (size_t i = 0; i < N; ++i) map.insert(keys[i], keys[(i + 1) % N]);
+
+    const size_t Q = 4'000'000;
+    std::vector<uint64_t> queries(Q);
+    for (size_t i = 0; i < Q; ++i) queries[i] = i % 2 ? keys[rng() % N] : rng();
+
+    auto report = [&](const char* name, auto t0, auto t1, uint64_t sum) {
+        std::printf("[BENCH] %-18s %.1f ns/lookup (%llu)\n", name,
+                    std::chrono::duration<double, std::nano>(t1 - t0).count() /
+                        Q,
+                    (unsigned long long)(sum % 1000));
+    };
+    std::printf("[BENCH] %zu elements, %zu lookups, half of them misses\n", N,
+                Q);
+
+    uint64_t sum = 0;
+    auto t0 = clock::now();
+    for (uint64_t q : queries)
+    {
+        if (uint64_t* v = map.find(q)) sum += *v;
+    }
+    auto t1 = clock::now();
+    report("find", t0, t1, sum);
+
+    sum = 0;
+    std::vector<uint64_t*> out(Q);
+    t0 = clock::now();
+    map.find_batch(queries, out);
+    for (uint64_t* v : out) sum += v ? *v : 0;
+    t1 = clock::now();
+    report("find_batch", t0, t1, sum);
+
+    for (size_t width : {1, 4, 8, 16, 32, 64})
+    {
+        sum = 0;
+        ehash::Scheduler sched(width);
+        t0 = clock::now();
+        sched.run(Q, [&](size_t i) { return add(map, queries[i], sum); });
+        t1 = clock::now();
+        char name[32];
+        std::snprintf(name, sizeof name, "coroutines x%zu", width);
+        report(name, t0, t1, sum);
+    }
+
+    // dependent lookups: the value found is the next key, 2 per query
+    sum = 0;
+    t0 = clock::now();
+    for (size_t i = 0; i < Q / 2; ++i)
+    {
+        uint64_t* v = map.find(keys[i % N]);
+        if (uint64_t* w = map.find(*v)) sum += *w;
+    }
+    t1 = clock::now();
+    report("chained find", t0, t1, sum);
+
+    sum = 0;
+    ehash::Scheduler sched(32);
+    t0 = clock::now();
+    sched.run(Q / 2, [&](size_t i) { return chase(map, keys[i % N], sum); });
+    t1 = clock::now();
+    report("chained x32", t0, t1, sum);
+}
+
+int main(int argc, char** argv)
+{
+    unit_tests();
+    benchmark(argc > 1 ? std::stoull(argv[1]) : 10'000'000);
+    return 0;
+}
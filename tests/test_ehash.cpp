@@ -9,11 +9,16 @@
  */
 
 #include "../lib/EHash.h"
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstdio>
 #include <iostream>
 #include <string>
 #include <chrono>
 #include <random>
+#include <stdexcept>
+#include <thread>
 #include <vector>
 #include <unordered_map>
 
@@ -48,6 +53,892 @@ void unit_tests()
     std::cout << "[TEST] all EHash unit tests passed!\n";
 }
 
+/*!
+ * \brief   value large enough to be stored out of line.
+ */
+struct Blob
+{
+    uint64_t words[16];
+
+    explicit Blob(uint64_t seed = 0)
+    {
+        for (size_t i = 0; i < 16; ++i) words[i] = seed + i;
+    }
+};
+
+/*!
+ * \brief   Blob whose copies throw while armed.
+ */
+struct Fragile : Blob
+{
+    static inline bool armed = false;
+
+    Fragile() = default;
+    Fragile(const Fragile& o) : Blob(o)
+    {
+        if (armed) throw std::runtime_error("copy");
+    }
+};
+
+/*!
+ * \brief   the same value, inline in a Flat map.
+ */
+struct FlatBlob : Blob
+{
+    using Blob::Blob;
+};
+
+template<> inline constexpr bool ehash::storeOutOfLine<FlatBlob> = false;
+
+/*!
+ * \brief   out-of-line values keep their address across rehash and other
+ *          removes, and copies and snapshots do not share them.
+ *
+ * \note    will abort if any test fails.
+ */
+void value_store_tests()
+{
+    static_assert(ehash::storeOutOfLine<Blob>);
+    static_assert(!ehash::storeOutOfLine<uint64_t>);
+
+    EHash<uint64_t, Blob> emap(4);
+    emap.insert(7, Blob(70));
+    Blob* seven = emap.find(7);
+
+    for (uint64_t i = 100; i < 100'000; ++i) emap.insert(i, Blob(i));
+    for (uint64_t i = 100; i < 100'000; i += 2) emap.remove(i);
+    assert(emap.find(7) == seven && seven->words[15] == 85);
+
+    emap.insert(7, Blob(700)); // overwrite in place
+    assert(emap.find(7) == seven && seven->words[0] == 700);
+    for (uint64_t i = 101; i < 100'000; i += 2)
+    {
+        assert(emap.find(i)->words[3] == i + 3);
+    }
+
+    EHash<uint64_t, Blob> copy = emap;
+    auto snap = emap.snapshot();
+    emap.find(7)->words[0] = 1;
+    assert(copy.find(7)->words[0] == 700 && snap.find(7)->words[0] == 700);
+    assert(emap.find(7)->words[0] == 1);
+
+    bool removed = emap.remove(7);
+    assert(removed && !emap.find(7) && snap.find(7)->words[0] == 700);
+
+    // a copy that throws hands its block back: the next allocation of
+    // the size gets the same block
+    using ehash::NodePool;
+    void* block = NodePool::allocate(sizeof(Fragile));
+    NodePool::deallocate(block, sizeof(Fragile));
+    Fragile fragile;
+    Fragile::armed = true;
+    bool threw = false;
+    try
+    {
+        ehash::PooledValue<Fragile> lost(fragile);
+    }
+    catch (const std::runtime_error&)
+    {
+        threw = true;
+    }
+    Fragile::armed = false;
+    void* next = NodePool::allocate(sizeof(Fragile));
+    assert(threw && next == block);
+    NodePool::deallocate(next, sizeof(Fragile));
+
+    std::cout << "[TEST] all EHash value store tests passed!\n";
+}
+
+/*!
+ * \brief   Stable pointers survive growth; Flat ones are flagged stale in
+ *          debug builds.
+ *
+ * \note    will abort if any test fails.
+ */
+void stability_tests()
+{
+    EHash<uint64_t, uint64_t> stable(4);
+    stable.insert(1, 10);
+    uint64_t* one = stable.find(1);
+    for (uint64_t i = 2; i < 50'000; ++i) stable.insert(i, i);
+    for (uint64_t i = 2; i < 50'000; i += 3) stable.remove(i);
+    assert(stable.find(1) == one && *one == 10);
+
+    EHash<uint64_t, uint64_t, ehash::Flat> flat(4);
+    flat.insert(1, 10);
+    auto p = flat.find(1);
+    uint64_t* raw = p; // converts in both build modes
+    assert(p && *p == 10 && raw == flat.find(1));
+    flat.insert(1, 11); // overwrite: nothing moves
+    assert(*p == 11);
+#if !defined(NDEBUG)
+    assert(p.valid());
+    flat.insert(2, 20);
+    assert(!p.valid() && flat.find(1).valid());
+    auto q = flat.find(2);
+    flat.remove(1);
+    assert(!q.valid() && flat.find(1) == nullptr);
+#endif
+
+    std::cout << "[TEST] all EHash stability tests passed!\n";
+}
+
+/*!
+ * \brief   key whose std::hash is constant, so all keys collide in full;
+ *          the padding keeps it off the hash_key path.
+ */
+struct Flood
+{
+    uint64_t id;
+    uint8_t pad = 0;
+    bool operator==(const Flood& o) const { return id == o.id; }
+    bool operator<(const Flood& o) const { return id < o.id; }
+};
+
+/*!
+ * \brief   Flood without operator<: its chains cannot become trees.
+ */
+struct Unordered
+{
+    uint64_t id;
+    uint8_t pad = 0;
+    bool operator==(const Unordered& o) const { return id == o.id; }
+};
+
+template<> struct std::hash<Flood>
+{
+    size_t operator()(const Flood&) const { return 42; }
+};
+
+template<> struct std::hash<Unordered>
+{
+    size_t operator()(const Unordered&) const { return 42; }
+};
+
+/*!
+ * \brief   n keys that all land in bucket 0 of a map with the given seed
+ *          and bucket count, as an attacker who learned the seed would pick.
+ */
+std::vector<uint64_t> aimed_keys(uint64_t seed, size_t buckets, size_t n)
+{
+    std::vector<uint64_t> keys;
+    for (uint64_t k = 0; keys.size() < n; ++k)
+    {
+        if (ehash::hash_key(k, seed) % buckets == 0) keys.push_back(k);
+    }
+    return keys;
+}
+
+/*!
+ * \brief   seeds, reseeding on keys aimed at one bucket, and tree buckets
+ *          on keys whose hashes collide in full.
+ *
+ * \note    will abort if any test fails.
+ */
+void flooding_tests()
+{
+    EHash<uint64_t, uint64_t> a, b, fixed(8, 5);
+    assert(a.seed() != b.seed() && fixed.seed() == 5);
+    EHash<uint64_t, uint64_t> copy = fixed;
+    assert(copy.seed() == 5);
+
+    // bucket collisions: a new seed spreads them
+    std::vector<uint64_t> aimed = aimed_keys(1234, 4096, 600);
+    EHash<uint64_t, uint64_t> target(4096, 1234);
+    for (uint64_t k : aimed) target.insert(k, k + 1);
+    assert(target.stats().reseeds == 1 && target.stats().treeified == 0);
+    assert(target.seed() != 1234 && target.size() == aimed.size());
+    for (uint64_t k : aimed) assert(*target.find(k) == k + 1);
+
+    // the same through insert_batch: hashes of the block are stale after
+    // the reseed
+    EHash<uint64_t, uint64_t> batched(4096, 1234);
+    batched.insert_batch(aimed, aimed);
+    assert(batched.stats().reseeds == 1 && batched.size() == aimed.size());
+    for (uint64_t k : aimed) assert(*batched.find(k) == k);
+
+    // full collisions: no seed helps, the chain becomes a tree
+    EHash<Flood, uint64_t> flood;
+    const uint64_t N = 20'000;
+    for (uint64_t i = 0; i < N; ++i) flood.insert({i}, i);
+    assert(flood.stats().treeified >= 1 && flood.stats().reseeds == 0);
+    flood.insert({7}, 70);
+    assert(flood.size() == N && *flood.find({7}) == 70);
+    flood.insert({7}, 7);
+
+    auto snap = flood.snapshot();
+    EHash<Flood, uint64_t> shared = flood; // shares the tree until written
+    for (uint64_t i = 0; i < N; i += 2)
+    {
+        bool removed = flood.remove({i});
+        assert(removed);
+    }
+    bool removed = flood.remove({0});
+    assert(!removed && flood.size() == N / 2);
+    for (uint64_t i = 0; i < N; ++i)
+    {
+        assert((flood.find({i}) != nullptr) == (i % 2 == 1));
+        assert(*shared.find({i}) == i && *snap.find({i}) == i);
+    }
+    assert(!flood.find({N}) && !snap.find({N}));
+
+    flood.reserve(4 * N); // rehash: taken apart and rebuilt
+    size_t seen = 0;
+    flood.forEach([&](const Flood& k, uint64_t v) {
+        assert(k.id == v && k.id % 2 == 1);
+        seen++;
+    });
+    assert(seen == N / 2);
+    for (uint64_t i = 1; i < N; i += 2) flood.remove({i});
+    assert(flood.size() == 0 && !flood.find({1}));
+    flood.insert({1}, 1);
+    assert(*flood.find({1}) == 1);
+
+    EHash<Flood, uint64_t, ehash::Flat> flat;
+    for (uint64_t i = 0; i < 2'000; ++i) flat.insert({i}, i);
+    for (uint64_t i = 0; i < 2'000; i += 3) flat.remove({i});
+    for (uint64_t i = 0; i < 2'000; ++i)
+    {
+        auto p = flat.find({i});
+        assert(i % 3 == 0 ? !p : *p == i);
+    }
+
+    // without operator< the chain just stays long
+    EHash<Unordered, uint64_t> chain;
+    for (uint64_t i = 0; i < 2'000; ++i) chain.insert({i}, i);
+    assert(chain.stats().treeified == 0 && chain.stats().reseeds == 0);
+    for (uint64_t i = 0; i < 2'000; ++i) assert(*chain.find({i}) == i);
+
+    std::cout << "[TEST] all EHash flooding tests passed!\n";
+}
+
+/*!
+ * \brief   move-to-front and transpose keep every element reachable and
+ *          bring a hot key forward; snapshots see no change.
+ *
+ * \note    will abort if any test fails.
+ */
+void reorder_tests()
+{
+    for (auto order : {ehash::Reorder::MoveToFront, ehash::Reorder::Transpose})
+    {
+        EHash<uint64_t, uint64_t> emap(8, 77);
+        emap.setMaxLoad(6.0f); // long chains
+        emap.setReorder(order);
+        for (uint64_t i = 0; i < 5'000; ++i) emap.insert(i, i);
+
+        // the deepest key of the table
+        uint64_t hot = 0;
+        for (uint64_t i = 0; i < 5'000; ++i)
+        {
+            if (emap.depth(i) > emap.depth(hot)) hot = i;
+        }
+        size_t before = emap.depth(hot);
+        assert(before > 2);
+
+        auto snap = emap.snapshot();
+        uint64_t* v = emap.find(hot);
+        assert(*v == hot);
+        size_t after = emap.depth(hot);
+        assert(order == ehash::Reorder::MoveToFront ? after == 1
+                                                    : after == before - 1);
+        for (size_t i = 0; i < before; ++i) emap.find(hot);
+        assert(emap.depth(hot) == 1 && *v == hot); // Stable: v still valid
+
+        std::mt19937_64 rng(5);
+        for (int i = 0; i < 50'000; ++i)
+        {
+            uint64_t k = rng() % 6'000;
+            uint64_t* p = emap.find(k);
+            assert(k < 5'000 ? p && *p == k : !p);
+            if (i % 7 == 0 && k < 5'000)
+            {
+                emap.remove(k);
+                emap.insert(k, k);
+            }
+        }
+        for (uint64_t i = 0; i < 5'000; ++i)
+        {
+            assert(*emap.find(i) == i && *snap.find(i) == i);
+        }
+        assert(emap.size() == 5'000);
+    }
+
+    EHash<uint64_t, uint64_t, ehash::Flat> flat(8, 77);
+    flat.setMaxLoad(6.0f);
+    flat.setReorder(ehash::Reorder::MoveToFront);
+    for (uint64_t i = 0; i < 1'000; ++i) flat.insert(i, i);
+    for (uint64_t i = 0; i < 1'000; ++i) assert(*flat.find(i) == i);
+#if !defined(NDEBUG)
+    uint64_t deep = 0;
+    for (uint64_t i = 0; i < 1'000; ++i)
+    {
+        if (flat.depth(i) > flat.depth(deep)) deep = i;
+    }
+    auto p = flat.find(deep == 0 ? 1 : 0);
+    flat.find(deep); // moves values
+    assert(!p.valid() && flat.find(deep).valid());
+#endif
+
+    std::cout << "[TEST] all EHash reorder tests passed!\n";
+}
+
+/*!
+ * \brief   clear() and reset(): empty maps that stay usable, refills,
+ *          snapshots and copies that keep the old contents, and the sweep
+ *          when the epoch wraps.
+ *
+ * \note    will abort if any test fails.
+ */
+void clear_tests()
+{
+    EHash<uint64_t, uint64_t> emap(8, 3);
+    for (uint64_t i = 0; i < 10'000; ++i) emap.insert(i, i);
+    auto snap = emap.snapshot();
+    EHash<uint64_t, uint64_t> copy = emap;
+    size_t buckets = emap.bucket_count();
+
+    emap.clear();
+    assert(emap.size() == 0 && emap.bucket_count() == buckets);
+    for (uint64_t i = 0; i < 10'000; ++i) assert(!emap.find(i));
+    size_t seen = 0;
+    emap.forEach([&](const uint64_t&, const uint64_t&) { seen++; });
+    bool removed = emap.remove(5);
+    assert(seen == 0 && !removed);
+    for (uint64_t i = 0; i < 10'000; ++i)
+    {
+        assert(*snap.find(i) == i && *copy.find(i) == i);
+    }
+
+    // refill half over stale buckets, then grow past the old table
+    for (uint64_t i = 0; i < 20'000; i += 2) emap.insert(i, i + 1);
+    for (uint64_t i = 0; i < 20'000; ++i)
+    {
+        uint64_t* v = emap.find(i);
+        assert(i % 2 ? !v : *v == i + 1);
+    }
+    assert(emap.size() == 10'000);
+    removed = emap.remove(0);
+    assert(removed && !emap.find(0));
+
+    // 65536 clears wrap the epoch; words from the first round must not
+    // read as live again
+    EHash<std::string, int> strings(64, 3);
+    strings.insert("kept", 1);
+    strings.clear();
+    for (int round = 0; round < 70'000; ++round)
+    {
+        assert(!strings.find("kept"));
+        if (round % 1'000 == 0) strings.insert(std::to_string(round), round);
+        strings.clear();
+    }
+    strings.insert("x", 2);
+    assert(strings.size() == 1 && *strings.find("x") == 2);
+
+    // tree buckets are released like chains
+    EHash<Flood, uint64_t> tree;
+    for (uint64_t i = 0; i < 1'000; ++i) tree.insert({i}, i);
+    tree.clear();
+    assert(!tree.find({1}));
+    for (uint64_t i = 0; i < 1'000; ++i) tree.insert({i}, i * 2);
+    for (uint64_t i = 0; i < 1'000; ++i) assert(*tree.find({i}) == i * 2);
+    tree.reset();
+    assert(tree.size() == 0 && !tree.find({1}));
+
+    emap.reset();
+    assert(emap.size() == 0 && emap.bucket_count() >= buckets);
+    emap.insert(7, 7);
+    assert(*emap.find(7) == 7);
+    emap.reset(false);
+    assert(emap.size() == 0 && emap.bucket_count() == 8 && !emap.find(7));
+    for (uint64_t i = 0; i < 1'000; ++i) emap.insert(i, i);
+    for (uint64_t i = 0; i < 1'000; ++i) assert(*emap.find(i) == i);
+    assert(*snap.find(9'999) == 9'999);
+
+#if !defined(NDEBUG)
+    EHash<uint64_t, uint64_t, ehash::Flat> flat;
+    flat.insert(1, 1);
+    auto p = flat.find(1);
+    flat.clear();
+    assert(!p.valid());
+#endif
+
+    std::cout << "[TEST] all EHash clear tests passed!\n";
+}
+
+/*!
+ * \brief   mapped bytes of this process.
+ */
+size_t vm_size()
+{
+    long pages = 0;
+    if (FILE* f = std::fopen("/proc/self/statm", "r"))
+    {
+        if (std::fscanf(f, "%ld", &pages) != 1) pages = 0;
+        std::fclose(f);
+    }
+    return size_t(pages) * 4096;
+}
+
+/*!
+ * \brief   erase_if() and erase_if_parallel() agree with remove() per key,
+ *          on chains, trees, shared chains and string keys.
+ *
+ * \note    will abort if any test fails.
+ */
+void erase_tests()
+{
+    std::mt19937_64 rng(9);
+    for (unsigned threads : {0u, 1u, 3u, 8u})
+    {
+        EHash<uint64_t, uint64_t> emap(8, 5);
+        std::unordered_map<uint64_t, uint64_t> ref;
+        for (int i = 0; i < 20'000; ++i)
+        {
+            uint64_t k = rng() % 50'000;
+            emap.insert(k, k * 3);
+            ref[k] = k * 3;
+        }
+        auto snap = emap.snapshot();
+
+        auto odd = [](const uint64_t& k, const uint64_t& v) {
+            return k % 2 && v % 3 == 0;
+        };
+        size_t n = threads ? emap.erase_if_parallel(odd, threads)
+                           : emap.erase_if(odd);
+        size_t m = std::erase_if(ref, [](const auto& kv) {
+            return kv.first % 2;
+        });
+        assert(n == m && emap.size() == ref.size());
+        for (uint64_t k = 0; k < 50'000; ++k)
+        {
+            uint64_t* v = emap.find(k);
+            assert(ref.count(k) ? v && *v == k * 3 : !v);
+        }
+        assert(snap.size() == ref.size() + n); // the view kept its pairs
+
+        // the compacted chains take inserts and removes as before
+        for (uint64_t k = 1; k < 2'000; k += 2) emap.insert(k, k);
+        for (uint64_t k = 0; k < 2'000; k += 4) emap.remove(k);
+        for (uint64_t k = 0; k < 2'000; ++k)
+        {
+            uint64_t* v = emap.find(k);
+            if (k % 2) assert(v && *v == k);
+            else if (k % 4 == 0) assert(!v);
+        }
+        size_t erased = emap.erase_if([](const uint64_t&, const uint64_t&) {
+            return false;
+        });
+        assert(erased == 0);
+    }
+
+    // emptying every chain, then shrinking
+    EHash<uint64_t, uint64_t> emap(8, 5);
+    for (uint64_t i = 0; i < 100'000; ++i) emap.insert(i, i);
+    size_t buckets = emap.bucket_count();
+    size_t erased = emap.erase_if([](const uint64_t& k, const uint64_t&) {
+        return k >= 1'000;
+    }, true);
+    assert(erased == 99'000);
+    assert(emap.size() == 1'000 && emap.bucket_count() < buckets / 16);
+    for (uint64_t i = 0; i < 2'000; ++i)
+    {
+        assert(i < 1'000 ? *emap.find(i) == i : !emap.find(i));
+    }
+    erased = emap.erase_if_parallel([](const uint64_t&, const uint64_t&) {
+        return true;
+    }, 4, true);
+    assert(erased == 1'000);
+    assert(emap.size() == 0 && emap.bucket_count() == 8);
+    emap.insert(1, 1);
+    assert(*emap.find(1) == 1);
+
+    // tree buckets, shared with a copy
+    EHash<Flood, uint64_t> tree;
+    for (uint64_t i = 0; i < 1'000; ++i) tree.insert({i}, i);
+    EHash<Flood, uint64_t> copy = tree;
+    erased = tree.erase_if([](const Flood& k, const uint64_t&) {
+        return k.id % 3 == 0;
+    });
+    assert(erased == 334);
+    for (uint64_t i = 0; i < 1'000; ++i)
+    {
+        assert(i % 3 ? *tree.find({i}) == i : !tree.find({i}));
+        assert(*copy.find({i}) == i);
+    }
+    tree.erase_if([](const Flood&, const uint64_t&) { return true; });
+    assert(tree.size() == 0 && !tree.find({1}));
+
+    EHash<std::string, std::string> strings;
+    for (int i = 0; i < 5'000; ++i)
+    {
+        strings.insert(std::to_string(i), std::string(i % 40, 'x'));
+    }
+    strings.erase_if([](const std::string& k, const std::string& v) {
+        return k.back() == '7' || v.size() > 30;
+    });
+    for (int i = 0; i < 5'000; ++i)
+    {
+        std::string* v = strings.find(std::to_string(i));
+        bool gone = i % 10 == 7 || i % 40 > 30;
+        assert(gone ? !v : v && v->size() == size_t(i % 40));
+    }
+
+    // each parallel erase against a snapshot unshares chains on fresh
+    // worker threads; their slabs must be reused, not mapped anew
+    EHash<uint64_t, uint64_t> live;
+    for (uint64_t i = 0; i < 200'000; ++i) live.insert(i, i);
+    size_t before = 0;
+    for (int round = 0; round < 50; ++round)
+    {
+        auto snap = live.snapshot();
+        erased = live.erase_if_parallel([](const uint64_t& k, const uint64_t&) {
+            return k % 2 == 0;
+        }, 4);
+        assert(erased == 100'000 && snap.size() == 200'000);
+        for (uint64_t i = 0; i < 200'000; i += 2) live.insert(i, i);
+        if (round == 4) before = vm_size();
+    }
+    assert(vm_size() < before + (32 << 20));
+
+#if !defined(NDEBUG)
+    EHash<uint64_t, uint64_t, ehash::Flat> flat;
+    for (uint64_t i = 0; i < 100; ++i) flat.insert(i, i);
+    auto p = flat.find(1);
+    flat.erase_if([](const uint64_t& k, const uint64_t&) { return k == 2; });
+    assert(!p.valid() && *flat.find(1) == 1);
+#endif
+
+    std::cout << "[TEST] all EHash erase tests passed!\n";
+}
+
+/*!
+ * \brief   lookups on N keys whose hashes collide in full: a tree bucket
+ *          (Flood) against a plain chain (Unordered).
+ */
+template<typename Key> void bench_flooding(const char* name, size_t N)
+{
+    using clock = std::chrono::high_resolution_clock;
+    EHash<Key, uint64_t> emap;
+    auto t0 = clock::now();
+    for (uint64_t i = 0; i < N; ++i) emap.insert({i}, i);
+    auto t1 = clock::now();
+    uint64_t sum = 0;
+    std::mt19937_64 rng(3);
+    for (size_t i = 0; i < N; ++i) sum += *emap.find({rng() % N});
+    auto t2 = clock::now();
+
+    auto ns = [&](auto a, auto b) {
+        return std::chrono::duration<double, std::nano>(b - a).count() / N;
+    };
+    std::cout << "[" << name << "] " << N << " colliding keys: insert "
+              << ns(t0, t1) << " ns, find " << ns(t1, t2) << " ns (checksum "
+              << sum % 1000 << ")\n";
+}
+
+/*!
+ * \brief   finds of N keys at load factor load, drawn from a Zipf
+ *          distribution with exponent skew (0: uniform), under each chain
+ *          order: ns per find and average pairs walked per hit.
+ */
+void bench_reorder(size_t N, float load, double skew)
+{
+    using clock = std::chrono::high_resolution_clock;
+    std::mt19937_64 rng(13);
+    std::vector<uint64_t> keys(N);
+    for (auto& k : keys) k = rng();
+
+    // rank r is drawn with probability proportional to 1 / (r + 1)^skew;
+    // ranks are shuffled so popularity has nothing to do with insert order
+    std::vector<size_t> byRank(N);
+    for (size_t r = 0; r < N; ++r) byRank[r] = r;
+    std::shuffle(byRank.begin(), byRank.end(), rng);
+    std::vector<double> cdf(N);
+    double total = 0;
+    for (size_t r = 0; r < N; ++r)
+    {
+        cdf[r] = total += 1.0 / std::pow(double(r + 1), skew);
+    }
+    std::vector<uint64_t> queries(4'000'000);
+    std::uniform_real_distribution<double> unit(0, total);
+    for (auto& q : queries)
+    {
+        size_t r = std::lower_bound(cdf.begin(), cdf.end(), unit(rng)) -
+                   cdf.begin();
+        q = keys[byRank[std::min(r, N - 1)]];
+    }
+
+    const char* names[] = {"insertion order", "move to front", "transpose"};
+    for (auto order : {ehash::Reorder::None, ehash::Reorder::MoveToFront,
+                       ehash::Reorder::Transpose})
+    {
+        EHash<uint64_t, uint64_t> emap(8, 1);
+        emap.setMaxLoad(load);
+        emap.setReorder(order);
+        for (size_t i = 0; i < N; ++i) emap.insert(keys[i], i);
+
+        uint64_t sum = 0;
+        for (size_t i = 0; i < queries.size() / 4; ++i) // warm up
+        {
+            sum += *emap.find(queries[i]);
+        }
+        auto t0 = clock::now();
+        for (uint64_t q : queries) sum += *emap.find(q);
+        auto t1 = clock::now();
+
+        size_t walked = 0;
+        for (size_t i = 0; i < queries.size(); i += 16)
+        {
+            walked += emap.depth(queries[i]);
+        }
+        std::printf("[%-15s] load %.2f, skew %.2f: find %.1f ns, %.2f pairs "
+                    "walked per hit (%llu)\n",
+                    names[int(order)], load, skew,
+                    std::chrono::duration<double, std::nano>(t1 - t0).count() /
+                        queries.size(),
+                    double(walked) / (queries.size() / 16),
+                    (unsigned long long)(sum % 1000));
+    }
+}
+
+/*!
+ * \brief   a scratch map filled with N keys and emptied again, rounds
+ *          times: clear(), reset(), remove() of every key, and a new map
+ *          per round.
+ */
+void bench_clear(size_t N, size_t rounds)
+{
+    using clock = std::chrono::high_resolution_clock;
+    std::mt19937_64 rng(21);
+    std::vector<uint64_t> keys(N);
+    for (auto& k : keys) k = rng();
+
+    auto run = [&](const char* name, auto empty) {
+        EHash<uint64_t, uint64_t> emap(8, 1);
+        uint64_t sum = 0;
+        double fill = 0, drop = 0;
+        for (size_t r = 0; r < rounds; ++r)
+        {
+            auto t0 = clock::now();
+            for (size_t i = 0; i < N; ++i) emap.insert(keys[i] + r, i);
+            sum += emap.size();
+            auto t1 = clock::now();
+            empty(emap);
+            auto t2 = clock::now();
+            fill += std::chrono::duration<double, std::micro>(t1 - t0).count();
+            drop += std::chrono::duration<double, std::micro>(t2 - t1).count();
+        }
+        std::printf("[%-13s] %zu elements: fill %.1f us, empty %.1f us "
+                    "per round (%llu)\n",
+                    name, N, fill / rounds, drop / rounds,
+                    (unsigned long long)(sum % 1000));
+    };
+
+    run("clear", [](auto& m) { m.clear(); });
+    run("reset", [](auto& m) { m.reset(); });
+    run("remove all", [&](auto& m) {
+        std::vector<uint64_t> all;
+        m.forEach([&](const uint64_t& k, uint64_t) { all.push_back(k); });
+        for (uint64_t k : all) m.remove(k);
+    });
+    run("new map", [](auto& m) { m = EHash<uint64_t, uint64_t>(8, 1); });
+}
+
+/*!
+ * \brief   removal of a fraction of N elements: remove() per collected
+ *          key against erase_if() and erase_if_parallel().
+ */
+void bench_erase(size_t N, double fraction)
+{
+    using clock = std::chrono::high_resolution_clock;
+    std::mt19937_64 rng(23);
+    std::vector<uint64_t> keys(N);
+    for (auto& k : keys) k = rng();
+    uint64_t cut = uint64_t(fraction * double(UINT64_MAX));
+    auto doomed = [cut](const uint64_t& k, const uint64_t&) { return k < cut; };
+
+    auto run = [&](const char* name, auto erase) {
+        EHash<uint64_t, uint64_t> emap(8, 1);
+        for (size_t i = 0; i < N; ++i) emap.insert(keys[i], i);
+        auto t0 = clock::now();
+        erase(emap);
+        auto t1 = clock::now();
+        std::printf("[%-17s] %zu elements, %.0f%% removed: %.1f ms (%zu "
+                    "left)\n",
+                    name, N, fraction * 100,
+                    std::chrono::duration<double, std::milli>(t1 - t0).count(),
+                    emap.size());
+    };
+
+    run("collect + remove", [&](auto& m) {
+        std::vector<uint64_t> gone;
+        m.forEach([&](const uint64_t& k, const uint64_t& v) {
+            if (doomed(k, v)) gone.push_back(k);
+        });
+        for (uint64_t k : gone) m.remove(k);
+    });
+    run("erase_if", [&](auto& m) { m.erase_if(doomed); });
+    run("erase_if, shrink", [&](auto& m) { m.erase_if(doomed, true); });
+    run("erase_if_parallel", [&](auto& m) { m.erase_if_parallel(doomed); });
+}
+
+/*!
+ * \brief   growth and lookups of Map with values built from an index.
+ */
+uint64_t word(const Blob& b) { return b.words[0]; }
+uint64_t word(uint64_t v) { return v; }
+
+template<typename Map> void bench_value_layout(const char* name, size_t N)
+{
+    using V = std::remove_reference_t<decltype(*std::declval<Map&>().find(0))>;
+    using clock = std::chrono::high_resolution_clock;
+    std::mt19937_64 rng(9);
+    std::vector<uint64_t> keys(N);
+    for (auto& k : keys) k = rng();
+
+    Map emap;
+    auto t0 = clock::now();
+    for (size_t i = 0; i < N; ++i) emap.insert(keys[i], V(i));
+    auto t1 = clock::now();
+    uint64_t sum = 0;
+    for (size_t i = 0; i < N; ++i) sum += word(*emap.find(keys[rng() % N]));
+    auto t2 = clock::now();
+    uint64_t misses = 0;
+    for (size_t i = 0; i < N; ++i) misses += emap.find(rng()) == nullptr;
+    auto t3 = clock::now();
+
+    auto ns = [&](auto a, auto b) {
+        return std::chrono::duration<double, std::nano>(b - a).count() / N;
+    };
+    std::cout << "[" << name << "] insert " << ns(t0, t1) << " ns, find hit "
+              << ns(t1, t2) << " ns, find miss " << ns(t2, t3)
+              << " ns (checksum " << (sum + misses) % 1000 << ")\n";
+}
+
+/*!
+ * \brief   check every hash_batch kernel against the scalar reference and
+ *          the batched EHash lookups against single ones.
+ *
+ * \note    will abort if any test fails.
+ */
+void batch_tests()
+{
+    using ehash::detail::Isa;
+
+    std::mt19937_64 rng(7);
+    std::vector<uint64_t> k64(67);
+    std::vector<int> k32(67);
+    for (auto& k : k64) k = rng();
+    for (auto& k : k32) k = static_cast<int>(rng()); // includes negatives
+
+    Isa native = ehash::detail::active_isa();
+    for (Isa isa : {Isa::Scalar, Isa::Avx2, Isa::Avx512})
+    {
+        if (isa > native) continue;
+        ehash::detail::active_isa() = isa;
+
+        // every length up to 67 exercises the vector body and the tail
+        for (size_t n = 0; n <= k64.size(); ++n)
+        {
+            std::vector<uint64_t> h64(n), h32(n), seeded(n);
+            ehash::hash_batch(std::span<const uint64_t>(k64.data(), n),
+                              std::span<uint64_t>(h64));
+            ehash::hash_batch(std::span<const int>(k32.data(), n),
+                              std::span<uint64_t>(h32));
+            ehash::hash_batch(std::span<const int>(k32.data(), n),
+                              std::span<uint64_t>(seeded), 0x5eed);
+            for (size_t i = 0; i < n; ++i)
+            {
+                assert(h64[i] == ehash::hash_key(k64[i]));
+                assert(h32[i] == ehash::hash_key(k32[i]));
+                assert(seeded[i] == ehash::hash_key(k32[i], 0x5eed));
+            }
+        }
+    }
+    ehash::detail::active_isa() = native;
+
+    EHash<int, int> emap(4);
+    std::vector<int> keys, values;
+    for (int i = 0; i < 1000; ++i)
+    {
+        keys.push_back(i * 7 - 300);
+        values.push_back(i);
+    }
+    emap.insert_batch(keys, values);
+
+    keys.push_back(123456); // missing key
+    std::vector<int*> found(keys.size());
+    emap.find_batch(keys, found);
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        assert(found[i] == emap.find(keys[i]));
+    }
+    assert(found.back() == nullptr);
+    assert(*found[10] == 10);
+
+    std::cout << "[TEST] all hash_batch tests passed!\n";
+}
+
+/*!
+ * \brief   snapshots stay consistent while the map keeps changing,
+ *          including under a concurrent reader.
+ *
+ * \note    will abort if any test fails.
+ */
+void snapshot_tests()
+{
+    EHash<int, int> emap(16);
+    for (int i = 0; i < 10'000; ++i) emap.insert(i, i);
+
+    auto snap = emap.snapshot();
+    for (int i = 0; i < 10'000; i += 2) emap.remove(i);
+    for (int i = 10'000; i < 50'000; ++i) emap.insert(i, -i); // rehashes
+    *emap.find(1) = 12345; // write through find() must not leak
+
+    assert(snap.size() == 10'000 && emap.size() == 45'000);
+    for (int i = 0; i < 10'000; ++i) assert(*snap.find(i) == i);
+    assert(snap.find(20'000) == nullptr);
+    assert(emap.find(2) == nullptr && *emap.find(1) == 12345);
+
+    size_t seen = 0;
+    snap.forEach([&](int k, int v) { seen += k == v; });
+    assert(seen == 10'000);
+
+    // copies share chains the same way
+    EHash<int, int> copy = emap;
+    copy.insert(1, 1);
+    assert(*emap.find(1) == 12345 && *copy.find(1) == 1);
+
+    // a reader scans while the writer rewrites every key
+    auto view = emap.snapshot();
+    long long expected = 0;
+    view.forEach([&](int, int v) { expected += v; });
+
+    std::thread reader([&view, expected] {
+        for (int round = 0; round < 20; ++round)
+        {
+            long long sum = 0;
+            view.forEach([&](int, int v) { sum += v; });
+            assert(sum == expected);
+        }
+    });
+    for (int round = 0; round < 5; ++round)
+    {
+        for (int i = 0; i < 50'000; ++i) emap.insert(i, round);
+    }
+    reader.join();
+
+    // and drops its view on its own thread
+    std::thread dropper([v = emap.snapshot()]() mutable {
+        auto gone = std::move(v);
+    });
+    for (int i = 0; i < 50'000; ++i) emap.remove(i);
+    dropper.join();
+    assert(emap.size() == 0);
+
+    std::cout << "[TEST] all EHash snapshot tests passed!\n";
+}
+
 /*!
  * \brief   mixed workload benchmark on EHash.
  *
@@ -155,12 +1046,86 @@ long long bench_stdmap(size_t N, uint64_t rng_seed)
     return checksum;
 }
 
+/*!
+ * \brief   hashing throughput of hash_batch per instruction set.
+ *
+ * \param N number of keys to hash
+ */
+void bench_hash_batch(size_t N)
+{
+    using ehash::detail::Isa;
+
+    std::vector<uint64_t> keys(N), hashes(N);
+    std::mt19937_64 rng(12345);
+    for (auto& k : keys) k = rng();
+
+    Isa native = ehash::detail::active_isa();
+    const char* names[] = {"scalar", "avx2", "avx512"};
+
+    std::cout << "\n[BENCH] hash_batch: " << N << " keys\n";
+    for (Isa isa : {Isa::Scalar, Isa::Avx2, Isa::Avx512})
+    {
+        if (isa > native) continue;
+        ehash::detail::active_isa() = isa;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        ehash::hash_batch(std::span<const uint64_t>(keys),
+                          std::span<uint64_t>(hashes));
+        auto end = std::chrono::high_resolution_clock::now();
+
+        uint64_t checksum = 0;
+        for (auto h : hashes) checksum ^= h;
+
+        double avg_ns =
+            std::chrono::duration<double, std::nano>(end - start).count() / N;
+        std::cout << "[" << names[static_cast<int>(isa)] << "]\n";
+        std::cout << "   ├─ avg per key: " << avg_ns << " ns\n";
+        std::cout << "   └─ checksum: " << checksum << "\n";
+    }
+    ehash::detail::active_isa() = native;
+}
+
 /*!
  * \brief   benchmark EHash and std::unordered_map side by side at multiple
  * scales.
  */
 void benchmark()
 {
+    bench_hash_batch(10'000'000);
+
+    std::cout << "\n[BENCH] 128-byte values, 2000000 elements\n";
+    bench_value_layout<EHash<uint64_t, Blob, ehash::Flat>>("out of line",
+                                                          2'000'000);
+    bench_value_layout<EHash<uint64_t, FlatBlob, ehash::Flat>>("inline",
+                                                              2'000'000);
+
+    std::cout << "\n[BENCH] hash flooding\n";
+    for (size_t n : {1'000, 10'000})
+    {
+        bench_flooding<Flood>("tree", n);
+        bench_flooding<Unordered>("chain", n);
+    }
+
+    std::cout << "\n[BENCH] chain order, 1000000 elements\n";
+    for (float load : {0.75f, 4.0f})
+    {
+        for (double skew : {0.0, 0.99, 1.2})
+        {
+            bench_reorder(1'000'000, load, skew);
+        }
+    }
+
+    std::cout << "\n[BENCH] scratch map reuse\n";
+    for (size_t n : {1'000, 100'000}) bench_clear(n, 10'000'000 / n);
+
+    std::cout << "\n[BENCH] bulk erase\n";
+    for (double f : {0.1, 0.5, 0.9}) bench_erase(2'000'000, f);
+
+    std::cout << "\n[BENCH] 8-byte values, 2000000 elements\n";
+    bench_value_layout<EHash<uint64_t, uint64_t>>("Stable", 2'000'000);
+    bench_value_layout<EHash<uint64_t, uint64_t, ehash::Flat>>("Flat",
+                                                              2'000'000);
+
     std::vector<size_t> scales = {100'000, 10'000'000, 50'000'000};
 
     for (auto N : scales)
@@ -182,6 +1147,14 @@ void benchmark()
 int main()
 {
     unit_tests();
+    batch_tests();
+    snapshot_tests();
+    value_store_tests();
+    stability_tests();
+    flooding_tests();
+    reorder_tests();
+    clear_tests();
+    erase_tests();
     benchmark();
     return 0;
 }
@@ -0,0 +1,226 @@
+/*!
+ * \file    tests/test_extendible.cpp
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   unit tests and growth benchmark for ExtendibleEHash,
+ *          compared against EHash.
+ */
+
+#include "../lib/EHash.h"
+#include "../lib/ExtendibleEHash.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+/*!
+ * \brief   key whose hash is the same for ids below 1000.
+ */
+struct SameKey
+{
+    uint64_t id;
+    uint64_t pad = 0;
+    bool operator==(const SameKey& o) const { return id == o.id; }
+};
+
+template<> struct std::hash<SameKey>
+{
+    size_t operator()(const SameKey& k) const
+    {
+        return k.id < 1000 ? 42 : ehash::mix64(k.id);
+    }
+};
+
+/*!
+ * \brief   random operations against std::unordered_map.
+ *
+ * \note    will abort if any test fails.
+ */
+void unit_tests()
+{
+    ExtendibleEHash<std::string, int> emap;
+    std::unordered_map<std::string, int> ref;
+
+    std::mt19937_64 rng(11);
+    for (int i = 0; i < 300'000; ++i)
+    {
+        std::string key = "k" + std::to_string(rng() % 50'000);
+        if (rng() % 4)
+        {
+            emap.insert(key, i);
+            ref[key] = i;
+        }
+        else
+        {
+            bool removed = emap.remove(key);
+            assert(removed == (ref.erase(key) == 1));
+        }
+    }
+
+    assert(emap.size() == ref.size());
+    for (auto& [k, v] : ref) assert(emap.find(k) && *emap.find(k) == v);
+    assert(emap.find("missing") == nullptr);
+
+    size_t seen = 0;
+    emap.forEach([&](const std::string& k, int v) { seen += ref.at(k) == v; });
+    assert(seen == ref.size());
+
+    // identical hashes cannot split: pages chain
+    ExtendibleEHash<SameKey, int> same;
+    for (uint64_t i = 0; i < 100; ++i) same.insert({i}, int(i));
+    for (uint64_t i = 0; i < 100; i += 2) same.remove({i});
+    for (uint64_t i = 1000; i < 5000; ++i) same.insert({i}, int(i)); // split
+    assert(same.size() == 4050);
+    for (uint64_t i = 0; i < 100; ++i)
+    {
+        assert(i % 2 ? *same.find({i}) == int(i) : same.find({i}) == nullptr);
+    }
+    for (uint64_t i = 1000; i < 5000; ++i) assert(*same.find({i}) == int(i));
+
+    std::cout << "[TEST] all ExtendibleEHash unit tests passed!\n";
+}
+
+/*!
+ * \brief   inverse of ehash::mix64, to craft keys with chosen hashes.
+ */
+uint64_t unmix64(uint64_t x)
+{
+    auto inverse = [](uint64_t a) {
+        uint64_t x = a; // Newton: each step doubles the correct low bits
+        for (int i = 0; i < 6; ++i) x *= 2 - a * x;
+        return x;
+    };
+    auto unshift = [](uint64_t x) { return x ^ x >> 33; }; // 33 > 64 / 2
+    x = unshift(x);
+    x *= inverse(0xc4ceb9fe1a85ec53ULL);
+    x = unshift(x);
+    x *= inverse(0xff51afd7ed558ccdULL);
+    return unshift(x);
+}
+
+/*!
+ * \brief   keys crafted for a known seed to agree on the low 31 hash bits
+ *          or on all of them: the directory stays bounded and the keys
+ *          chain.
+ *
+ * \note    will abort if any test fails.
+ */
+void flooding_tests()
+{
+    const uint64_t seed = 7;
+    ExtendibleEHash<uint64_t, uint64_t> emap(seed), other;
+    assert(emap.seed() == seed && other.seed() != seed);
+
+    std::vector<uint64_t> keys;
+    for (uint64_t i = 0; i < 2'000; ++i)
+    {
+        // 1000 keys differ only above bit 30, 1000 only above bit 31
+        uint64_t low = i < 1'000 ? 0x2bad'beefULL & 0x7fff'ffff : 0x1234'5678;
+        uint64_t hash = (i + 1) << (i < 1'000 ? 31 : 32) | low;
+        keys.push_back(unmix64(hash) ^ seed);
+        assert(ehash::hash_key(keys.back(), seed) == hash);
+    }
+    for (uint64_t i = 0; i < 50'000; ++i) keys.push_back(i * 0x9e37'79b9);
+
+    for (size_t i = 0; i < keys.size(); ++i) emap.insert(keys[i], i);
+    assert(emap.size() == keys.size());
+    assert(emap.memory() < keys.size() * 64); // no 2^31-slot directory
+    for (size_t i = 0; i < keys.size(); i += 3) emap.remove(keys[i]);
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        uint64_t* v = emap.find(keys[i]);
+        assert(i % 3 ? v && *v == i : !v);
+    }
+    size_t seen = 0;
+    emap.forEach([&](const uint64_t&, uint64_t) { seen++; });
+    assert(seen == emap.size());
+
+    std::cout << "[TEST] all ExtendibleEHash flooding tests passed!\n";
+}
+
+/*!
+ * \brief   peak resident memory of this process in KiB.
+ */
+long peakKiB()
+{
+    long kib = 0;
+    if (FILE* f = std::fopen("/proc/self/status", "r"))
+    {
+        char line[256];
+        while (std::fgets(line, sizeof line, f))
+        {
+            if (std::sscanf(line, "VmHWM: %ld", &kib) == 1) break;
+        }
+        std::fclose(f);
+    }
+    return kib;
+}
+
+/*!
+ * \brief   grow a map of type Map to N elements in a child process and
+ *          report time, slowest insert and peak memory.
+ */
+template<typename Map> void bench_growth(const char* name, size_t N)
+{
+    std::cout.flush(); // or the child prints it again
+    pid_t pid = ::fork();
+    if (pid != 0)
+    {
+        int status = 0;
+        ::waitpid(pid, &status, 0);
+        return;
+    }
+
+    using clock = std::chrono::high_resolution_clock;
+    long base = peakKiB();
+    std::mt19937_64 rng(5);
+    double worst = 0;
+
+    auto t0 = clock::now();
+    {
+        Map map;
+        auto last = t0;
+        for (size_t i = 0; i < N; ++i)
+        {
+            map.insert(rng(), i);
+            if ((i & 63) == 0)
+            {
+                // every 64th insert is timed; rehash pauses stand out
+                auto now = clock::now();
+                worst = std::max(worst,
+                                 std::chrono::duration<double, std::milli>(
+                                     now - last)
+                                     .count());
+                last = clock::now();
+            }
+        }
+    }
+    auto t1 = clock::now();
+
+    std::printf("[BENCH] %-15s %zu inserts: %.0f ns/op, slowest 64-insert "
+                "window %.2f ms, peak %.0f MiB\n",
+                name, N,
+                std::chrono::duration<double, std::nano>(t1 - t0).count() / N,
+                worst, (peakKiB() - base) / 1024.0);
+    std::fflush(stdout);
+    ::_exit(0);
+}
+
+int main()
+{
+    unit_tests();
+    flooding_tests();
+    bench_growth<EHash<uint64_t, uint64_t>>("EHash", 8'000'000);
+    bench_growth<ExtendibleEHash<uint64_t, uint64_t>>("ExtendibleEHash",
+                                                      8'000'000);
+    return 0;
+}
@@ -0,0 +1,172 @@
+/*!
+ * \file    tests/test_hopscotch.cpp
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   unit tests for HopscotchEHash and a benchmark at high load,
+ *          compared against EHash.
+ */
+
+#include "../lib/EHash.h"
+#include "../lib/HopscotchEHash.h"
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*!
+ * \brief   random operations against std::unordered_map, growing from a
+ *          tiny table.
+ *
+ * \note    will abort if any test fails.
+ */
+void unit_tests()
+{
+    HopscotchEHash<std::string, int> hmap;
+    std::unordered_map<std::string, int> ref;
+
+    std::mt19937_64 rng(17);
+    for (int i = 0; i < 300'000; ++i)
+    {
+        std::string key = "k" + std::to_string(rng() % 60'000);
+        if (rng() % 4)
+        {
+            hmap.insert(key, i);
+            ref[key] = i;
+        }
+        else
+        {
+            bool removed = hmap.remove(key);
+            assert(removed == (ref.erase(key) == 1));
+        }
+    }
+
+    assert(hmap.size() == ref.size());
+    for (auto& [k, v] : ref) assert(hmap.find(k) && *hmap.find(k) == v);
+    assert(hmap.find("missing") == nullptr);
+
+    size_t seen = 0;
+    hmap.forEach([&](const std::string& k, int v) { seen += ref.at(k) == v; });
+    assert(seen == ref.size());
+
+    // filled to 0.98 of a fixed table: neighborhoods get crowded
+    HopscotchEHash<uint64_t, uint64_t> full(1 << 16);
+    full.setMaxLoad(1.0f);
+    for (uint64_t i = 0; i < (1 << 16) * 98 / 100; ++i) full.insert(i, i);
+    for (uint64_t i = 0; i < (1 << 16) * 98 / 100; ++i) assert(*full.find(i) == i);
+
+    std::cout << "[TEST] all HopscotchEHash unit tests passed!\n";
+}
+
+/*!
+ * \brief   key whose hash is constant, so every key has the same home.
+ */
+struct Collide
+{
+    uint64_t id;
+    uint8_t pad = 0; // not batch hashable, so std::hash is used
+    bool operator==(const Collide& o) const { return id == o.id; }
+};
+
+template<> struct std::hash<Collide>
+{
+    size_t operator()(const Collide&) const { return 7; }
+};
+
+/*!
+ * \brief   keys that crowd one home go to the overflow list instead of
+ *          doubling the table without end.
+ *
+ * \note    will abort if any test fails.
+ */
+void collision_tests()
+{
+    using Map = HopscotchEHash<Collide, uint64_t>;
+    const uint64_t N = 5'000;
+    Map hmap;
+    for (uint64_t i = 0; i < N; ++i) hmap.insert({i}, i);
+    assert(hmap.size() == N && hmap.overflowCount() == N - Map::H);
+    assert(hmap.capacity() <= 4 * N); // grown by load, not per failure
+
+    for (uint64_t i = 0; i < N; i += 2) hmap.insert({i}, i * 3);
+    for (uint64_t i = 0; i < N; i += 3)
+    {
+        bool removed = hmap.remove({i});
+        assert(removed);
+    }
+    bool removed = hmap.remove({N});
+    assert(!removed && hmap.size() == N - (N + 2) / 3);
+    for (uint64_t i = 0; i < N; ++i)
+    {
+        uint64_t* v = hmap.find({i});
+        if (i % 3 == 0) assert(!v);
+        else assert(v && *v == (i % 2 ? i : i * 3));
+    }
+    size_t seen = 0;
+    hmap.forEach([&](const Collide&, uint64_t) { seen++; });
+    assert(seen == hmap.size());
+
+    // seeded maps of ordinary keys never need the list
+    HopscotchEHash<uint64_t, uint64_t> a, b;
+    assert(a.seed() != b.seed());
+    for (uint64_t i = 0; i < 100'000; ++i) a.insert(i, i);
+    assert(a.overflowCount() == 0);
+    for (uint64_t i = 0; i < 100'000; ++i) assert(*a.find(i) == i);
+
+    std::cout << "[TEST] all HopscotchEHash collision tests passed!\n";
+}
+
+/*!
+ * \brief   insert and lookup cost with the table at a given load.
+ *
+ * \param   cap  table capacity (buckets)
+ * \param   load fraction of cap filled
+ */
+void bench_load(size_t cap, double load)
+{
+    using clock = std::chrono::high_resolution_clock;
+    size_t N = size_t(cap * load);
+
+    std::vector<uint64_t> keys(N), misses(N);
+    std::mt19937_64 rng(21);
+    for (auto& k : keys) k = rng();
+    for (auto& k : misses) k = rng();
+
+    auto run = [&](auto& map, const char* name) {
+        auto t0 = clock::now();
+        for (uint64_t k : keys) map.insert(k, k);
+        auto t1 = clock::now();
+        uint64_t sum = 0;
+        for (uint64_t k : keys) sum += *map.find(k);
+        auto t2 = clock::now();
+        for (uint64_t k : misses) sum += map.find(k) != nullptr;
+        auto t3 = clock::now();
+
+        auto ns = [N](auto a, auto b) {
+            return std::chrono::duration<double, std::nano>(b - a).count() / N;
+        };
+        std::printf("[BENCH] %-14s load %.2f, %zu keys: insert %.1f ns/op, "
+                    "find hit %.1f ns/op, find miss %.1f ns/op (%llu)\n",
+                    name, load, N, ns(t0, t1), ns(t1, t2), ns(t2, t3),
+                    (unsigned long long)(sum & 1));
+    };
+
+    EHash<uint64_t, uint64_t> emap(cap);
+    run(emap, "EHash");
+    HopscotchEHash<uint64_t, uint64_t> hmap(cap);
+    run(hmap, "HopscotchEHash");
+}
+
+int main()
+{
+    unit_tests();
+    collision_tests();
+    bench_load(1 << 22, 0.5);
+    bench_load(1 << 22, 0.9);
+    return 0;
+}
@@ -0,0 +1,231 @@
+/*!
+ * \file    tests/test_hugepages.cpp
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   unit tests for HugePages and a lookup benchmark of EHash with
+ *          4 KiB and 2 MiB pages, counting dTLB misses.
+ */
+
+#include "../lib/EHash.h"
+#include "../lib/EHashHugePages.h"
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <linux/perf_event.h>
+#include <random>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using ehash::HugePages;
+
+/*!
+ * \brief   map/unmap in every mode, the allocator on both sides of its
+ *          threshold, and maps built on huge pages.
+ *
+ * \note    will abort if any test fails.
+ */
+void unit_tests()
+{
+    for (auto mode : {HugePages::Mode::Off, HugePages::Mode::Transparent,
+                      HugePages::Mode::Explicit})
+    {
+        HugePages::setMode(mode);
+        size_t bytes = 3 * HugePages::PageBytes + 1;
+        auto* p = static_cast<unsigned char*>(HugePages::map(bytes));
+        assert(p);
+        if (mode != HugePages::Mode::Off)
+        {
+            assert(reinterpret_cast<uintptr_t>(p) % HugePages::PageBytes == 0);
+        }
+        assert(p[0] == 0 && p[bytes - 1] == 0);
+        std::memset(p, 0xab, bytes);
+        HugePages::unmap(p, bytes);
+
+        // under and over the allocator's threshold
+        std::vector<uint64_t, ehash::HugePageAllocator<uint64_t>> small(100, 7);
+        std::vector<uint64_t, ehash::HugePageAllocator<uint64_t>> big(1 << 20, 7);
+        assert(small.back() == 7 && big.back() == 7);
+        assert(reinterpret_cast<uintptr_t>(big.data()) % 4096 == 0);
+
+        EHash<uint64_t, uint64_t> map;
+        for (uint64_t i = 0; i < 500'000; ++i) map.insert(i, i * 3);
+        EHash<uint64_t, uint64_t> copy = map;
+        for (uint64_t i = 0; i < 500'000; i += 2) map.remove(i);
+        for (uint64_t i = 0; i < 500'000; ++i)
+        {
+            assert(*copy.find(i) == i * 3);
+            assert((map.find(i) != nullptr) == (i % 2 == 1));
+        }
+    }
+    HugePages::setMode(HugePages::Mode::Transparent);
+
+    std::cout << "[TEST] all HugePages unit tests passed!\n";
+}
+
+/*!
+ * \brief   hardware counter of this thread, user space only.
+ *
+ * \note    opening fails in containers and VMs without a PMU, or with
+ *          perf_event_paranoid > 2; value() is -1 then.
+ */
+class PerfCounter
+{
+    int fd = -1;
+
+  public:
+    PerfCounter(uint32_t type, uint64_t config)
+    {
+        perf_event_attr attr{};
+        attr.size = sizeof attr;
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = int(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    ~PerfCounter()
+    {
+        if (fd >= 0) ::close(fd);
+    }
+
+    void start()
+    {
+        if (fd < 0) return;
+        ::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    void stop()
+    {
+        if (fd >= 0) ::ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+
+    long long value() const
+    {
+        long long v = 0;
+        if (fd < 0 || ::read(fd, &v, sizeof v) != sizeof v) return -1;
+        return v;
+    }
+};
+
+/*!
+ * \brief   dTLB read event: result is PERF_COUNT_HW_CACHE_RESULT_*.
+ */
+uint64_t dtlbRead(uint64_t result)
+{
+    return PERF_COUNT_HW_CACHE_DTLB | PERF_COUNT_HW_CACHE_OP_READ << 8 |
+           result << 16;
+}
+
+/*!
+ * \brief   a line of /proc/self/smaps_rollup in KiB, e.g. the memory on
+ *          transparent ("AnonHugePages") or hugetlbfs ("Private_Hugetlb")
+ *          huge pages.
+ */
+long rollupKiB(const char* field)
+{
+    std::string format = std::string(field) + ": %ld";
+    long kib = 0;
+    if (FILE* f = std::fopen("/proc/self/smaps_rollup", "r"))
+    {
+        char line[256];
+        while (std::fgets(line, sizeof line, f))
+        {
+            if (std::sscanf(line, format.c_str(), &kib) == 1) break;
+        }
+        std::fclose(f);
+    }
+    return kib;
+}
+
+/*!
+ * \brief   build a map of N elements in a child process with the given
+ *          mode and time random lookups, half of them misses.
+ */
+void bench_lookups(HugePages::Mode mode, const char* name, size_t N)
+{
+    std::cout.flush(); // or the child prints it again
+    pid_t pid = ::fork();
+    if (pid != 0)
+    {
+        int status = 0;
+        ::waitpid(pid, &status, 0);
+        return;
+    }
+
+    using clock = std::chrono::high_resolution_clock;
+    HugePages::setMode(mode);
+
+    std::mt19937_64 rng(11);
+    EHash<uint64_t, uint64_t> map;
+    auto t0 = clock::now();
+    for (size_t i = 0; i < N; ++i) map.insert(rng(), i);
+    auto t1 = clock::now();
+
+    size_t Q = 4'000'000;
+    std::vector<uint64_t> queries(Q);
+    std::mt19937_64 again(11);
+    for (size_t i = 0; i < Q; ++i)
+    {
+        uint64_t hit = again();
+        queries[i] = i % 2 ? hit : rng();
+        if (i + 1 < Q && Q < N) again.discard(N / Q - 1);
+    }
+
+    PerfCounter misses(PERF_TYPE_HW_CACHE,
+                       dtlbRead(PERF_COUNT_HW_CACHE_RESULT_MISS));
+    PerfCounter loads(PERF_TYPE_HW_CACHE,
+                      dtlbRead(PERF_COUNT_HW_CACHE_RESULT_ACCESS));
+    misses.start();
+    loads.start();
+    auto t2 = clock::now();
+    size_t found = 0;
+    for (uint64_t q : queries) found += map.find(q) != nullptr;
+    auto t3 = clock::now();
+    misses.stop();
+    loads.stop();
+
+    char rate[64] = "n/a";
+    long long m = misses.value(), l = loads.value();
+    if (m >= 0 && l > 0)
+    {
+        std::snprintf(rate, sizeof rate, "%.2f misses/find, %.2f%% of loads",
+                      double(m) / Q, 100.0 * m / l);
+    }
+    else if (m >= 0)
+    {
+        std::snprintf(rate, sizeof rate, "%.2f misses/find", double(m) / Q);
+    }
+
+    std::printf("[BENCH] %-11s %zu elements: insert %.0f ns/op, find %.1f "
+                "ns/op (%zu found), dTLB %s, huge pages %ld MiB THP + %ld MiB "
+                "hugetlbfs\n",
+                name, N,
+                std::chrono::duration<double, std::nano>(t1 - t0).count() / N,
+                std::chrono::duration<double, std::nano>(t3 - t2).count() / Q,
+                found, rate, rollupKiB("AnonHugePages") / 1024,
+                rollupKiB("Private_Hugetlb") / 1024);
+    std::fflush(stdout);
+    ::_exit(0);
+}
+
+int main(int argc, char** argv)
+{
+    size_t N = argc > 1 ? std::stoull(argv[1]) : 20'000'000;
+
+    unit_tests();
+    bench_lookups(HugePages::Mode::Off, "4 KiB", N);
+    bench_lookups(HugePages::Mode::Transparent, "THP", N);
+    bench_lookups(HugePages::Mode::Explicit, "hugetlbfs", N);
+    return 0;
+}
@@ -0,0 +1,156 @@
+/*!
+ * \file    tests/test_linear.cpp
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   unit tests for LinearEHash and an insert tail latency benchmark
+ *          against EHash's doubling.
+ */
+
+#include "../lib/EHash.h"
+#include "../lib/LinearEHash.h"
+#include "../src/Histogram.h"
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*!
+ * \brief   random operations against std::unordered_map, through several
+ *          split rounds.
+ *
+ * \note    will abort if any test fails.
+ */
+void unit_tests()
+{
+    LinearEHash<std::string, int> lmap(4);
+    std::unordered_map<std::string, int> ref;
+
+    std::mt19937_64 rng(13);
+    for (int i = 0; i < 300'000; ++i)
+    {
+        std::string key = "k" + std::to_string(rng() % 60'000);
+        if (rng() % 4)
+        {
+            lmap.insert(key, i);
+            ref[key] = i;
+        }
+        else
+        {
+            bool removed = lmap.remove(key);
+            assert(removed == (ref.erase(key) == 1));
+        }
+    }
+
+    assert(lmap.size() == ref.size());
+    for (auto& [k, v] : ref) assert(lmap.find(k) && *lmap.find(k) == v);
+    assert(lmap.find("missing") == nullptr);
+
+    size_t seen = 0;
+    lmap.forEach([&](const std::string& k, int v) { seen += ref.at(k) == v; });
+    assert(seen == ref.size());
+
+    std::cout << "[TEST] all LinearEHash unit tests passed!\n";
+}
+
+/*!
+ * \brief   key whose std::hash keeps the low 32 bits zero, as a weak hash
+ *          of aligned addresses or shifted ids does.
+ */
+struct Aligned
+{
+    uint64_t id;
+    uint8_t pad = 0; // not batch hashable, so std::hash is used
+    bool operator==(const Aligned& o) const { return id == o.id; }
+};
+
+template<> struct std::hash<Aligned>
+{
+    size_t operator()(const Aligned& k) const { return k.id << 32; }
+};
+
+/*!
+ * \brief   hashes are seeded and mixed: keys whose raw hashes agree on
+ *          every bucket bit still spread over the table.
+ *
+ * \note    will abort if any test fails.
+ */
+void seed_tests()
+{
+    LinearEHash<uint64_t, uint64_t> a, b;
+    assert(a.seed() != b.seed());
+
+    // unmixed, every key would land in bucket 0 and each insert would
+    // walk all the earlier ones: ~10^9 node visits instead of ~10^5
+    const uint64_t N = 50'000;
+    LinearEHash<Aligned, uint64_t> lmap;
+    auto t0 = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < N; ++i) lmap.insert({i}, i);
+    for (uint64_t i = 0; i < N; ++i) assert(*lmap.find({i}) == i);
+    auto elapsed = std::chrono::steady_clock::now() - t0;
+    assert(lmap.size() == N && elapsed < std::chrono::seconds(1));
+
+    // a given seed gives the same layout
+    LinearEHash<uint64_t, uint64_t> c(8, 42), d(8, 42);
+    for (uint64_t i = 0; i < 1'000; ++i)
+    {
+        c.insert(i, i);
+        d.insert(i, i);
+    }
+    std::vector<uint64_t> oc, od;
+    c.forEach([&](const uint64_t& k, uint64_t) { oc.push_back(k); });
+    d.forEach([&](const uint64_t& k, uint64_t) { od.push_back(k); });
+    assert(c.seed() == 42 && oc == od);
+
+    std::cout << "[TEST] all LinearEHash seed tests passed!\n";
+}
+
+/*!
+ * \brief   latency of every single insert while a map grows to N.
+ */
+template<typename Map> void bench_tail(const char* name, size_t N)
+{
+    using clock = std::chrono::steady_clock;
+    Histogram hist;
+    std::mt19937_64 rng(9);
+
+    auto t0 = clock::now();
+    {
+        Map map;
+        for (size_t i = 0; i < N; ++i)
+        {
+            uint64_t key = rng();
+            auto a = clock::now();
+            map.insert(key, i);
+            auto b = clock::now();
+            hist.record(uint64_t(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(b - a)
+                    .count()));
+        }
+    }
+    auto t1 = clock::now();
+
+    std::printf("[BENCH] %-11s %zu inserts: %.0f ns/op, p50 %llu ns, p99 %llu "
+                "ns, p99.9 %llu ns, p99.99 %llu ns, max %.2f ms\n",
+                name, N,
+                std::chrono::duration<double, std::nano>(t1 - t0).count() / N,
+                (unsigned long long)hist.percentile(50),
+                (unsigned long long)hist.percentile(99),
+                (unsigned long long)hist.percentile(99.9),
+                (unsigned long long)hist.percentile(99.99),
+                hist.max() / 1e6);
+}
+
+int main()
+{
+    unit_tests();
+    seed_tests();
+    bench_tail<EHash<uint64_t, uint64_t>>("EHash", 4'000'000);
+    bench_tail<LinearEHash<uint64_t, uint64_t>>("LinearEHash", 4'000'000);
+    return 0;
+}
@@ -0,0 +1,140 @@
+/*!
+ * \file    tests/test_numa.cpp
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   unit tests for Numa and a lookup benchmark of EHash for every
+ *          (memory node, cpu node) pair.
+ */
+
+#include "../lib/EHash.h"
+#include "../lib/EHashNuma.h"
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <sched.h>
+#include <sys/mman.h>
+#include <thread>
+#include <vector>
+
+using ehash::Numa;
+
+/*!
+ * \brief   list parsing, topology, and placement calls, which must succeed
+ *          on any machine.
+ *
+ * \note    will abort if any test fails.
+ */
+void unit_tests()
+{
+    assert((Numa::parseList("0\n") == std::vector<int>{0}));
+    assert((Numa::parseList("0-3,8,10-11\n") ==
+            std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+    assert(Numa::parseList("").empty());
+    assert(Numa::parseList("x").empty());
+
+    assert(Numa::nodes() >= 1);
+    int first = Numa::online().front();
+    assert(Numa::isOnline(first) && !Numa::isOnline(-1));
+    assert(!Numa::preferNode(-1) && !Numa::preferNode(Numa::MaxNodes));
+
+    for (int node : Numa::online())
+    {
+        bool ok = Numa::preferNode(node);
+        assert(ok);
+
+        // pages touched after the call land on the node
+        size_t bytes = 8 << 20;
+        auto* p = static_cast<char*>(::mmap(nullptr, bytes,
+                                            PROT_READ | PROT_WRITE,
+                                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        assert(p != MAP_FAILED);
+        for (size_t i = 0; i < bytes; i += 4096) p[i] = 1;
+        int at = Numa::nodeOf(p + bytes / 2);
+        assert(at == -1 || at == node);
+
+        ok = Numa::bind(p, bytes, first);
+        assert(ok);
+        at = Numa::nodeOf(p);
+        assert(at == -1 || at == first);
+        ::munmap(p, bytes);
+
+        EHash<uint64_t, uint64_t> map;
+        for (uint64_t i = 0; i < 100'000; ++i) map.insert(i, i);
+        for (uint64_t i = 0; i < 100'000; ++i) assert(*map.find(i) == i);
+    }
+    Numa::preferNode(first);
+
+    int cpu = ::sched_getcpu();
+    assert(cpu < 0 || Numa::isOnline(Numa::nodeOfCpu(cpu)));
+
+    std::cout << "[TEST] all Numa unit tests passed!\n";
+}
+
+/*!
+ * \brief   run the calling thread on the cpus of node.
+ */
+bool runOn(int node)
+{
+    std::vector<int> cpus = Numa::cpusOf(node);
+    if (cpus.empty()) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int c : cpus) CPU_SET(c, &set);
+    return ::sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+/*!
+ * \brief   find latency of an N-element map allocated on each node, read
+ *          from each node; the diagonal is local.
+ */
+void benchmark(size_t N)
+{
+    using clock = std::chrono::high_resolution_clock;
+    std::printf("[BENCH] %zu node(s): %s\n", Numa::nodes(),
+                Numa::nodes() > 1 ? "remote pairs off the diagonal"
+                                  : "single node, local only");
+
+    std::vector<uint64_t> keys(N);
+    std::mt19937_64 rng(21);
+    for (auto& k : keys) k = rng();
+    std::vector<uint64_t> queries(2'000'000);
+    for (auto& q : queries) q = keys[rng() % N];
+
+    for (int mem : Numa::online())
+    {
+        // a fresh thread, so its pool slabs are allocated under the policy
+        std::thread([&] {
+            runOn(mem);
+            Numa::preferNode(mem);
+            EHash<uint64_t, uint64_t> map;
+            for (uint64_t k : keys) map.insert(k, k);
+
+            for (int cpu : Numa::online())
+            {
+                if (!runOn(cpu) && cpu != mem) continue;
+                auto t0 = clock::now();
+                uint64_t sum = 0;
+                for (uint64_t q : queries) sum += *map.find(q);
+                auto t1 = clock::now();
+                std::printf("[BENCH] memory on node %d (page at node %d), "
+                            "cpu on node %d: find %.1f ns/op (%llu)\n",
+                            mem, Numa::nodeOf(map.find(keys[0])), cpu,
+                            std::chrono::duration<double, std::nano>(t1 - t0)
+                                    .count() /
+                                queries.size(),
+                            (unsigned long long)(sum & 0xff));
+            }
+        }).join();
+    }
+}
+
+int main()
+{
+    unit_tests();
+    benchmark(4'000'000);
+    return 0;
+}
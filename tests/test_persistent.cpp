@@ -0,0 +1,254 @@
+/*!
+ * \file    tests/test_persistent.cpp
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   unit tests and benchmarks for PersistentEHash,
+ *          compared against EHash.
+ */
+
+#include "../lib/EHash.h"
+#include "../lib/PersistentEHash.h"
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*!
+ * \brief   key whose hash collides in all 64 bits with a quarter of all keys.
+ */
+struct BadKey
+{
+    uint64_t id;
+    uint64_t pad = 0;
+    bool operator==(const BadKey& o) const { return id == o.id; }
+};
+
+template<> struct std::hash<BadKey>
+{
+    size_t operator()(const BadKey& k) const { return k.id & 3; }
+};
+
+/*!
+ * \brief   check a version against a reference map.
+ */
+template<typename K, typename V, typename Ref>
+void expect(const PersistentEHash<K, V>& map, const Ref& ref)
+{
+    assert(map.size() == ref.size());
+    for (auto& [k, v] : ref) assert(map.find(k) && *map.find(k) == v);
+
+    size_t seen = 0;
+    map.forEach([&](const K& k, const V& v) {
+        assert(ref.at(k) == v);
+        ++seen;
+    });
+    assert(seen == ref.size());
+}
+
+/*!
+ * \brief   random operations against std::unordered_map; every version
+ *          keeps its contents.
+ *
+ * \note    will abort if any test fails.
+ */
+void unit_tests()
+{
+    using Map = PersistentEHash<std::string, int>;
+    using Ref = std::unordered_map<std::string, int>;
+
+    Map empty;
+    Map one = empty.insert("apple", 1);
+    assert(empty.size() == 0 && empty.find("apple") == nullptr);
+    assert(one.size() == 1 && *one.find("apple") == 1);
+    assert(one.remove("banana").size() == 1);
+    assert(one.remove("apple").empty());
+
+    std::vector<Map> versions{empty};
+    std::vector<Ref> refs{Ref{}};
+    std::mt19937_64 rng(7);
+    for (int i = 0; i < 20'000; ++i)
+    {
+        std::string key = "k" + std::to_string(rng() % 3000);
+        Ref ref = refs.back();
+        if (rng() % 3)
+        {
+            versions.push_back(versions.back().insert(key, i));
+            ref[key] = i;
+        }
+        else
+        {
+            versions.push_back(versions.back().remove(key));
+            ref.erase(key);
+        }
+        if (i % 1000 == 0)
+        {
+            refs.push_back(std::move(ref));
+        }
+        else
+        {
+            refs.back() = std::move(ref);
+            versions.erase(versions.end() - 2); // keep every 1000th version
+        }
+    }
+    for (size_t v = 0; v < versions.size(); ++v) expect(versions[v], refs[v]);
+
+    // full 64-bit collisions end up in collision nodes
+    PersistentEHash<BadKey, int> bad;
+    std::unordered_map<uint64_t, int> badRef;
+    for (uint64_t i = 0; i < 200; ++i) bad = bad.insert({i}, int(i));
+    for (uint64_t i = 0; i < 200; i += 3) bad = bad.remove({i});
+    for (uint64_t i = 0; i < 200; ++i)
+    {
+        if (i % 3) badRef[i] = int(i);
+    }
+    assert(bad.size() == badRef.size());
+    for (auto& [k, v] : badRef) assert(*bad.find({k}) == v);
+    assert(bad.find({3}) == nullptr && bad.find({999}) == nullptr);
+
+    std::cout << "[TEST] all PersistentEHash unit tests passed!\n";
+}
+
+/*!
+ * \brief   transients build in place without touching the version they
+ *          started from, and versions cross threads.
+ *
+ * \note    will abort if any test fails.
+ */
+void transient_tests()
+{
+    using Map = PersistentEHash<uint64_t, uint64_t>;
+
+    auto t = Map().transient();
+    for (uint64_t i = 0; i < 100'000; ++i) t.insert(i, i);
+    Map base = t.persistent();
+    assert(t.size() == 0 && base.size() == 100'000);
+
+    auto edit = base.transient();
+    size_t removed = 0;
+    for (uint64_t i = 0; i < 100'000; i += 2) removed += edit.remove(i);
+    for (uint64_t i = 1; i < 100'000; i += 2) edit.insert(i, 0);
+    removed += edit.remove(0);
+    assert(removed == 50'000);
+    Map odd = edit.persistent();
+
+    assert(odd.size() == 50'000);
+    for (uint64_t i = 0; i < 100'000; ++i)
+    {
+        assert(*base.find(i) == i);
+        assert(i % 2 ? *odd.find(i) == 0 : odd.find(i) == nullptr);
+    }
+
+    // drained down to nothing and rebuilt
+    auto drain = odd.transient();
+    for (uint64_t i = 1; i < 100'000; i += 2) drain.remove(i);
+    assert(drain.size() == 0);
+    drain.insert(5, 5);
+    assert(*drain.persistent().find(5) == 5);
+
+    // versions derived from and dropped on other threads
+    std::vector<std::thread> threads;
+    for (uint64_t id = 0; id < 4; ++id)
+    {
+        threads.emplace_back([base, id] {
+            Map mine = base;
+            for (uint64_t i = 0; i < 20'000; ++i)
+            {
+                mine = mine.insert(i, id).remove(i + 50'000);
+            }
+            assert(mine.size() == 80'000 && *mine.find(7) == id);
+        });
+    }
+    for (auto& th : threads) th.join();
+    assert(base.size() == 100'000 && *base.find(7) == 7);
+
+    std::cout << "[TEST] all PersistentEHash transient tests passed!\n";
+}
+
+/*!
+ * \brief   resident set size in bytes.
+ */
+size_t rss()
+{
+    long pages = 0;
+    if (FILE* f = std::fopen("/proc/self/statm", "r"))
+    {
+        if (std::fscanf(f, "%*d %ld", &pages) != 1) pages = 0;
+        std::fclose(f);
+    }
+    return size_t(pages) * 4096;
+}
+
+/*!
+ * \brief   build and lookup costs against EHash, and the memory of many
+ *          live versions.
+ *
+ * \param   N elements
+ */
+void benchmark(size_t N)
+{
+    using Map = PersistentEHash<uint64_t, uint64_t>;
+    using clock = std::chrono::high_resolution_clock;
+    auto ns = [N](auto t0, auto t1) {
+        return std::chrono::duration<double, std::nano>(t1 - t0).count() / N;
+    };
+
+    std::vector<uint64_t> keys(N);
+    std::mt19937_64 rng(42);
+    for (auto& k : keys) k = rng();
+
+    auto t0 = clock::now();
+    EHash<uint64_t, uint64_t> emap;
+    for (uint64_t k : keys) emap.insert(k, k);
+    auto t1 = clock::now();
+    Map persistent;
+    for (uint64_t k : keys) persistent = persistent.insert(k, k);
+    auto t2 = clock::now();
+    auto t = Map().transient();
+    for (uint64_t k : keys) t.insert(k, k);
+    Map built = t.persistent();
+    auto t3 = clock::now();
+
+    std::printf("[BENCH] build %zu: EHash %.1f ns/op, version per insert "
+                "%.1f ns/op, transient %.1f ns/op\n",
+                N, ns(t0, t1), ns(t1, t2), ns(t2, t3));
+
+    std::shuffle(keys.begin(), keys.end(), rng);
+    uint64_t sum = 0;
+    t0 = clock::now();
+    for (uint64_t k : keys) sum += *emap.find(k);
+    t1 = clock::now();
+    for (uint64_t k : keys) sum += *built.find(k);
+    t2 = clock::now();
+    std::printf("[BENCH] find: EHash %.1f ns/op, PersistentEHash %.1f ns/op "
+                "(%llu)\n",
+                ns(t0, t1), ns(t1, t2), (unsigned long long)(sum & 1));
+
+    // 1000 live versions, each one insert apart
+    constexpr size_t Versions = 1000;
+    size_t before = rss();
+    std::vector<Map> history{built};
+    for (size_t i = 1; i < Versions; ++i)
+    {
+        history.push_back(history.back().insert(rng(), i));
+    }
+    size_t grown = rss() - before;
+    std::printf("[BENCH] %zu versions of a %zu-element map: %.1f KiB each "
+                "(one full map: ~%.1f MiB)\n",
+                Versions, N, grown / 1024.0 / Versions,
+                double(N) * 16 / 1024 / 1024);
+}
+
+int main()
+{
+    unit_tests();
+    transient_tests();
+    benchmark(1'000'000);
+    return 0;
+}
@@ -0,0 +1,240 @@
+/*!
+ * \file    tests/test_server.cpp
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   end-to-end tests of the server over a unix socket.
+ *
+ * \note    the server runs in a child process, so a test can kill it the
+ *          way a crash would and restart it from its WAL directory.
+ */
+
+#include "../src/Server.h"
+#include <cassert>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+/*!
+ * \brief   a server in a child process; killed when it goes out of scope.
+ */
+struct Child
+{
+    pid_t pid = -1;
+    int fd = -1; //!< connection to it, -1 if it never came up
+
+    Child(const ServerOptions& opts)
+    {
+        pid = ::fork();
+        if (pid == 0)
+        {
+            Server server(opts);
+            if (!server.start()) ::_exit(1);
+            server.run();
+            ::_exit(0);
+        }
+
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, opts.unixPath.c_str(),
+                     sizeof(addr.sun_path) - 1);
+        for (int i = 0; i < 500; ++i)
+        {
+            int status;
+            if (::waitpid(pid, &status, WNOHANG) == pid)
+            {
+                pid = -1; // start() failed
+                return;
+            }
+            fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (::connect(fd, reinterpret_cast<sockaddr*>(&addr),
+                          sizeof(addr)) == 0)
+            {
+                return;
+            }
+            ::close(fd);
+            fd = -1;
+            ::usleep(10'000);
+        }
+    }
+
+    ~Child() { kill(); }
+
+    /*!
+     * \brief   SIGKILL, as a crash would; nothing gets to flush.
+     */
+    void kill()
+    {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+        if (pid <= 0) return;
+        ::kill(pid, SIGKILL);
+        ::waitpid(pid, nullptr, 0);
+        pid = -1;
+    }
+
+    /*!
+     * \brief   send requests in one pipelined write and read back up to
+     *          lines reply lines (fewer if the server hangs up).
+     */
+    std::vector<std::string> talk(const std::vector<std::string>& requests,
+                                  size_t lines)
+    {
+        std::string out;
+        for (const std::string& r : requests) out += r + "\n";
+        for (size_t pos = 0; pos < out.size();)
+        {
+            ssize_t n = ::write(fd, out.data() + pos, out.size() - pos);
+            if (n <= 0) break;
+            pos += size_t(n);
+        }
+
+        std::string in;
+        std::vector<std::string> replies;
+        char buf[65536];
+        while (replies.size() < lines)
+        {
+            ssize_t n = ::read(fd, buf, sizeof(buf));
+            if (n <= 0) break;
+            in.append(buf, size_t(n));
+            for (size_t nl; (nl = in.find('\n')) != std::string::npos;)
+            {
+                replies.push_back(in.substr(0, nl));
+                in.erase(0, nl + 1);
+            }
+        }
+        return replies;
+    }
+};
+
+/*!
+ * \brief   pipelined commands across shards, then recovery after a crash.
+ *
+ * \note    will abort if any test fails.
+ */
+void server_tests(IoBackend io, const std::string& dir, const char* name)
+{
+    std::string wal = dir + "/" + name;
+    std::filesystem::create_directories(wal);
+
+    ServerOptions opts;
+    opts.threads = 3;
+    opts.pin = false;
+    opts.numa = false;
+    opts.buckets = 64;
+    opts.io = io;
+    opts.walDir = wal;
+    opts.walSyncUs = 200;
+    opts.snapshotBytes = 16 << 10; // a snapshot plus a log tail to recover
+
+    // a socket per start: a killed server's rings are torn down after it
+    // is reaped, and a listener held by one could still take a connect
+    int starts = 0;
+    auto socketPath = [&] {
+        return wal + "." + std::to_string(starts++) + ".sock";
+    };
+
+    constexpr int N = 2000;
+    auto key = [](int i) { return "k" + std::to_string(i); };
+    auto val = [](int i) { return "v" + std::to_string(i * 7); };
+    auto get = [&](int i) { return i % 5 ? "VALUE " + val(i) : "NIL"; };
+
+    {
+        opts.unixPath = socketPath();
+        Child server(opts);
+        if (server.pid < 0)
+        {
+            std::cout << "[TEST] " << name << " backend unavailable, skipped\n";
+            return;
+        }
+        assert(server.fd >= 0);
+
+        // SETs, then DELs of every 5th key, GETs and an MGET behind them in
+        // the same pipeline: each must see the writes queued before it
+        std::vector<std::string> req, want;
+        for (int i = 0; i < N; ++i)
+        {
+            req.push_back("SET " + key(i) + " " + val(i));
+            want.push_back("OK");
+        }
+        for (int i = 0; i < N; i += 5)
+        {
+            req.push_back("DEL " + key(i));
+            want.push_back("1");
+        }
+        req.push_back("DEL nope");
+        want.push_back("0");
+
+        std::string mget = "MGET";
+        for (int i = 0; i < 10; ++i)
+        {
+            req.push_back("GET " + key(i));
+            want.push_back(get(i));
+            mget += " " + key(i);
+        }
+        req.push_back(mget);
+        want.push_back("*10");
+        for (int i = 0; i < 10; ++i) want.push_back(get(i));
+        req.push_back("PING");
+        want.push_back("PONG");
+
+        auto replies = server.talk(req, want.size());
+        assert(replies == want);
+
+        // every write above was acknowledged: a crash must not lose one
+        server.kill();
+    }
+
+    {
+        opts.unixPath = socketPath();
+        Child server(opts);
+        assert(server.pid > 0 && server.fd >= 0);
+
+        std::vector<std::string> req, want;
+        for (int i = 0; i < N; ++i)
+        {
+            req.push_back("GET " + key(i));
+            want.push_back(get(i));
+        }
+
+        std::string mget = "MGET";
+        std::vector<std::string> values;
+        for (int i = 0; i < N; i += 97)
+        {
+            mget += " " + key(i);
+            values.push_back(get(i));
+        }
+        req.push_back(mget);
+        want.push_back("*" + std::to_string(values.size()));
+        want.insert(want.end(), values.begin(), values.end());
+
+        auto replies = server.talk(req, want.size());
+        assert(replies == want);
+    }
+
+    std::cout << "[TEST] all " << name << " server tests passed!\n";
+}
+
+int main()
+{
+    char tmpl[] = "/tmp/test_server.XXXXXX";
+    const char* dir = ::mkdtemp(tmpl);
+    assert(dir);
+    std::signal(SIGPIPE, SIG_IGN); // as main.cpp: a gone peer is an error
+
+    server_tests(IoBackend::Epoll, dir, "epoll");
+    server_tests(IoBackend::Uring, dir, "io_uring");
+
+    std::filesystem::remove_all(dir);
+    return 0;
+}
@@ -0,0 +1,177 @@
+/*!
+ * \file    tests/test_snapshot.cpp
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   unit tests and writer pause benchmark for EHash snapshots.
+ */
+
+#include "../lib/EHashSnapshot.h"
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
+/*!
+ * \brief   snapshots are point-in-time and round trip.
+ *
+ * \note    will abort if any test fails.
+ */
+void unit_tests(const std::string& path)
+{
+    EHash<uint64_t, std::string> emap;
+    std::unordered_map<uint64_t, std::string> expected;
+    for (uint64_t i = 0; i < 50'000; ++i)
+    {
+        emap.insert(i, "v" + std::to_string(i));
+        expected[i] = "v" + std::to_string(i);
+    }
+
+    pid_t pid = ehash::snapshotInBackground(emap, path, 42);
+    assert(pid > 0);
+
+    // mutations after fork() must not leak into the snapshot
+    for (uint64_t i = 0; i < 50'000; i += 2) emap.remove(i);
+    for (uint64_t i = 50'000; i < 60'000; ++i) emap.insert(i, "late");
+    ehash::SnapshotStatus st = ehash::snapshotStatus(pid, true);
+    assert(st == ehash::SnapshotStatus::Done);
+
+    EHash<uint64_t, std::string> loaded;
+    uint64_t tag = 0;
+    bool ok = ehash::loadSnapshot(path, loaded, tag);
+    assert(ok);
+    assert(tag == 42 && loaded.size() == expected.size());
+    for (auto& [k, v] : expected) assert(*loaded.find(k) == v);
+    assert(loaded.find(55'000) == nullptr);
+
+    // a missing snapshot is not an error, a cut one is
+    std::remove(path.c_str());
+    ok = ehash::loadSnapshot(path, loaded, tag);
+    assert(ok && tag == 0);
+
+    ok = ehash::writeSnapshot(emap, path, 7) &&
+         ::truncate(path.c_str(), 1000) == 0;
+    EHash<uint64_t, std::string> cut;
+    ok = ok && !ehash::loadSnapshot(path, cut, tag);
+    assert(ok);
+    std::remove(path.c_str());
+
+    std::cout << "[TEST] all EHash snapshot unit tests passed!\n";
+}
+
+/*!
+ * \brief   time the writer is blocked: synchronous write vs fork().
+ *
+ * \param   N elements in the map
+ */
+void bench_snapshot(const std::string& path, size_t N)
+{
+    EHash<uint64_t, uint64_t> emap(N);
+    for (uint64_t i = 0; i < N; ++i) emap.insert(i, i * 3);
+
+    auto t0 = std::chrono::high_resolution_clock::now();
+    ehash::writeSnapshot(emap, path, 0);
+    auto t1 = std::chrono::high_resolution_clock::now();
+    pid_t pid = ehash::snapshotInBackground(emap, path, 0);
+    auto t2 = std::chrono::high_resolution_clock::now();
+    ehash::snapshotStatus(pid, true);
+    auto t3 = std::chrono::high_resolution_clock::now();
+
+    using ms = std::chrono::duration<double, std::milli>;
+    std::cout << "[BENCH] snapshot of " << N << " elements: synchronous "
+              << ms(t1 - t0).count() << " ms blocked, fork "
+              << ms(t2 - t1).count() << " ms blocked ("
+              << ms(t3 - t1).count() << " ms until done)\n";
+    std::remove(path.c_str());
+}
+
+/*!
+ * \brief   MiB of this process mapped as transparent huge pages.
+ */
+long hugeMiB()
+{
+    char line[256];
+    long kb = 0;
+    FILE* f = std::fopen("/proc/self/smaps_rollup", "r");
+    while (f && std::fgets(line, sizeof line, f))
+    {
+        std::sscanf(line, "AnonHugePages: %ld", &kb);
+    }
+    if (f) std::fclose(f);
+    return kb >> 10;
+}
+
+/*!
+ * \brief   the body of bench_cow() for one page mode.
+ */
+void cow_pass(const std::string& path, size_t N, bool small)
+{
+    EHash<uint64_t, uint64_t> emap(N);
+    for (uint64_t i = 0; i < N; ++i) emap.insert(i, i * 3);
+    auto pass = [&] {
+        auto t0 = std::chrono::high_resolution_clock::now();
+        for (uint64_t i = 0; i < N; i += 64) *emap.find(i) += 1;
+        auto t1 = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(t1 - t0).count();
+    };
+
+    double alone = pass();
+    long before = hugeMiB();
+    pid_t child = ehash::snapshotInBackground(emap, path, 0);
+    double during = pass();
+    long after = hugeMiB();
+    ehash::snapshotStatus(child, true);
+
+    std::printf("[BENCH] %s pages, %zu elements, %zu writes: %.1f ms "
+                "alone, %.1f ms during a snapshot; huge pages %ld -> "
+                "%ld MiB\n",
+                small ? "4 KiB" : "huge", N, N / 64, alone, during, before,
+                after);
+    std::remove(path.c_str());
+}
+
+/*!
+ * \brief   what copy-on-write costs the writer while a snapshot child
+ *          runs, on 4 KiB and on transparent huge pages: a pass of writes
+ *          that touches most pages of the map, alone and during a
+ *          snapshot, and the huge pages left afterwards.
+ *
+ * \note    each page mode runs in a process of its own, on a thread of
+ *          its own: the NodePool caches are per thread, so the map gets
+ *          fresh slabs mapped in that mode rather than blocks inherited
+ *          from the tests before.
+ */
+void bench_cow(const std::string& path, size_t N)
+{
+    using Mode = ehash::HugePages::Mode;
+    std::cout.flush();
+    for (Mode mode : {Mode::Off, Mode::Transparent})
+    {
+        pid_t pid = ::fork();
+        if (pid > 0)
+        {
+            ::waitpid(pid, nullptr, 0);
+            continue;
+        }
+
+        ehash::HugePages::setMode(mode);
+        std::thread([&] { cow_pass(path, N, mode == Mode::Off); }).join();
+        std::fflush(stdout);
+        ::_exit(0);
+    }
+}
+
+int main()
+{
+    std::string path = "test_snapshot." + std::to_string(::getpid()) + ".snap";
+
+    unit_tests(path);
+    bench_snapshot(path, 2'000'000);
+    bench_cow(path, 2'000'000);
+    return 0;
+}
@@ -0,0 +1,204 @@
+/*!
+ * \file    tests/test_spill.cpp
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   unit tests and working-set benchmark for SpillEHash.
+ */
+
+#include "../lib/SpillEHash.h"
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*!
+ * \brief   random operations against std::unordered_map with a cache far
+ *          smaller than the table, so pages split and get evicted.
+ *
+ * \note    will abort if any test fails.
+ */
+void unit_tests(const std::string& path)
+{
+    SpillEHash<uint64_t, uint64_t> smap({8, 64});
+    bool ok = smap.open(path);
+    std::unordered_map<uint64_t, uint64_t> ref;
+
+    std::mt19937_64 rng(3);
+    for (int i = 0; i < 200'000; ++i)
+    {
+        uint64_t key = rng() % 100'000;
+        if (rng() % 4)
+        {
+            ok = smap.insert(key, uint64_t(i)) && ok;
+            ref[key] = uint64_t(i);
+        }
+        else
+        {
+            ok = smap.remove(key) == (ref.erase(key) == 1) && ok;
+        }
+    }
+    assert(ok);
+
+    assert(smap.size() == ref.size() && smap.pages() > 8);
+    assert(smap.stats.splits > 0 && smap.stats.writes > 0);
+    for (uint64_t key = 0; key < 100'000; ++key)
+    {
+        auto v = smap.find(key);
+        auto it = ref.find(key);
+        assert(v.has_value() == (it != ref.end()));
+        assert(!v || *v == it->second);
+    }
+
+    // batched lookups agree with single ones
+    std::vector<uint64_t> keys(1000);
+    for (auto& k : keys) k = rng() % 150'000;
+    std::vector<std::optional<uint64_t>> out(keys.size());
+    smap.find_batch(keys, out);
+    for (size_t i = 0; i < keys.size(); ++i) assert(out[i] == smap.find(keys[i]));
+
+    ok = smap.flush();
+    assert(ok && smap.error() == 0);
+    std::remove(path.c_str());
+
+    std::cout << "[TEST] all SpillEHash unit tests passed!\n";
+}
+
+/*!
+ * \brief   16-byte key whose hash is one field, so keys of a group collide
+ *          in every hash bit.
+ */
+struct Grouped
+{
+    uint64_t id;
+    uint64_t group;
+    bool operator==(const Grouped& o) const = default;
+};
+
+template<> struct std::hash<Grouped>
+{
+    size_t operator()(const Grouped& k) const { return k.group; }
+};
+
+/*!
+ * \brief   keys no split can separate go to overflow pages instead of
+ *          doubling the directory, and stay findable through eviction,
+ *          overwrites and removes.
+ *
+ * \note    will abort if any test fails.
+ */
+void flooding_tests(const std::string& path)
+{
+    SpillEHash<Grouped, uint64_t> smap({8, 64});
+    bool ok = smap.open(path);
+    const uint64_t N = 20'000;
+    for (uint64_t i = 0; i < N; ++i)
+    {
+        ok = smap.insert({i, 0}, i) && ok;
+        ok = smap.insert({i, i + 1}, i) && ok; // ordinary keys meanwhile
+    }
+    assert(ok && smap.size() == 2 * N);
+
+    // one page per Capacity colliding keys, not a directory of 2^30
+    assert(smap.pages() < 2 * N / 50);
+    for (uint64_t i = 0; i < N; i += 2) ok = smap.insert({i, 0}, i * 2) && ok;
+    for (uint64_t i = 0; i < N; i += 3) ok = smap.remove({i, 0}) && ok;
+    assert(ok && smap.size() == 2 * N - (N + 2) / 3);
+    for (uint64_t i = 0; i < N; ++i)
+    {
+        auto v = smap.find({i, 0});
+        if (i % 3 == 0) assert(!v);
+        else assert(v && *v == (i % 2 ? i : i * 2));
+        assert(*smap.find({i, i + 1}) == i);
+    }
+    assert(!smap.find({N, 0}) && smap.error() == 0);
+
+    SpillEHash<uint64_t, uint64_t> a, b;
+    assert(a.seed() != b.seed());
+    std::remove(path.c_str());
+
+    std::cout << "[TEST] all SpillEHash flooding tests passed!\n";
+}
+
+/*!
+ * \brief   make the kernel forget the file, so misses go to the disk.
+ */
+void dropPageCache(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    ::fdatasync(fd);
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+}
+
+/*!
+ * \brief   lookup cost as the cache shrinks below the table.
+ *
+ * \param   N elements (16 bytes each)
+ */
+void benchmark(const std::string& path, size_t N)
+{
+    using clock = std::chrono::high_resolution_clock;
+
+    std::vector<uint64_t> keys(N);
+    std::mt19937_64 rng(42);
+    for (auto& k : keys) k = rng();
+
+    for (size_t fraction : {1, 4, 16, 64})
+    {
+        size_t pages = N * 16 * 10 / 7 / 4096; // ~70% full pages
+        SpillEHash<uint64_t, uint64_t> smap({pages / fraction + 2});
+        if (!smap.open(path))
+        {
+            std::perror(path.c_str());
+            return;
+        }
+        for (uint64_t k : keys) smap.insert(k, k);
+        smap.flush();
+        dropPageCache(path);
+
+        std::vector<uint64_t> queries(200'000);
+        for (size_t i = 0; i < queries.size(); ++i)
+        {
+            // half hits, half misses
+            queries[i] = i % 2 ? keys[rng() % N] : rng();
+        }
+
+        auto t0 = clock::now();
+        size_t found = 0;
+        for (uint64_t q : queries) found += smap.find(q).has_value();
+        auto t1 = clock::now();
+        dropPageCache(path);
+        auto t2 = clock::now();
+        std::vector<std::optional<uint64_t>> out(queries.size());
+        smap.find_batch(queries, out);
+        auto t3 = clock::now();
+
+        auto ns = [&](auto a, auto b) {
+            return std::chrono::duration<double, std::nano>(b - a).count() /
+                   queries.size();
+        };
+        std::printf("[BENCH] %zu elements, %zu pages, cache 1/%zu: find "
+                    "%.0f ns/op, find_batch %.0f ns/op (%zu found, %llu "
+                    "filtered)\n",
+                    N, smap.pages(), fraction, ns(t0, t1), ns(t2, t3), found,
+                    (unsigned long long)smap.stats.filtered);
+    }
+    std::remove(path.c_str());
+}
+
+int main()
+{
+    std::string path = "test_spill." + std::to_string(::getpid()) + ".pages";
+
+    unit_tests(path);
+    flooding_tests(path);
+    benchmark(path, 4'000'000);
+    return 0;
+}
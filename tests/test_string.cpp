@@ -0,0 +1,215 @@
+/*!
+ * \file    tests/test_string.cpp
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   unit tests for StringEHash and a memory/locality benchmark
+ *          against EHash<std::string, V>.
+ */
+
+#include "../lib/EHash.h"
+#include "../lib/StringEHash.h"
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+/*!
+ * \brief   random operations against std::unordered_map, with keys from
+ *          empty to larger than an arena chunk.
+ *
+ * \note    will abort if any test fails.
+ */
+void unit_tests()
+{
+    StringEHash<uint64_t> smap;
+    std::unordered_map<std::string, uint64_t> ref;
+
+    std::mt19937_64 rng(8);
+    auto keyOf = [&](uint64_t id) {
+        size_t len = id % 97 == 0 ? 40'000 + id % 5 : id % 61;
+        std::string k(len, char('a' + id % 26));
+        k += std::to_string(id);
+        return k;
+    };
+
+    for (int round = 0; round < 3; ++round)
+    {
+        for (int i = 0; i < 200'000; ++i)
+        {
+            std::string key = keyOf(rng() % 20'000);
+            if (rng() % 3)
+            {
+                smap.insert(key, uint64_t(i));
+                ref[key] = uint64_t(i);
+            }
+            else
+            {
+                bool removed = smap.remove(key);
+                bool expected = ref.erase(key) == 1;
+                assert(removed == expected);
+            }
+        }
+
+        assert(smap.size() == ref.size());
+        for (uint64_t id = 0; id < 20'000; ++id)
+        {
+            std::string key = keyOf(id);
+            uint64_t* v = smap.find(key);
+            auto it = ref.find(key);
+            assert((v != nullptr) == (it != ref.end()));
+            assert(!v || *v == it->second);
+        }
+
+        size_t seen = 0;
+        smap.forEach([&](std::string_view k, const uint64_t& v) {
+            assert(ref.at(std::string(k)) == v);
+            seen++;
+        });
+        assert(seen == ref.size());
+
+        // remove most keys: compaction must keep the rest intact
+        for (auto it = ref.begin(); it != ref.end();)
+        {
+            if (rng() % 10)
+            {
+                bool removed = smap.remove(it->first);
+                assert(removed);
+                it = ref.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        for (auto& [k, v] : ref) assert(*smap.find(k) == v);
+    }
+
+    assert(!smap.find(""));
+    smap.insert("", 5);
+    assert(*smap.find("") == 5);
+
+    // around the inline limit, and zero bytes that look like padding
+    using namespace std::string_view_literals;
+    constexpr size_t Max = StringEHash<uint64_t>::InlineMax;
+    for (size_t len = Max - 2; len <= Max + 2; ++len)
+    {
+        smap.insert(std::string(len, 'z'), len);
+        smap.insert(std::string(len, '\0'), len + 100);
+    }
+    for (size_t len = Max - 2; len <= Max + 2; ++len)
+    {
+        assert(*smap.find(std::string(len, 'z')) == len);
+        assert(*smap.find(std::string(len, '\0')) == len + 100);
+    }
+    smap.insert("a\0"sv, 1);
+    smap.insert("a"sv, 2);
+    assert(*smap.find("a\0"sv) == 1 && *smap.find("a"sv) == 2);
+    assert(!smap.find("a\0\0"sv));
+
+    smap.clear();
+    assert(smap.size() == 0 && !smap.find("") && !smap.find(keyOf(1)));
+    smap.insert("again", 1);
+    assert(*smap.find("again") == 1);
+
+    std::cout << "[TEST] all StringEHash unit tests passed!\n";
+}
+
+/*!
+ * \brief   resident memory of this process in KiB.
+ */
+long residentKiB()
+{
+    long kib = 0;
+    if (FILE* f = std::fopen("/proc/self/status", "r"))
+    {
+        char line[256];
+        while (std::fgets(line, sizeof line, f))
+        {
+            if (std::sscanf(line, "VmRSS: %ld", &kib) == 1) break;
+        }
+        std::fclose(f);
+    }
+    return kib;
+}
+
+/*!
+ * \brief   in a child process: build a map of N keys of keyLen bytes,
+ *          then time finds, a full iteration and destruction.
+ */
+template<typename Map> void bench(const char* name, size_t N, size_t keyLen)
+{
+    std::cout.flush(); // or the child prints it again
+    pid_t pid = ::fork();
+    if (pid != 0)
+    {
+        int status = 0;
+        ::waitpid(pid, &status, 0);
+        return;
+    }
+
+    using clock = std::chrono::high_resolution_clock;
+    auto ns = [](auto a, auto b, size_t n) {
+        return std::chrono::duration<double, std::nano>(b - a).count() / n;
+    };
+
+    std::mt19937_64 rng(4);
+    std::vector<uint64_t> ids(N);
+    for (auto& id : ids) id = rng();
+    auto keyOf = [&](uint64_t id) {
+        std::string k = "session:" + std::to_string(id);
+        k.resize(keyLen, '.');
+        return k;
+    };
+
+    long base = residentKiB();
+    auto* map = new Map(8);
+    auto t0 = clock::now();
+    for (size_t i = 0; i < N; ++i) map->insert(keyOf(ids[i]), i);
+    auto t1 = clock::now();
+    long built = residentKiB() - base;
+
+    std::vector<std::string> queries(1'000'000);
+    for (auto& q : queries) q = keyOf(ids[rng() % N]);
+    auto t2 = clock::now();
+    uint64_t sum = 0;
+    for (const auto& q : queries) sum += *map->find(q);
+    auto t3 = clock::now();
+
+    size_t bytes = 0;
+    map->forEach([&](const auto& k, const uint64_t& v) {
+        bytes += k.size();
+        sum += v;
+    });
+    auto t4 = clock::now();
+    delete map;
+    auto t5 = clock::now();
+
+    std::printf("[BENCH] %-21s %zu keys of %zu bytes: %.0f MiB (%.0f B/key), "
+                "insert %.0f ns, find %.0f ns, iterate %.1f ns, destroy "
+                "%.1f ns per key (%llu)\n",
+                name, N, keyLen, built / 1024.0, built * 1024.0 / N,
+                ns(t0, t1, N), ns(t2, t3, queries.size()), ns(t3, t4, N),
+                ns(t4, t5, N), (unsigned long long)((sum + bytes) & 0xff));
+    std::fflush(stdout);
+    ::_exit(0);
+}
+
+int main()
+{
+    unit_tests();
+    for (size_t len : {16, 23, 48, 96})
+    {
+        bench<EHash<std::string, uint64_t>>("EHash<std::string>", 2'000'000,
+                                            len);
+        bench<StringEHash<uint64_t>>("StringEHash", 2'000'000, len);
+    }
+    return 0;
+}
@@ -0,0 +1,216 @@
+/*!
+ * \file    tests/test_wal.cpp
+ * \date    2026-10-17
+ * \author  elijw
+ * \license MIT
+ *
+ * \brief   unit tests and group commit benchmark for EHashWal.
+ */
+
+#include "../lib/EHashWal.h"
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+/*!
+ * \brief   round trip, torn tail and corruption handling.
+ *
+ * \note    will abort if any test fails.
+ */
+void unit_tests(const std::string& path)
+{
+    std::remove(path.c_str());
+    {
+        EHashWal<std::string, std::string> wal;
+        bool opened = wal.open(path);
+        assert(opened);
+        for (int i = 0; i < 1000; ++i)
+        {
+            wal.logInsert("key" + std::to_string(i), std::to_string(i * 3));
+        }
+        wal.logInsert("key7", "overwritten");
+        wal.logRemove("key8");
+        bool written = wal.commit();
+        assert(written);
+        assert(wal.stats.records == 1002 && wal.stats.writes == 1);
+    }
+
+    {
+        EHash<std::string, std::string> emap;
+        EHashWal<std::string, std::string> wal;
+        bool opened = wal.open(path);
+        assert(opened);
+        ehash::WalReplay r = wal.replay(emap);
+        assert(r.ok && r.records == 1002 && r.tornBytes == 0);
+        assert(emap.size() == 999);
+        assert(*emap.find("key7") == "overwritten");
+        assert(emap.find("key8") == nullptr);
+        assert(*emap.find("key999") == "2997");
+    }
+
+    // a crash mid write leaves half a record behind
+    {
+        int fd = ::open(path.c_str(), O_WRONLY | O_APPEND);
+        const char half[] = "\x20\x00\x00\x00\x01\x02";
+        ssize_t w = ::write(fd, half, sizeof half - 1);
+        assert(w == 6);
+        ::close(fd);
+
+        EHash<std::string, std::string> emap;
+        EHashWal<std::string, std::string> wal;
+        bool opened = wal.open(path);
+        assert(opened);
+        ehash::WalReplay r = wal.replay(emap);
+        assert(r.ok && r.records == 1002 && r.tornBytes == 6);
+
+        // appends after the cut replay normally
+        wal.logInsert("after", "crash");
+        bool synced = wal.sync();
+        assert(synced);
+    }
+    {
+        EHash<std::string, std::string> emap;
+        EHashWal<std::string, std::string> wal;
+        bool opened = wal.open(path);
+        assert(opened);
+        ehash::WalReplay r = wal.replay(emap);
+        assert(r.records == 1003 && r.tornBytes == 0);
+        assert(*emap.find("after") == "crash");
+    }
+
+    // a flipped bit ends the log at the damaged record
+    std::remove(path.c_str());
+    {
+        EHashWal<int, double> wal;
+        bool opened = wal.open(path);
+        assert(opened);
+        for (int i = 0; i < 10; ++i) wal.logInsert(i, i * 0.5);
+        bool synced = wal.sync();
+        assert(synced);
+    }
+    {
+        int fd = ::open(path.c_str(), O_RDWR);
+        char b;
+        off_t at = 5 * 21 + 12; // inside the 6th record (21 bytes each)
+        ssize_t n = ::pread(fd, &b, 1, at);
+        b ^= 0x10;
+        n += ::pwrite(fd, &b, 1, at);
+        assert(n == 2);
+        ::close(fd);
+
+        EHash<int, double> emap;
+        EHashWal<int, double> wal;
+        bool opened = wal.open(path);
+        assert(opened);
+        ehash::WalReplay r = wal.replay(emap);
+        assert(r.records == 5 && r.bytes == 5 * 21);
+        assert(emap.size() == 5 && *emap.find(4) == 2.0);
+        assert(emap.find(5) == nullptr);
+    }
+
+    // a record with an unknown op ends the log like a corrupt one: its
+    // key is not removed, and nothing after it is applied
+    std::remove(path.c_str());
+    {
+        EHashWal<int, double> wal;
+        bool opened = wal.open(path);
+        assert(opened);
+        for (int i = 0; i < 10; ++i) wal.logInsert(i, i * 0.5);
+        bool synced = wal.sync();
+        assert(synced);
+
+        std::string rec;
+        ehash::detail::walRecord<int, double>(rec, ehash::detail::WalOp(9),
+                                              3, nullptr);
+        ehash::detail::walRecord<int, double>(
+            rec, ehash::detail::WalOp::Remove, 4, nullptr);
+        int fd = ::open(path.c_str(), O_WRONLY | O_APPEND);
+        ssize_t w = ::write(fd, rec.data(), rec.size());
+        assert(w == ssize_t(rec.size()));
+        ::close(fd);
+    }
+    {
+        EHash<int, double> emap;
+        EHashWal<int, double> wal;
+        bool opened = wal.open(path);
+        assert(opened);
+        ehash::WalReplay r = wal.replay(emap);
+        assert(r.records == 10 && r.bytes == 10 * 21 && r.tornBytes == 2 * 13);
+        assert(emap.size() == 10 && *emap.find(3) == 1.5 && emap.find(4));
+    }
+    std::remove(path.c_str());
+
+    // /dev/null takes writes but fails fdatasync: a failed sync must not
+    // count the records durable, and every later commit tries again
+    {
+        ehash::WalOptions opts;
+        opts.syncBytes = 1;
+        EHashWal<int, double> wal(opts);
+        bool opened = wal.open("/dev/null");
+        assert(opened);
+        wal.logInsert(1, 1.0);
+        bool committed = wal.commit();
+        assert(!committed && wal.durable() == 0 && wal.stats.syncs == 1);
+        committed = wal.commit();
+        assert(!committed && wal.durable() == 0 && wal.stats.syncs == 2);
+        assert(wal.syncDueUs() >= 0);
+    }
+    {
+        EHashWal<int, double> wal;
+        bool opened = wal.open(path);
+        assert(opened);
+        wal.logInsert(1, 1.0);
+        wal.logRemove(2);
+        bool synced = wal.sync();
+        assert(synced && wal.durable() == 2);
+    }
+    std::remove(path.c_str());
+
+    std::cout << "[TEST] all EHashWal unit tests passed!\n";
+}
+
+/*!
+ * \brief   write rate with one fdatasync per write vs group commit.
+ *
+ * \param   N writes to log, one commit() after each
+ */
+void bench_group_commit(const std::string& path, size_t N)
+{
+    for (bool group : {false, true})
+    {
+        std::remove(path.c_str());
+        ehash::WalOptions opts;
+        if (!group) opts.syncBytes = 1; // every commit syncs
+
+        EHashWal<uint64_t, uint64_t> wal(opts);
+        if (!wal.open(path)) return;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint64_t i = 0; i < N; ++i)
+        {
+            wal.logInsert(i, i);
+            wal.commit();
+        }
+        wal.sync();
+        auto end = std::chrono::high_resolution_clock::now();
+
+        double s = std::chrono::duration<double>(end - start).count();
+        std::cout << "[BENCH] wal " << (group ? "group commit" : "sync/write")
+                  << ": " << N / s << " writes/s, " << wal.stats.syncs
+                  << " fdatasync\n";
+    }
+    std::remove(path.c_str());
+}
+
+int main()
+{
+    // next to the binary: /tmp may be tmpfs, where fdatasync is free
+    std::string path = "test_wal." + std::to_string(::getpid()) + ".log";
+
+    unit_tests(path);
+    bench_group_commit(path, 20'000);
+    return 0;
+}